@@ -6,6 +6,10 @@
 // Extract progress callbacks
 typedef int (CALLBACK *ExtractProgressFunc)(HANDLE, __int64);
 
+// Storage stream callbacks (origin is one of FILE_BEGIN, FILE_CURRENT, FILE_END)
+typedef BOOL (CALLBACK *StreamReadFunc)(HANDLE context, void* buffer, size_t size, size_t* bytesRead);
+typedef BOOL (CALLBACK *StreamSeekFunc)(HANDLE context, __int64 distance, int origin, __int64* newPosition);
+
 #pragma pack(push, 1)
 
 struct ExtractProcessCallbacks
@@ -14,7 +18,14 @@ struct ExtractProcessCallbacks
 	ExtractProgressFunc FileProgress;
 };
 
-#define ACTUAL_API_VERSION 6
+struct StorageStreamCallbacks
+{
+	HANDLE Context;
+	StreamReadFunc Read;
+	StreamSeekFunc Seek;
+};
+
+#define ACTUAL_API_VERSION 7
 #define STORAGE_FORMAT_NAME_MAX_LEN 32
 #define STORAGE_PARAM_MAX_LEN 64
 
@@ -24,6 +35,7 @@ struct StorageGeneralInfo
 	wchar_t Compression[STORAGE_PARAM_MAX_LEN];
 	wchar_t Comment[STORAGE_PARAM_MAX_LEN];
 	FILETIME Created;
+	int NumFiles;	// Number of items GetItem will return, if known on open (0 otherwise). Only used for progress.
 };
 
 struct StorageOpenParams
@@ -33,6 +45,10 @@ struct StorageOpenParams
 	const char* Password;
 	const void* Data;
 	size_t DataSize;
+	// If set then storage content should be read from this stream instead of file.
+	// FilePath still contains name of the storage, but it may not exist on disk.
+	// Given only to modules that report MODULE_CAP_OPEN_STREAM.
+	const StorageStreamCallbacks* Stream;
 };
 
 struct StorageItemInfo
@@ -45,6 +61,13 @@ struct StorageItemInfo
 	WORD NumHardlinks;
 	wchar_t Owner[64];
 	wchar_t Path[1024];
+	// Optional location of item data, batch extraction goes in this order.
+	// DataPosition is byte offset of item data in the storage file (in unpacked data for
+	// compressed images), DataVolume is index of the file for multi-volume storages.
+	// Zero means unknown.
+	int DataVolume;
+	__int64 DataPosition;
+	DWORD DataFlags;	// ITEM_DATA_* flags
 };
 
 struct ExtractOperationParams 
@@ -80,6 +103,7 @@ struct ModuleLoadParameters
 	GUID ModuleId;
 	DWORD ModuleVersion;
 	DWORD ApiVersion;
+	DWORD Capabilities;
 	module_cbs ApiFuncs;
 };
 
@@ -92,6 +116,12 @@ typedef void (MODULE_EXPORT *UnloadSubModuleFunc)(void);
 #define MAKEMODULEVERSION(mj,mn) ((mj << 16) | mn)
 #define STRBUF_SIZE(x) ( sizeof(x) / sizeof(x[0]) )
 
+// Module capabilities
+#define MODULE_CAP_OPEN_STREAM 1
+
+// Item data flags
+#define ITEM_DATA_CONTIGUOUS 1	// Item content is stored as is, Size bytes from DataPosition
+
 // Open storage return results
 #define SOR_INVALID_FILE 0
 #define SOR_SUCCESS 1
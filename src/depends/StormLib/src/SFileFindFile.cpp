@@ -262,6 +262,7 @@ static bool DoMPQSearch_FileEntry(
                     lpFindFileData->dwFileFlags  = pPatchEntry->dwFlags;
                     lpFindFileData->dwCompSize   = pPatchEntry->dwCmpSize;
                     lpFindFileData->lcLocale     = 0;   // pPatchEntry->lcLocale;
+                    lpFindFileData->ByteOffset   = ha->MpqPos + pFileEntry->ByteOffset;
 
                     // Fill the filetime
                     lpFindFileData->dwFileTimeHi = (DWORD)(pPatchEntry->FileTime >> 32);
@@ -627,6 +627,218 @@ int WINAPI SFileAddListFile(HANDLE hMpq, const TCHAR * szListFile)
     return nError;
 }
 
+//-----------------------------------------------------------------------------
+// Listfile index
+//
+// The index keeps one loaded listfile together with the (name A, name B)
+// hashes of all its lines. Applying it to an archive walks the hash table
+// of the archive instead of hashing every line of the listfile again.
+
+struct TListFileIndexEntry
+{
+    DWORD dwName1;                      // Name hash, method A
+    DWORD dwName2;                      // Name hash, method B
+    DWORD dwNameOffset;                 // Offset of the name in the listfile cache
+};
+
+struct TListFileIndex
+{
+    TListFileCache * pCache;            // Loaded listfile, lines are zero-terminated
+    TListFileIndexEntry * pEntries;     // Entries sorted by hashes, then by line order
+    DWORD dwEntries;                    // Number of entries
+};
+
+static int CompareIndexEntries(const void * p1, const void * p2)
+{
+    TListFileIndexEntry * pEntry1 = (TListFileIndexEntry *)p1;
+    TListFileIndexEntry * pEntry2 = (TListFileIndexEntry *)p2;
+
+    if(pEntry1->dwName1 != pEntry2->dwName1)
+        return (pEntry1->dwName1 < pEntry2->dwName1) ? -1 : 1;
+    if(pEntry1->dwName2 != pEntry2->dwName2)
+        return (pEntry1->dwName2 < pEntry2->dwName2) ? -1 : 1;
+    if(pEntry1->dwNameOffset != pEntry2->dwNameOffset)
+        return (pEntry1->dwNameOffset < pEntry2->dwNameOffset) ? -1 : 1;
+    return 0;
+}
+
+// Returns the first index entry with the given hashes, or NULL
+static TListFileIndexEntry * FindIndexEntry(TListFileIndex * pIndex, DWORD dwName1, DWORD dwName2)
+{
+    DWORD dwLeft = 0;
+    DWORD dwRight = pIndex->dwEntries;
+
+    while(dwLeft < dwRight)
+    {
+        DWORD dwMiddle = dwLeft + (dwRight - dwLeft) / 2;
+        TListFileIndexEntry * pEntry = pIndex->pEntries + dwMiddle;
+
+        if(pEntry->dwName1 < dwName1 || (pEntry->dwName1 == dwName1 && pEntry->dwName2 < dwName2))
+            dwLeft = dwMiddle + 1;
+        else
+            dwRight = dwMiddle;
+    }
+
+    if(dwLeft < pIndex->dwEntries)
+    {
+        TListFileIndexEntry * pEntry = pIndex->pEntries + dwLeft;
+        if(pEntry->dwName1 == dwName1 && pEntry->dwName2 == dwName2)
+            return pEntry;
+    }
+
+    return NULL;
+}
+
+static int SFileAddListFileIndexToArchive(TMPQArchive * ha, TListFileIndex * pIndex)
+{
+    LPBYTE pbNames = pIndex->pCache->pBegin;
+
+    // The index hashes are only valid for classic hash tables using the default hash function.
+    // Otherwise, just add the names from the index in the order of the listfile.
+    if(ha->pHetTable != NULL || ha->pHashTable == NULL || ha->pfnHashString != HashStringSlash)
+    {
+        LPBYTE pbName = pbNames;
+
+        while(pbName < pIndex->pCache->pEnd)
+        {
+            // Skip the line terminators, the first one of each line has been replaced by zero
+            if(pbName[0] == 0 || pbName[0] == 0x0A || pbName[0] == 0x0D)
+            {
+                pbName++;
+                continue;
+            }
+
+            SListFileCreateNodeForAllLocales(ha, (char *)pbName);
+            pbName += strlen((char *)pbName);
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    // Look up every used hash entry in the index. A name is only applied when
+    // the archive has an entry with its hashes, so this gives the same result
+    // as adding every line of the listfile.
+    for(DWORD i = 0; i < ha->pHeader->dwHashTableSize; i++)
+    {
+        TMPQHash * pHash = ha->pHashTable + i;
+        TListFileIndexEntry * pEntry;
+
+        if(MPQ_BLOCK_INDEX(pHash) >= ha->dwFileTableSize)
+            continue;
+
+        pEntry = FindIndexEntry(pIndex, pHash->dwName1, pHash->dwName2);
+        while(pEntry != NULL && pEntry < pIndex->pEntries + pIndex->dwEntries &&
+              pEntry->dwName1 == pHash->dwName1 && pEntry->dwName2 == pHash->dwName2)
+        {
+            SListFileCreateNodeForAllLocales(ha, (char *)(pbNames + pEntry->dwNameOffset));
+            pEntry++;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Loads the listfile and hashes all names in it.
+HANDLE WINAPI SListFileCreateIndex(const TCHAR * szListFile)
+{
+    TListFileIndex * pIndex;
+    TListFileCache * pCache;
+    char * szFileName;
+    size_t nLength = 0;
+    DWORD dwMaxEntries = 1;
+
+    // The hashes need the cryptography tables
+    InitializeMpqCryptography();
+
+    pCache = CreateListFileCache(NULL, szListFile, NULL, MAX_LISTFILE_SIZE, 0);
+    if(pCache == NULL)
+        return NULL;
+
+    // Every line ends by a newline, except the last one
+    for(LPBYTE pbPos = pCache->pBegin; pbPos < pCache->pEnd; pbPos++)
+    {
+        if(pbPos[0] == 0x0A || pbPos[0] == 0x0D)
+            dwMaxEntries++;
+    }
+
+    pIndex = STORM_ALLOC(TListFileIndex, 1);
+    if(pIndex == NULL)
+    {
+        FreeListFileCache(pCache);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    pIndex->pCache = pCache;
+    pIndex->dwEntries = 0;
+    pIndex->pEntries = STORM_ALLOC(TListFileIndexEntry, dwMaxEntries);
+    if(pIndex->pEntries == NULL)
+    {
+        SListFileCloseIndex(pIndex);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    // Hash all names. Each line is terminated by zero after this
+    while((szFileName = ReadListFileLine(pCache, &nLength)) != NULL)
+    {
+        if(nLength != 0)
+        {
+            TListFileIndexEntry * pEntry = pIndex->pEntries + pIndex->dwEntries++;
+
+            pEntry->dwName1 = HashStringSlash(szFileName, MPQ_HASH_NAME_A);
+            pEntry->dwName2 = HashStringSlash(szFileName, MPQ_HASH_NAME_B);
+            pEntry->dwNameOffset = (DWORD)((LPBYTE)szFileName - pCache->pBegin);
+        }
+    }
+
+    qsort(pIndex->pEntries, pIndex->dwEntries, sizeof(TListFileIndexEntry), CompareIndexEntries);
+    return (HANDLE)pIndex;
+}
+
+// Adds all names from the listfile index into the MPQ archive.
+// Has the same effect as SFileAddListFile with the listfile the index has been created from.
+int WINAPI SFileAddListFileIndex(HANDLE hMpq, HANDLE hListFileIndex)
+{
+    TMPQArchive * ha = (TMPQArchive *)hMpq;
+    TListFileIndex * pIndex = (TListFileIndex *)hListFileIndex;
+    int nError = ERROR_SUCCESS;
+
+    if(pIndex == NULL)
+        return ERROR_INVALID_PARAMETER;
+
+    // Add the listfile for each MPQ in the patch chain
+    while(ha != NULL)
+    {
+        nError = SFileAddListFileIndexToArchive(ha, pIndex);
+
+        // Also, add three special files to the listfile:
+        // (listfile) itself, (attributes) and (signature)
+        SListFileCreateNodeForAllLocales(ha, LISTFILE_NAME);
+        SListFileCreateNodeForAllLocales(ha, SIGNATURE_NAME);
+        SListFileCreateNodeForAllLocales(ha, ATTRIBUTES_NAME);
+
+        // Move to the next archive in the chain
+        ha = ha->haPatch;
+    }
+
+    return nError;
+}
+
+bool WINAPI SListFileCloseIndex(HANDLE hListFileIndex)
+{
+    TListFileIndex * pIndex = (TListFileIndex *)hListFileIndex;
+
+    if(pIndex != NULL)
+    {
+        if(pIndex->pEntries != NULL)
+            STORM_FREE(pIndex->pEntries);
+        FreeListFileCache(pIndex->pCache);
+        STORM_FREE(pIndex);
+    }
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 // Enumerating files in listfile
 
@@ -13,9 +13,307 @@
 #include "StormLib.h"
 #include "StormCommon.h"
 
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
 //-----------------------------------------------------------------------------
 // Local functions
 
+// Minimal number of sectors in one read that is worth splitting between threads
+#define MIN_PARALLEL_SECTORS      32
+#define MIN_SECTORS_PER_THREAD    16
+#define MAX_SECTOR_THREADS         8
+
+// One sector loaded by ReadMpqSectors, waiting for decryption and decompression
+struct TMPQSectorJob
+{
+    LPBYTE pbInSector;                      // Raw sector data
+    LPBYTE pbOutSector;                     // Target for the sector data
+    DWORD dwRawBytesInThisSector;           // Size of the raw sector
+    DWORD dwBytesInThisSector;              // Size of the sector after decompression
+    DWORD dwIndex;                          // Index of the sector in the file
+    DWORD dwCompression;                    // Compression byte of the sector (if decompressed by SCompDecompress)
+    int nError;                             // Result of the sector processing
+};
+
+//  hf            - MPQ File handle.
+//  pJob          - Sector to decrypt, verify and decompress
+//  Only the first sector of the read may detect the file key,
+//  the other sectors can be processed in parallel as they don't touch the file handle.
+static int ProcessMpqSector(TMPQFile * hf, TMPQSectorJob * pJob)
+{
+    TMPQArchive * ha = hf->ha;
+    TFileEntry * pFileEntry = hf->pFileEntry;
+    LPBYTE pbInSector = pJob->pbInSector;
+    LPBYTE pbOutSector = pJob->pbOutSector;
+    DWORD dwRawBytesInThisSector = pJob->dwRawBytesInThisSector;
+    DWORD dwBytesInThisSector = pJob->dwBytesInThisSector;
+    DWORD dwIndex = pJob->dwIndex;
+
+    // If the file is encrypted, we have to decrypt the sector
+    if(pFileEntry->dwFlags & MPQ_FILE_ENCRYPTED)
+    {
+        BSWAP_ARRAY32_UNSIGNED(pbInSector, dwRawBytesInThisSector);
+
+        // If we don't know the key, try to detect it by file content
+        if(hf->dwFileKey == 0)
+        {
+            hf->dwFileKey = DetectFileKeyByContent(pbInSector, dwBytesInThisSector, hf->dwDataSize);
+            if(hf->dwFileKey == 0)
+                return ERROR_UNKNOWN_FILE_KEY;
+        }
+
+        DecryptMpqBlock(pbInSector, dwRawBytesInThisSector, hf->dwFileKey + dwIndex);
+        BSWAP_ARRAY32_UNSIGNED(pbInSector, dwRawBytesInThisSector);
+    }
+
+    // If the file has sector CRC check turned on, perform it
+    if(hf->bCheckSectorCRCs && hf->SectorChksums != NULL)
+    {
+        DWORD dwAdlerExpected = hf->SectorChksums[dwIndex];
+        DWORD dwAdlerValue = 0;
+
+        // We can only check sector CRC when it's not zero
+        // Neither can we check it if it's 0xFFFFFFFF.
+        if(dwAdlerExpected != 0 && dwAdlerExpected != 0xFFFFFFFF)
+        {
+            dwAdlerValue = adler32(0, pbInSector, dwRawBytesInThisSector);
+            if(dwAdlerValue != dwAdlerExpected)
+                return ERROR_CHECKSUM_ERROR;
+        }
+    }
+
+    // If the sector is really compressed, decompress it.
+    // WARNING : Some sectors may not be compressed, it can be determined only
+    // by comparing uncompressed and compressed size !!!
+    if(dwRawBytesInThisSector < dwBytesInThisSector)
+    {
+        int cbOutSector = dwBytesInThisSector;
+        int cbInSector = dwRawBytesInThisSector;
+        int nResult = 0;
+
+        // Is the file compressed by Blizzard's multiple compression ?
+        if(pFileEntry->dwFlags & MPQ_FILE_COMPRESS)
+        {
+            // Remember the used compression, the caller stores it to the file handle
+            pJob->dwCompression = pbInSector[0];
+
+            // Decompress the data
+            if(ha->pHeader->wFormatVersion >= MPQ_FORMAT_VERSION_2)
+                nResult = SCompDecompress2(pbOutSector, &cbOutSector, pbInSector, cbInSector);
+            else
+                nResult = SCompDecompress(pbOutSector, &cbOutSector, pbInSector, cbInSector);
+        }
+
+        // Is the file compressed by PKWARE Data Compression Library ?
+        else if(pFileEntry->dwFlags & MPQ_FILE_IMPLODE)
+        {
+            nResult = SCompExplode(pbOutSector, &cbOutSector, pbInSector, cbInSector);
+        }
+
+        // Did the decompression fail ?
+        if(nResult == 0)
+            return ERROR_FILE_CORRUPT;
+    }
+    else
+    {
+        if(pbOutSector != pbInSector)
+            memcpy(pbOutSector, pbInSector, dwBytesInThisSector);
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Sectors of one read, shared by the calling thread and the pool workers.
+// Sectors are taken in increasing order, so when a sector fails,
+// all sectors before it have been already taken by some thread.
+struct TMPQSectorQueue
+{
+    TMPQFile * hf;
+    TMPQSectorJob * pJobs;
+    LONG nJobs;
+    std::atomic<LONG> nNextJob;             // Index of the next job to take
+    std::atomic<bool> bFailed;              // Set when any sector failed, no new jobs are taken then
+
+    void ProcessJobs()
+    {
+        LONG nJob;
+
+        while(bFailed == false && (nJob = nNextJob++) < nJobs)
+        {
+            TMPQSectorJob * pJob = pJobs + nJob;
+
+            pJob->nError = ProcessMpqSector(hf, pJob);
+            if(pJob->nError != ERROR_SUCCESS)
+                bFailed = true;
+        }
+    }
+};
+
+// Helper threads are started once and wait for the next read between the batches.
+// The pool serves one read at a time, the owner holds SectorPoolLock while using it.
+class TSectorWorkerPool
+{
+    public:
+
+    TSectorWorkerPool(DWORD dwWorkers)
+    {
+        dwGeneration = 0;
+        dwPending = 0;
+        dwBatchWorkers = 0;
+        pQueue = NULL;
+        bShutdown = false;
+
+        // If a thread cannot be started, the pool just has fewer workers
+        try
+        {
+            for(DWORD i = 0; i < dwWorkers; i++)
+                Workers.push_back(std::thread(&TSectorWorkerPool::WorkerLoop, this, i));
+        }
+        catch(const std::system_error &) {}
+    }
+
+    ~TSectorWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+            bShutdown = true;
+        }
+        WorkReady.notify_all();
+
+        for(size_t i = 0; i < Workers.size(); i++)
+            Workers[i].join();
+    }
+
+    DWORD GetWorkerCount()
+    {
+        return (DWORD)Workers.size();
+    }
+
+    // Processes the queue on the calling thread and up to dwHelpers workers
+    void Run(TMPQSectorQueue * pNewQueue, DWORD dwHelpers)
+    {
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+            pQueue = pNewQueue;
+            dwBatchWorkers = dwHelpers;
+            dwPending = (DWORD)Workers.size();
+            dwGeneration++;
+        }
+        WorkReady.notify_all();
+
+        pNewQueue->ProcessJobs();
+
+        std::unique_lock<std::mutex> Guard(Lock);
+        WorkDone.wait(Guard, [this] { return dwPending == 0; });
+        pQueue = NULL;
+    }
+
+    protected:
+
+    void WorkerLoop(DWORD dwWorkerIndex)
+    {
+        DWORD dwSeenGeneration = 0;
+
+        for(;;)
+        {
+            TMPQSectorQueue * pBatchQueue = NULL;
+
+            {
+                std::unique_lock<std::mutex> Guard(Lock);
+                WorkReady.wait(Guard, [&] { return bShutdown || dwGeneration != dwSeenGeneration; });
+                if(bShutdown)
+                    return;
+
+                dwSeenGeneration = dwGeneration;
+                if(dwWorkerIndex < dwBatchWorkers)
+                    pBatchQueue = pQueue;
+            }
+
+            if(pBatchQueue != NULL)
+                pBatchQueue->ProcessJobs();
+
+            std::lock_guard<std::mutex> Guard(Lock);
+            if(--dwPending == 0)
+                WorkDone.notify_one();
+        }
+    }
+
+    std::vector<std::thread> Workers;
+    std::mutex Lock;
+    std::condition_variable WorkReady;
+    std::condition_variable WorkDone;
+    TMPQSectorQueue * pQueue;
+    DWORD dwGeneration;                     // Incremented for every read
+    DWORD dwPending;                        // Workers that did not finish the current read yet
+    DWORD dwBatchWorkers;                   // Workers with index below this take part in the current read
+    bool bShutdown;
+};
+
+// Thread count set by SFileSetSectorThreads, 0 means number of processors
+static DWORD dwSectorThreads = 0;
+static TSectorWorkerPool * pSectorPool = NULL;
+static std::mutex SectorPoolLock;
+
+static DWORD GetMaxSectorThreads()
+{
+    DWORD dwThreads = dwSectorThreads;
+
+    if(dwThreads == 0)
+        dwThreads = std::thread::hardware_concurrency();
+    if(dwThreads == 0)
+        dwThreads = 1;
+    if(dwThreads > MAX_SECTOR_THREADS)
+        dwThreads = MAX_SECTOR_THREADS;
+    return dwThreads;
+}
+
+// Processes the jobs on the calling thread and pool helpers.
+// Returns false if the pool is busy with another read or not available,
+// then the caller processes the jobs alone.
+static bool ProcessMpqSectorsParallel(TMPQFile * hf, TMPQSectorJob * pJobs, DWORD dwJobs)
+{
+    std::unique_lock<std::mutex> PoolGuard(SectorPoolLock, std::try_to_lock);
+    TMPQSectorQueue Queue;
+    DWORD dwThreads;
+
+    if(!PoolGuard.owns_lock())
+        return false;
+
+    dwThreads = GetMaxSectorThreads();
+    if(dwThreads > dwJobs / MIN_SECTORS_PER_THREAD)
+        dwThreads = dwJobs / MIN_SECTORS_PER_THREAD;
+    if(dwThreads < 2)
+        return false;
+
+    // The pool is created on first use, with workers for the maximal thread count
+    if(pSectorPool == NULL)
+    {
+        try
+        {
+            pSectorPool = new TSectorWorkerPool(GetMaxSectorThreads() - 1);
+        }
+        catch(const std::bad_alloc &)
+        {
+            return false;
+        }
+    }
+    if(pSectorPool->GetWorkerCount() == 0)
+        return false;
+
+    Queue.hf = hf;
+    Queue.pJobs = pJobs;
+    Queue.nJobs = (LONG)dwJobs;
+    Queue.nNextJob = 0;
+    Queue.bFailed = false;
+
+    pSectorPool->Run(&Queue, dwThreads - 1);
+    return true;
+}
+
 //  hf            - MPQ File handle.
 //  pbBuffer      - Pointer to target buffer to store sectors.
 //  dwByteOffset  - Position of sector in the file (relative to file begin)
@@ -26,6 +324,7 @@ static int ReadMpqSectors(TMPQFile * hf, LPBYTE pbBuffer, DWORD dwByteOffset, DW
     ULONGLONG RawFilePos;
     TMPQArchive * ha = hf->ha;
     TFileEntry * pFileEntry = hf->pFileEntry;
+    TMPQSectorJob * pJobs = NULL;
     LPBYTE pbRawSector = NULL;
     LPBYTE pbOutSector = pbBuffer;
     LPBYTE pbInSector = pbBuffer;
@@ -33,7 +332,6 @@ static int ReadMpqSectors(TMPQFile * hf, LPBYTE pbBuffer, DWORD dwByteOffset, DW
     DWORD dwRawSectorOffset = dwByteOffset;
     DWORD dwSectorsToRead = dwBytesToRead / ha->dwSectorSize;
     DWORD dwSectorIndex = dwByteOffset / ha->dwSectorSize;
-    DWORD dwSectorsDone = 0;
     DWORD dwBytesRead = 0;
     int nError = ERROR_SUCCESS;
 
@@ -91,15 +389,30 @@ static int ReadMpqSectors(TMPQFile * hf, LPBYTE pbBuffer, DWORD dwByteOffset, DW
             return ERROR_NOT_ENOUGH_MEMORY;
     }
 
+    // Allocate the list of sectors to process
+    if(dwSectorsToRead > 0)
+    {
+        pJobs = STORM_ALLOC(TMPQSectorJob, dwSectorsToRead);
+        if(pJobs == NULL)
+        {
+            if(pbRawSector != NULL)
+                STORM_FREE(pbRawSector);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+
     // Calculate raw file offset where the sector(s) are stored.
     RawFilePos = CalculateRawSectorOffset(hf, dwRawSectorOffset);
 
     // Set file pointer and read all required sectors
     if(FileStream_Read(ha->pStream, &RawFilePos, pbInSector, dwRawBytesToRead))
     {
-        // Now we have to decrypt and decompress all file sectors that have been loaded
+        DWORD dwSectorsDone = 0;
+
+        // Split the loaded data to sectors
         for(DWORD i = 0; i < dwSectorsToRead; i++)
         {
+            TMPQSectorJob * pJob = pJobs + i;
             DWORD dwRawBytesInThisSector = ha->dwSectorSize;
             DWORD dwBytesInThisSector = ha->dwSectorSize;
             DWORD dwIndex = dwSectorIndex + i;
@@ -115,93 +428,53 @@ static int ReadMpqSectors(TMPQFile * hf, LPBYTE pbBuffer, DWORD dwByteOffset, DW
             if(pFileEntry->dwFlags & MPQ_FILE_COMPRESS_MASK)
                 dwRawBytesInThisSector = hf->SectorOffsets[dwIndex + 1] - hf->SectorOffsets[dwIndex];
 
-            // If the file is encrypted, we have to decrypt the sector
-            if(pFileEntry->dwFlags & MPQ_FILE_ENCRYPTED)
-            {
-                BSWAP_ARRAY32_UNSIGNED(pbInSector, dwRawBytesInThisSector);
-
-                // If we don't know the key, try to detect it by file content
-                if(hf->dwFileKey == 0)
-                {
-                    hf->dwFileKey = DetectFileKeyByContent(pbInSector, dwBytesInThisSector, hf->dwDataSize);
-                    if(hf->dwFileKey == 0)
-                    {
-                        nError = ERROR_UNKNOWN_FILE_KEY;
-                        break;
-                    }
-                }
-
-                DecryptMpqBlock(pbInSector, dwRawBytesInThisSector, hf->dwFileKey + dwIndex);
-                BSWAP_ARRAY32_UNSIGNED(pbInSector, dwRawBytesInThisSector);
-            }
-
-            // If the file has sector CRC check turned on, perform it
-            if(hf->bCheckSectorCRCs && hf->SectorChksums != NULL)
-            {
-                DWORD dwAdlerExpected = hf->SectorChksums[dwIndex];
-                DWORD dwAdlerValue = 0;
-
-                // We can only check sector CRC when it's not zero
-                // Neither can we check it if it's 0xFFFFFFFF.
-                if(dwAdlerExpected != 0 && dwAdlerExpected != 0xFFFFFFFF)
-                {
-                    dwAdlerValue = adler32(0, pbInSector, dwRawBytesInThisSector);
-                    if(dwAdlerValue != dwAdlerExpected)
-                    {
-                        nError = ERROR_CHECKSUM_ERROR;
-                        break;
-                    }
-                }
-            }
-
-            // If the sector is really compressed, decompress it.
-            // WARNING : Some sectors may not be compressed, it can be determined only
-            // by comparing uncompressed and compressed size !!!
-            if(dwRawBytesInThisSector < dwBytesInThisSector)
-            {
-                int cbOutSector = dwBytesInThisSector;
-                int cbInSector = dwRawBytesInThisSector;
-                int nResult = 0;
-
-                // Is the file compressed by Blizzard's multiple compression ?
-                if(pFileEntry->dwFlags & MPQ_FILE_COMPRESS)
-                {
-                    // Remember the last used compression
-                    hf->dwCompression0 = pbInSector[0];
-
-                    // Decompress the data
-                    if(ha->pHeader->wFormatVersion >= MPQ_FORMAT_VERSION_2)
-                        nResult = SCompDecompress2(pbOutSector, &cbOutSector, pbInSector, cbInSector);
-                    else
-                        nResult = SCompDecompress(pbOutSector, &cbOutSector, pbInSector, cbInSector);
-                }
-
-                // Is the file compressed by PKWARE Data Compression Library ?
-                else if(pFileEntry->dwFlags & MPQ_FILE_IMPLODE)
-                {
-                    nResult = SCompExplode(pbOutSector, &cbOutSector, pbInSector, cbInSector);
-                }
-
-                // Did the decompression fail ?
-                if(nResult == 0)
-                {
-                    nError = ERROR_FILE_CORRUPT;
-                    break;
-                }
-            }
-            else
-            {
-                if(pbOutSector != pbInSector)
-                    memcpy(pbOutSector, pbInSector, dwBytesInThisSector);
-            }
+            pJob->pbInSector = pbInSector;
+            pJob->pbOutSector = pbOutSector;
+            pJob->dwRawBytesInThisSector = dwRawBytesInThisSector;
+            pJob->dwBytesInThisSector = dwBytesInThisSector;
+            pJob->dwIndex = dwIndex;
+            pJob->dwCompression = 0xFFFFFFFF;
+            pJob->nError = ERROR_SUCCESS;
 
             // Move pointers
             dwBytesToRead -= dwBytesInThisSector;
-            dwByteOffset += dwBytesInThisSector;
-            dwBytesRead += dwBytesInThisSector;
             pbOutSector += dwBytesInThisSector;
             pbInSector += dwRawBytesInThisSector;
-            dwSectorsDone++;
+        }
+
+        // The first sector goes alone, it may need to detect the file key
+        if(dwSectorsToRead > 0)
+        {
+            pJobs[0].nError = ProcessMpqSector(hf, pJobs);
+            dwSectorsDone = 1;
+        }
+
+        // Sectors have their own keys and compression, so the rest can be done in parallel
+        if(dwSectorsToRead >= MIN_PARALLEL_SECTORS && pJobs[0].nError == ERROR_SUCCESS &&
+           (pFileEntry->dwFlags & (MPQ_FILE_COMPRESS_MASK | MPQ_FILE_ENCRYPTED)))
+        {
+            if(ProcessMpqSectorsParallel(hf, pJobs + 1, dwSectorsToRead - 1))
+                dwSectorsDone = dwSectorsToRead;
+        }
+
+        for(DWORD i = dwSectorsDone; i < dwSectorsToRead; i++)
+        {
+            if(pJobs[i - 1].nError != ERROR_SUCCESS)
+                break;
+            pJobs[i].nError = ProcessMpqSector(hf, pJobs + i);
+        }
+
+        // Collect results in sector order, stop at the first failed one
+        for(DWORD i = 0; i < dwSectorsToRead; i++)
+        {
+            if(pJobs[i].dwCompression != 0xFFFFFFFF)
+                hf->dwCompression0 = pJobs[i].dwCompression;
+
+            nError = pJobs[i].nError;
+            if(nError != ERROR_SUCCESS)
+                break;
+
+            dwBytesRead += pJobs[i].dwBytesInThisSector;
         }
     }
     else
@@ -210,6 +483,8 @@ static int ReadMpqSectors(TMPQFile * hf, LPBYTE pbBuffer, DWORD dwByteOffset, DW
     }
 
     // Free all used buffers
+    if(pJobs != NULL)
+        STORM_FREE(pJobs);
     if(pbRawSector != NULL)
         STORM_FREE(pbRawSector);
     
@@ -659,6 +934,31 @@ static int ReadMpqFileLocalFile(TMPQFile * hf, void * pvBuffer, DWORD dwFilePos,
     return nError;
 }
 
+//-----------------------------------------------------------------------------
+// SFileGetSectorThreads and SFileSetSectorThreads
+// Number of threads that decompress sectors of one read.
+// 0 means number of processors, 1 turns the parallel processing off
+// and stops the helper threads. Returns the previous value.
+
+DWORD WINAPI SFileGetSectorThreads()
+{
+    return dwSectorThreads;
+}
+
+DWORD WINAPI SFileSetSectorThreads(DWORD dwThreads)
+{
+    std::lock_guard<std::mutex> PoolGuard(SectorPoolLock);
+    DWORD dwOldThreads = dwSectorThreads;
+
+    // The pool is recreated with the new size on the next read
+    if(pSectorPool != NULL)
+        delete pSectorPool;
+    pSectorPool = NULL;
+
+    dwSectorThreads = dwThreads;
+    return dwOldThreads;
+}
+
 //-----------------------------------------------------------------------------
 // SFileReadFile
 
@@ -563,7 +563,7 @@ static DWORD VerifyFile(
     unsigned char md5[MD5_DIGEST_SIZE];
     TFileEntry * pFileEntry;
     TMPQFile * hf;
-    BYTE Buffer[0x1000];
+    BYTE Buffer[MPQ_DIGEST_UNIT_SIZE];
     HANDLE hFile = NULL;
     DWORD dwVerifyResult = 0;
     DWORD dwTotalBytes = 0;
@@ -911,6 +911,7 @@ typedef struct _SFILE_FIND_DATA
     DWORD  dwFileTimeLo;                        // Low 32-bits of the file time (0 if not present)
     DWORD  dwFileTimeHi;                        // High 32-bits of the file time (0 if not present)
     LCID   lcLocale;                            // Locale version
+    ULONGLONG ByteOffset;                       // Offset of the file data from the beginning of the archive file
 
 } SFILE_FIND_DATA, *PSFILE_FIND_DATA;
 
@@ -985,6 +986,9 @@ typedef bool  (WINAPI * SFILEREADFILE)(HANDLE, void *, DWORD, LPDWORD, LPOVERLAP
 LCID   WINAPI SFileGetLocale();
 LCID   WINAPI SFileSetLocale(LCID lcNewLocale);
 
+DWORD  WINAPI SFileGetSectorThreads();
+DWORD  WINAPI SFileSetSectorThreads(DWORD dwThreads);
+
 //-----------------------------------------------------------------------------
 // Functions for archive manipulation
 
@@ -1001,6 +1005,12 @@ bool   WINAPI SFileCloseArchive(HANDLE hMpq);
 // Note that this function is internally called by SFileFindFirstFile
 int    WINAPI SFileAddListFile(HANDLE hMpq, const TCHAR * szListFile);
 
+// Listfile index. Loads and hashes the listfile once, so it can be added
+// to many archives without reading and hashing all its names again.
+HANDLE WINAPI SListFileCreateIndex(const TCHAR * szListFile);
+int    WINAPI SFileAddListFileIndex(HANDLE hMpq, HANDLE hListFileIndex);
+bool   WINAPI SListFileCloseIndex(HANDLE hListFileIndex);
+
 // Archive compacting
 bool   WINAPI SFileSetCompactCallback(HANDLE hMpq, SFILE_COMPACT_CALLBACK CompactCB, void * pvUserData);
 bool   WINAPI SFileCompactArchive(HANDLE hMpq, const TCHAR * szListFile, bool bReserved);
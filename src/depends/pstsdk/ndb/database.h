@@ -10,6 +10,8 @@
 
 #include <fstream>
 #include <memory>
+#include <list>
+#include <map>
 
 #include "pstsdk/util/btree.h"
 #include "pstsdk/util/errors.h"
@@ -32,30 +34,86 @@ class database_impl;
 typedef database_impl<ulonglong> large_pst;
 typedef database_impl<ulong> small_pst;
 
+//! \brief Default for the per-open block and page CRC validation switch
+//!
+//! CRC checks are on by default only when \ref PSTSDK_VALIDATION_LEVEL_FULL is defined.
+//! \ingroup ndb_databaserelated
+#ifdef PSTSDK_VALIDATION_LEVEL_FULL
+const bool default_crc_validation = true;
+#else
+const bool default_crc_validation = false;
+#endif
+
 //! \brief Open a db_context for the given file
 //! \throws invalid_format if the file format is not understood
 //! \throws runtime_error if an error occurs opening the file
 //! \throws crc_fail (\ref PSTSDK_VALIDATION_LEVEL_WEAK) if the CRC of this header doesn't match
 //! \param[in] filename The filename to open
+//! \param[in] validate_crc Check the CRC of every page and block read from the file
 //! \returns A shared_ptr to the opened context
 //! \ingroup ndb_databaserelated
-shared_db_ptr open_database(const std::wstring& filename);
+shared_db_ptr open_database(const std::wstring& filename, bool validate_crc = default_crc_validation);
 //! \brief Try to open the given file as an ANSI store
 //! \throws invalid_format if the file format is not ANSI
 //! \throws runtime_error if an error occurs opening the file
 //! \throws crc_fail (\ref PSTSDK_VALIDATION_LEVEL_WEAK) if the CRC of this header doesn't match
 //! \param[in] filename The filename to open
+//! \param[in] validate_crc Check the CRC of every page and block read from the file
 //! \returns A shared_ptr to the opened context
 //! \ingroup ndb_databaserelated
-std::tr1::shared_ptr<small_pst> open_small_pst(const std::wstring& filename);
+std::tr1::shared_ptr<small_pst> open_small_pst(const std::wstring& filename, bool validate_crc = default_crc_validation);
 //! \brief Try to open the given file as a Unicode store
 //! \throws invalid_format if the file format is not Unicode
 //! \throws runtime_error if an error occurs opening the file
 //! \throws crc_fail (\ref PSTSDK_VALIDATION_LEVEL_WEAK) if the CRC of this header doesn't match
 //! \param[in] filename The filename to open
+//! \param[in] validate_crc Check the CRC of every page and block read from the file
 //! \returns A shared_ptr to the opened context
 //! \ingroup ndb_databaserelated
-std::tr1::shared_ptr<large_pst> open_large_pst(const std::wstring& filename);
+std::tr1::shared_ptr<large_pst> open_large_pst(const std::wstring& filename, bool validate_crc = default_crc_validation);
+
+//! \brief Default amount of memory used by the page and block cache
+//! \ingroup ndb_databaserelated
+const size_t default_cache_size = 16 * 1024 * 1024;
+
+//! \brief LRU cache of validated page and block data
+//!
+//! Pages and blocks never share a file location, so both are keyed by their
+//! on disk address. Entries are stored exactly as read from disk (before
+//! decryption), so cached data passes through the same code paths as data
+//! fresh from the file.
+//! \ingroup ndb_databaserelated
+class block_cache : private boost::noncopyable
+{
+public:
+    block_cache(size_t max_bytes = default_cache_size)
+        : m_max_bytes(max_bytes), m_cached_bytes(0) 
+        { memset(&m_stats, 0, sizeof(m_stats)); }
+
+    //! \brief Lookup data for the given address
+    //! \param[in] address The disk location of the page or block
+    //! \param[out] buffer Receives a copy of the cached data
+    //! \returns true if the data was found in the cache
+    bool lookup(ulonglong address, std::vector<byte>& buffer);
+    //! \brief Add data read from disk to the cache
+    //! \param[in] address The disk location of the page or block
+    //! \param[in] buffer The validated data
+    void insert(ulonglong address, const std::vector<byte>& buffer);
+
+    void set_max_size(size_t max_bytes);
+    cache_stats get_stats() const;
+
+private:
+    typedef std::list<std::pair<ulonglong, std::vector<byte> > > entry_list;
+
+    void trim(size_t max_bytes);
+
+    size_t m_max_bytes;
+    size_t m_cached_bytes;
+    entry_list m_entries;  //!< Most recently used entries are at the front
+    std::map<ulonglong, entry_list::iterator> m_index;
+    cache_stats m_stats;
+};
 
 //! \brief PST implementation
 //!
@@ -128,13 +186,22 @@ public:
     block_id alloc_bid(bool is_internal);
 //! \endcond
 
+    //! \name Cache functions
+    //@{
+    cache_stats get_cache_stats() const
+        { return m_cache.get_stats(); }
+    void set_cache_size(size_t max_bytes)
+        { m_cache.set_max_size(max_bytes); }
+    //@}
+
 protected:
     database_impl(); // = delete
     //! \brief Construct a database_impl from this filename
     //! \throws invalid_format if the file format is not understood
     //! \throws runtime_error if an error occurs opening the file
     //! \param[in] filename The filename to open
-    database_impl(const std::wstring& filename);
+    //! \param[in] validate_crc Check the CRC of every page and block read from the file
+    database_impl(const std::wstring& filename, bool validate_crc);
     //! \brief Validate the header of this file
     //! \throws invalid_format if this header is for a database format incompatible with this object
     //! \throws crc_fail (\ref PSTSDK_VALIDATION_LEVEL_WEAK) if the CRC of this header doesn't match
@@ -165,14 +232,16 @@ protected:
     std::tr1::shared_ptr<subnode_leaf_block> read_subnode_leaf_block(const shared_db_ptr& parent, const block_info& bi, disk::sub_leaf_block<T>& sub_block);
     std::tr1::shared_ptr<subnode_nonleaf_block> read_subnode_nonleaf_block(const shared_db_ptr& parent, const block_info& bi, disk::sub_nonleaf_block<T>& sub_block);
 
-    friend shared_db_ptr open_database(const std::wstring& filename);
-    friend std::tr1::shared_ptr<small_pst> open_small_pst(const std::wstring& filename);
-    friend std::tr1::shared_ptr<large_pst> open_large_pst(const std::wstring& filename);
+    friend shared_db_ptr open_database(const std::wstring& filename, bool validate_crc);
+    friend std::tr1::shared_ptr<small_pst> open_small_pst(const std::wstring& filename, bool validate_crc);
+    friend std::tr1::shared_ptr<large_pst> open_large_pst(const std::wstring& filename, bool validate_crc);
 
     file m_file;
     disk::header<T> m_header;
     std::tr1::shared_ptr<bbt_page> m_bbt_root;
     std::tr1::shared_ptr<nbt_page> m_nbt_root;
+    block_cache m_cache;
+    bool m_validate_crc;
 };
 
 //! \cond dont_show_these_member_function_specializations
@@ -212,11 +281,11 @@ inline void database_impl<ulonglong>::validate_header()
 //! \endcond
 } // end namespace
 
-inline pstsdk::shared_db_ptr pstsdk::open_database(const std::wstring& filename)
+inline pstsdk::shared_db_ptr pstsdk::open_database(const std::wstring& filename, bool validate_crc)
 {
     try 
     {
-        shared_db_ptr db = open_small_pst(filename);
+        shared_db_ptr db = open_small_pst(filename, validate_crc);
         return db;
     }
     catch(invalid_format&)
@@ -224,25 +293,84 @@ inline pstsdk::shared_db_ptr pstsdk::open_database(const std::wstring& filename)
         // well, that didn't work
     }
 
-    shared_db_ptr db = open_large_pst(filename);
+    shared_db_ptr db = open_large_pst(filename, validate_crc);
     return db;
 }
 
-inline std::tr1::shared_ptr<pstsdk::small_pst> pstsdk::open_small_pst(const std::wstring& filename)
+inline std::tr1::shared_ptr<pstsdk::small_pst> pstsdk::open_small_pst(const std::wstring& filename, bool validate_crc)
 {
-    std::tr1::shared_ptr<small_pst> db(new small_pst(filename));
+    std::tr1::shared_ptr<small_pst> db(new small_pst(filename, validate_crc));
     return db;
 }
 
-inline std::tr1::shared_ptr<pstsdk::large_pst> pstsdk::open_large_pst(const std::wstring& filename)
+inline std::tr1::shared_ptr<pstsdk::large_pst> pstsdk::open_large_pst(const std::wstring& filename, bool validate_crc)
 {
-    std::tr1::shared_ptr<large_pst> db(new large_pst(filename));
+    std::tr1::shared_ptr<large_pst> db(new large_pst(filename, validate_crc));
     return db;
 }
 
+inline bool pstsdk::block_cache::lookup(ulonglong address, std::vector<byte>& buffer)
+{
+    std::map<ulonglong, entry_list::iterator>::iterator it = m_index.find(address);
+
+    if(it == m_index.end())
+    {
+        m_stats.misses++;
+        return false;
+    }
+
+    // move to the front of the list, iterators stay valid
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    buffer = it->second->second;
+
+    m_stats.hits++;
+    return true;
+}
+
+inline void pstsdk::block_cache::insert(ulonglong address, const std::vector<byte>& buffer)
+{
+    m_stats.bytes_read += buffer.size();
+
+    if(buffer.size() > m_max_bytes || m_index.find(address) != m_index.end())
+        return;
+
+    trim(m_max_bytes - buffer.size());
+
+    m_entries.push_front(std::make_pair(address, buffer));
+    m_index[address] = m_entries.begin();
+    m_cached_bytes += buffer.size();
+}
+
+inline void pstsdk::block_cache::set_max_size(size_t max_bytes)
+{
+    m_max_bytes = max_bytes;
+    trim(m_max_bytes);
+}
+
+inline pstsdk::cache_stats pstsdk::block_cache::get_stats() const
+{
+    cache_stats stats = m_stats;
+    stats.cached_bytes = m_cached_bytes;
+    return stats;
+}
+
+inline void pstsdk::block_cache::trim(size_t max_bytes)
+{
+    while(m_cached_bytes > max_bytes && !m_entries.empty())
+    {
+        m_cached_bytes -= m_entries.back().second.size();
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+}
+
 template<typename T>
 inline std::vector<pstsdk::byte> pstsdk::database_impl<T>::read_block_data(const block_info& bi)
 {
+    std::vector<byte> buffer;
+    if(m_cache.lookup(bi.address, buffer))
+        return buffer;
+
     size_t aligned_size = disk::align_disk<T>(bi.size);
 
 #ifdef PSTSDK_VALIDATION_LEVEL_WEAK
@@ -253,7 +381,7 @@ inline std::vector<pstsdk::byte> pstsdk::database_impl<T>::read_block_data(const
         throw unexpected_block("nonsensical block location; past eof");
 #endif
 
-    std::vector<byte> buffer(aligned_size);
+    buffer.resize(aligned_size);
     disk::block_trailer<T>* bt = (disk::block_trailer<T>*)(&buffer[0] + aligned_size - sizeof(disk::block_trailer<T>));
 
     m_file.read(buffer, bi.address);    
@@ -269,18 +397,24 @@ inline std::vector<pstsdk::byte> pstsdk::database_impl<T>::read_block_data(const
         throw sig_mismatch("block sig mismatch", bi.address, bi.id, disk::compute_signature(bi.id, bi.address), bt->signature);
 #endif
 
-#ifdef PSTSDK_VALIDATION_LEVEL_FULL
-    ulong crc = disk::compute_crc(&buffer[0], bi.size);
-    if(crc != bt->crc)
-        throw crc_fail("block crc failure", bi.address, bi.id, crc, bt->crc);
-#endif
+    if(m_validate_crc)
+    {
+        ulong crc = disk::compute_crc(&buffer[0], bi.size);
+        if(crc != bt->crc)
+            throw crc_fail("block crc failure", bi.address, bi.id, crc, bt->crc);
+    }
 
+    m_cache.insert(bi.address, buffer);
     return buffer;
 }
 
 template<typename T>
 std::vector<pstsdk::byte> pstsdk::database_impl<T>::read_page_data(const page_info& pi)
 {
+    std::vector<byte> buffer;
+    if(m_cache.lookup(pi.address, buffer))
+        return buffer;
+
 #ifdef PSTSDK_VALIDATION_LEVEL_WEAK
     if(pi.address + disk::page_size > m_header.root_info.ibFileEof)
         throw unexpected_page("nonsensical page location; past eof");
@@ -289,16 +423,17 @@ std::vector<pstsdk::byte> pstsdk::database_impl<T>::read_page_data(const page_in
         throw unexpected_page("nonsensical page location; not sector aligned");
 #endif
 
-    std::vector<byte> buffer(disk::page_size);
+    buffer.resize(disk::page_size);
     disk::page<T>* ppage = (disk::page<T>*)&buffer[0];
     
     m_file.read(buffer, pi.address);
 
-#ifdef PSTSDK_VALIDATION_LEVEL_FULL
-    ulong crc = disk::compute_crc(&buffer[0], disk::page<T>::page_data_size);
-    if(crc != ppage->trailer.crc)
-        throw crc_fail("page crc failure", pi.address, pi.id, crc, ppage->trailer.crc);
-#endif
+    if(m_validate_crc)
+    {
+        ulong crc = disk::compute_crc(&buffer[0], disk::page<T>::page_data_size);
+        if(crc != ppage->trailer.crc)
+            throw crc_fail("page crc failure", pi.address, pi.id, crc, ppage->trailer.crc);
+    }
 
 #ifdef PSTSDK_VALIDATION_LEVEL_WEAK
     if(ppage->trailer.bid != pi.id)
@@ -311,6 +446,7 @@ std::vector<pstsdk::byte> pstsdk::database_impl<T>::read_page_data(const page_in
         throw sig_mismatch("page sig mismatch", pi.address, pi.id, disk::compute_signature(pi.id, pi.address), ppage->trailer.signature);
 #endif
 
+    m_cache.insert(pi.address, buffer);
     return buffer;
 }
 
@@ -340,8 +476,8 @@ inline std::tr1::shared_ptr<pstsdk::nbt_page> pstsdk::database_impl<T>::read_nbt
 }
 
 template<typename T>
-inline pstsdk::database_impl<T>::database_impl(const std::wstring& filename)
-: m_file(filename)
+inline pstsdk::database_impl<T>::database_impl(const std::wstring& filename, bool validate_crc)
+: m_file(filename), m_validate_crc(validate_crc)
 {
     std::vector<byte> buffer(sizeof(m_header));
     m_file.read(buffer, 0);
@@ -63,6 +63,21 @@ struct subnode_info
     block_id sub_bid;
 };
 
+//! \brief Statistics of the page and block cache of a database context
+//! \ingroup ndb
+struct cache_stats
+{
+    ulonglong hits;         //!< Number of page and block reads served from the cache
+    ulonglong misses;       //!< Number of page and block reads which went to disk
+    ulonglong bytes_read;   //!< Total amount of bytes read from disk for pages and blocks
+    size_t cached_bytes;    //!< Amount of data currently held in the cache
+
+    //! \brief Fraction of reads served from the cache
+    //! \returns Value between 0.0 and 1.0
+    double hit_ratio() const
+        { return (hits + misses) > 0 ? (double)hits / (double)(hits + misses) : 0.0; }
+};
+
 template<typename K, typename V>
 class bt_page;
 typedef bt_page<node_id, node_info> nbt_page;
@@ -419,6 +434,18 @@ public:
     virtual std::tr1::shared_ptr<subnode_nonleaf_block> read_subnode_nonleaf_block(const shared_db_ptr& parent, const block_info& bi) = 0;
     //@}
 
+    //! \name Cache functions
+    //@{
+    //! \brief Get counters of the page and block cache
+    //! \returns Current cache statistics
+    virtual cache_stats get_cache_stats() const = 0;
+    //! \brief Change the amount of memory the page and block cache may use
+    //!
+    //! Setting the size to zero disables caching.
+    //! \param[in] max_bytes The new cache size in bytes
+    virtual void set_cache_size(size_t max_bytes) = 0;
+    //@}
+
 //! \cond write_api
     std::tr1::shared_ptr<external_block> create_external_block(size_t size) { return create_external_block(shared_from_this(), size); }
     std::tr1::shared_ptr<extended_block> create_extended_block(std::tr1::shared_ptr<external_block>& pblock) { return create_extended_block(shared_from_this(), pblock); }
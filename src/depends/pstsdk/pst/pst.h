@@ -57,8 +57,9 @@ public:
 
     //! \brief Construct a pst object from the specified file
     //! \param[in] filename The pst file to open on disk
-    pst(const std::wstring& filename) 
-        : m_db(open_database(filename)) { }
+    //! \param[in] validate_crc Check the CRC of every page and block read from the file
+    pst(const std::wstring& filename, bool validate_crc = default_crc_validation) 
+        : m_db(open_database(filename, validate_crc)) { }
 
 #ifndef BOOST_NO_RVALUE_REFERENCES
     //! \brief Move constructor
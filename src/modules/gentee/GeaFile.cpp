@@ -18,6 +18,7 @@ GeaFile::GeaFile()
 	m_nBlockSize = 0;
 	m_nSolidSize = 0;
 	m_sPattern = "";
+	m_pInBuffer = nullptr;
 	m_pOutBuffer = nullptr;
 	m_nOutBufferDataSize = 0;
 }
@@ -200,6 +201,7 @@ bool GeaFile::Open( AStream* inStream, int64_t startOffset, bool ownStream )
 	m_nBlockSize = head.blocksize * 0x40000;
 	m_nSolidSize = head.solidsize * 0x40000;
 	m_nLastSolid = 0xFFFFFFFF;
+	m_pInBuffer = (BYTE*) malloc(m_nBlockSize);
 	m_pOutBuffer = (BYTE*) malloc(m_nBlockSize + m_nSolidSize + 64);
 	m_nOutBufferDataSize = 0;
 	m_nHeadSize = head.size;
@@ -213,6 +215,11 @@ void GeaFile::Close()
 {
 	ppmd_stop();
 	
+	if (m_pInBuffer)
+	{
+		free(m_pInBuffer);
+		m_pInBuffer = nullptr;
+	}
 	if (m_pOutBuffer)
 	{
 		free(m_pOutBuffer);
@@ -298,15 +305,32 @@ GenteeExtractResult GeaFile::ExtractFile( int index, AStream* dest, const char*
 	if (index < 0 || index >= (int)m_vFiles.size())
 		return Failure;
 
-	const geafiledesc& gf = m_vFiles[index];
-	
-	if ((gf.flags & GEAF_SOLID) && (index - 1 != m_nLastSolid))
+	if ((m_vFiles[index].flags & GEAF_SOLID) && (index - 1 != (int) m_nLastSolid))
 	{
-		GenteeExtractResult prevResult = ExtractFile(index - 1, nullptr, password);
-		if (prevResult != Success)
-			return prevResult;
+		// Solid file depends on data of previous files, so walk back to the start of
+		// the solid run (or to the last decoded file) and decode forward from there
+		int startIndex = index - 1;
+		while ((startIndex > 0) && (m_vFiles[startIndex].flags & GEAF_SOLID) && (startIndex - 1 != (int) m_nLastSolid))
+			startIndex--;
+
+		for (int i = startIndex; i < index; i++)
+		{
+			GenteeExtractResult prevResult = DecodeFile(i, nullptr, password);
+			if (prevResult != Success)
+				return prevResult;
+		}
 	}
 
+	return DecodeFile(index, dest, password);
+}
+
+GenteeExtractResult GeaFile::DecodeFile( int index, AStream* dest, const char* password )
+{
+	const geafiledesc& gf = m_vFiles[index];
+
+	// Decoder state is valid only after successful decode
+	m_nLastSolid = 0xFFFFFFFF;
+
 	geadata gd = {0};
 	uint32_t fileCrc = CRC_SEED;
 	std::string filePass;
@@ -371,7 +395,7 @@ GenteeExtractResult GeaFile::ExtractFile( int index, AStream* dest, const char*
 		uint32_t isize = min(m_nBlockSize, gd.size);
 		uint32_t osize = min(m_nBlockSize, (uint32_t) bytesLeft);
 
-		BYTE* inBuf = (BYTE*) malloc(isize);
+		BYTE* inBuf = m_pInBuffer;
 		if (!ReadCompressedBlock(nextOffset, isize, inBuf))
 			return FailedRead;
 
@@ -379,7 +403,6 @@ GenteeExtractResult GeaFile::ExtractFile( int index, AStream* dest, const char*
 		{
 			//TODO: implement
 			//gea_protect(inBuf, isize, filePass.c_str());
-			free(inBuf);
 			return Failure;
 		}
 
@@ -407,7 +430,6 @@ GenteeExtractResult GeaFile::ExtractFile( int index, AStream* dest, const char*
 			ppmd_decode(inBuf, gd.size, outBuf, osize, &pm);
 			break;
 		default:
-			free(inBuf);
 			return FailedRead;
 		}
 
@@ -417,18 +439,16 @@ GenteeExtractResult GeaFile::ExtractFile( int index, AStream* dest, const char*
 		if (dest && outBuf)
 		{
 			if (!dest->WriteBuffer(outBuf, osize))
-			{
-				free(inBuf);
 				return FailedWrite;
-			}
 		}
 		bytesLeft -= osize;
-		free(inBuf);
 	}
 
-	m_nLastSolid = index;
+	if ((bytesLeft != 0) || ((fileCrc != gf.crc) && (gf.crc != 0)))
+		return FailedRead;
 
-	return (bytesLeft == 0) && ((fileCrc == gf.crc) || (gf.crc == 0)) ? Success : FailedRead;
+	m_nLastSolid = index;
+	return Success;
 }
 
 std::string GeaFile::ReadGeaString( AStream* data )
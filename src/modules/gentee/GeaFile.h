@@ -34,6 +34,7 @@ private:
 	uint32_t m_nLastSolid;
 	std::vector<int64_t> m_vVolOffs;
 	std::vector<int64_t> m_vVolSizes;
+	BYTE* m_pInBuffer;
 	BYTE* m_pOutBuffer;
 	size_t m_nOutBufferDataSize;
 	CMemoryStream m_pMovedData;
@@ -45,6 +46,7 @@ private:
 	std::string ReadGeaString(AStream* data);
 	bool ReadCompressedBlock(int64_t offs, uint32_t size, BYTE* buf);
 	bool CheckPassword(uint32_t passIndex, const char* password);
+	GenteeExtractResult DecodeFile(int index, AStream* dest, const char* password);
 
 public:
 	GeaFile();
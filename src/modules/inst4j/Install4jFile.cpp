@@ -4,27 +4,12 @@
 #include "modulecrt/PEHelper.h"
 
 #include "Decomp.h"
+#include "SequenceSearch.h"
 
 constexpr size_t MagicSize = 4;
 const uint8_t MAGIC_START[MagicSize] = { 0xD5, 0x13, 0xE4, 0xE8 };
 const uint8_t MAGIC_END[MagicSize] = { 0xE8, 0xE4, 0x13, 0xD5 };
 
-static const uint8_t* find_sequence(const uint8_t* data, size_t dataSize, const uint8_t* sequence, size_t sequenceSize)
-{
-	const uint8_t* searchPtr = data;
-	size_t searchSize = dataSize - sequenceSize + 1;
-	while (searchPtr = (const uint8_t*) memchr(searchPtr, (int)sequence[0], searchSize))
-	{
-		if (memcmp(searchPtr, sequence, sequenceSize) == 0)
-			return searchPtr;
-		
-		++searchPtr;
-		searchSize = dataSize - (searchPtr - data) - sequenceSize + 1;
-		if (searchSize < sequenceSize) break;
-	}
-	return nullptr;
-}
-
 //////////////////////////////////////////////////////////////////////////
 
 CInstall4jFile::CInstall4jFile()
@@ -83,33 +68,12 @@ bool CInstall4jFile::InternalOpen(CFileStream* inStream)
 
 	// We need to search for starting block end signature and position stream at the end
 	// Right now it is unknown how to reach data block without sequence searching
-	constexpr size_t bufSize = 32 * 1024;
-	auto readBuf = std::make_unique<uint8_t[]>(bufSize);
-	
-	int64_t bytesLeft = nOverlaySize;
-	bool endMagicFound = false;
-	while (bytesLeft > MagicSize)
-	{
-		int64_t streamPos = inStream->GetPos();
-		size_t readSize = min((size_t) bytesLeft, bufSize);
-		if (!inStream->ReadBuffer(readBuf.get(), readSize))
-			return false;
-
-		const uint8_t* magicPos = find_sequence(readBuf.get(), readSize, MAGIC_END, MagicSize);
-		if (magicPos)
-		{
-			size_t offset = magicPos - readBuf.get() + MagicSize;
-			inStream->SetPos(streamPos + offset);
-			endMagicFound = true;
-			break;
-		}
-
-		// Signature may not be aligned to 4 byte block so let's step back a little
-		inStream->Seek(MagicSize - 1, STREAM_CURRENT);
-		bytesLeft -= readSize + MagicSize - 1;
-	}
+	int64_t scanStartPos = inStream->GetPos();
+	int64_t magicEndOffset = scan_for_sequence([inStream](void* buf, size_t size) { return inStream->ReadBuffer(buf, size); },
+		nOverlaySize - MagicSize, MAGIC_END, MagicSize);
+	if (magicEndOffset < 0) return false;
 
-	if (!endMagicFound) return false;
+	inStream->SetPos(scanStartPos + magicEndOffset);
 
 	// For archives list integer values are in big endian
 
@@ -0,0 +1,66 @@
+#ifndef SequenceSearch_h__
+#define SequenceSearch_h__
+
+// Header only, so standalone benchmark can use exactly the same search code as the module
+
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+
+// memchr is vectorized in CRT, so it is used as fast filter for the first byte
+inline const uint8_t* find_sequence(const uint8_t* data, size_t dataSize, const uint8_t* sequence, size_t sequenceSize)
+{
+	if (sequenceSize == 0 || dataSize < sequenceSize)
+		return nullptr;
+
+	const uint8_t* searchPtr = data;
+	const uint8_t* searchEnd = data + (dataSize - sequenceSize + 1);
+	while (searchPtr < searchEnd)
+	{
+		searchPtr = (const uint8_t*) memchr(searchPtr, (int)sequence[0], searchEnd - searchPtr);
+		if (!searchPtr) break;
+
+		if (memcmp(searchPtr + 1, sequence + 1, sequenceSize - 1) == 0)
+			return searchPtr;
+
+		++searchPtr;
+	}
+	return nullptr;
+}
+
+// Reads up to scanSize bytes with readFunc(void* buffer, size_t size) -> bool and looks for sequence.
+// Returns number of bytes from scan start to the end of sequence, -1 if not found or read failed.
+// Data is read sequentially in large blocks, reader is not called again after sequence is found.
+template<typename ReadFunc>
+int64_t scan_for_sequence(ReadFunc readFunc, int64_t scanSize, const uint8_t* sequence, size_t sequenceSize, size_t bufSize = 1024 * 1024)
+{
+	if (sequenceSize == 0) return -1;
+
+	// Signature may cross block boundary, so tail of the block is kept for the next search
+	const size_t tailSize = sequenceSize - 1;
+	auto readBuf = std::make_unique<uint8_t[]>(bufSize + tailSize);
+
+	int64_t bytesLeft = scanSize;
+	int64_t bufStartPos = 0;
+	size_t dataSize = 0;
+	while (bytesLeft > 0)
+	{
+		size_t readSize = (bytesLeft < (int64_t) bufSize) ? (size_t) bytesLeft : bufSize;
+		if (!readFunc(readBuf.get() + dataSize, readSize))
+			return -1;
+		dataSize += readSize;
+		bytesLeft -= readSize;
+
+		const uint8_t* seqPos = find_sequence(readBuf.get(), dataSize, sequence, sequenceSize);
+		if (seqPos)
+			return bufStartPos + (seqPos - readBuf.get()) + sequenceSize;
+
+		size_t keepSize = (dataSize < tailSize) ? dataSize : tailSize;
+		memmove(readBuf.get(), readBuf.get() + dataSize - keepSize, keepSize);
+		bufStartPos += dataSize - keepSize;
+		dataSize = keepSize;
+	}
+	return -1;
+}
+
+#endif // SequenceSearch_h__
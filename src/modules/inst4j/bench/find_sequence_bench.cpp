@@ -0,0 +1,151 @@
+// Standalone benchmark for the install4j end marker search.
+// Not part of the module build.
+//
+// Creates synthetic file (default 500 MB) with the end marker placed right before its end
+// and times old (32 KB blocks, per block seek) and current (1 MB blocks, carried tail) scan.
+// Current scan uses SequenceSearch.h of the module, old one is kept here for comparison.
+//
+// Build: cl /O2 /EHsc find_sequence_bench.cpp   or   g++ -O2 -o find_sequence_bench find_sequence_bench.cpp
+// Usage: find_sequence_bench <work file> [size in MB]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+#include "../SequenceSearch.h"
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+constexpr size_t MagicSize = 4;
+const uint8_t MAGIC_END[MagicSize] = { 0xE8, 0xE4, 0x13, 0xD5 };
+
+static const uint8_t* find_sequence_old(const uint8_t* data, size_t dataSize, const uint8_t* sequence, size_t sequenceSize)
+{
+	const uint8_t* searchPtr = data;
+	size_t searchSize = dataSize - sequenceSize + 1;
+	while ((searchPtr = (const uint8_t*) memchr(searchPtr, (int)sequence[0], searchSize)))
+	{
+		if (memcmp(searchPtr, sequence, sequenceSize) == 0)
+			return searchPtr;
+
+		++searchPtr;
+		searchSize = dataSize - (searchPtr - data) - sequenceSize + 1;
+		if (searchSize < sequenceSize) break;
+	}
+	return nullptr;
+}
+
+// Returns stream position right after the marker or -1
+static int64_t scan_old(FILE* f, int64_t overlaySize)
+{
+	constexpr size_t bufSize = 32 * 1024;
+	auto readBuf = std::make_unique<uint8_t[]>(bufSize);
+
+	int64_t streamPos = MagicSize;
+	int64_t bytesLeft = overlaySize;
+	fseek64(f, streamPos, SEEK_SET);
+	while (bytesLeft > (int64_t) MagicSize)
+	{
+		size_t readSize = (size_t) std::min(bytesLeft, (int64_t) bufSize);
+		readSize = fread(readBuf.get(), 1, readSize, f);
+		if (readSize < MagicSize) return -1;
+
+		const uint8_t* magicPos = find_sequence_old(readBuf.get(), readSize, MAGIC_END, MagicSize);
+		if (magicPos)
+			return streamPos + (magicPos - readBuf.get()) + MagicSize;
+
+		streamPos += readSize + MagicSize - 1;
+		fseek64(f, MagicSize - 1, SEEK_CUR);
+		bytesLeft -= readSize + MagicSize - 1;
+	}
+	return -1;
+}
+
+static int64_t scan_new(FILE* f, int64_t overlaySize)
+{
+	fseek64(f, MagicSize, SEEK_SET);
+	int64_t magicEndOffset = scan_for_sequence([f](void* buf, size_t size) { return fread(buf, 1, size, f) == size; },
+		overlaySize - MagicSize, MAGIC_END, MagicSize);
+	return (magicEndOffset < 0) ? -1 : MagicSize + magicEndOffset;
+}
+
+static bool create_file(const char* path, int64_t fileSize)
+{
+	FILE* f = fopen(path, "wb");
+	if (!f) return false;
+
+	// Pseudo random content (like compressed overlay data) without accidental markers
+	const size_t chunkSize = 1024 * 1024;
+	auto chunk = std::make_unique<uint8_t[]>(chunkSize);
+	uint32_t seed = 12345;
+	for (int64_t written = 0; written < fileSize; written += chunkSize)
+	{
+		for (size_t i = 0; i < chunkSize; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			chunk[i] = (uint8_t) (seed >> 16);
+			if (i >= 3 && chunk[i] == MAGIC_END[3] && memcmp(&chunk[i - 3], MAGIC_END, MagicSize) == 0)
+				chunk[i]++;
+		}
+		size_t writeSize = (size_t) std::min((int64_t) chunkSize, fileSize - written);
+		fwrite(chunk.get(), 1, writeSize, f);
+	}
+
+	fseek64(f, fileSize - MagicSize, SEEK_SET);
+	fwrite(MAGIC_END, 1, MagicSize, f);
+	fclose(f);
+	return true;
+}
+
+template<typename F>
+static double time_scan(const char* path, int64_t fileSize, F scan, int64_t &result)
+{
+	double best = 1e9;
+	for (int run = 0; run < 3; run++)
+	{
+		FILE* f = fopen(path, "rb");
+		auto start = std::chrono::steady_clock::now();
+		result = scan(f, fileSize);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		fclose(f);
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: find_sequence_bench <work file> [size in MB]\n");
+		return 1;
+	}
+
+	const char* path = argv[1];
+	int64_t fileSize = ((argc > 2) ? atoi(argv[2]) : 500) * (int64_t) 1024 * 1024;
+	if (!create_file(path, fileSize))
+	{
+		printf("Can not create %s\n", path);
+		return 1;
+	}
+
+	int64_t resOld, resNew;
+	double tOld = time_scan(path, fileSize, scan_old, resOld);
+	double tNew = time_scan(path, fileSize, scan_new, resNew);
+	double mb = fileSize / (1024.0 * 1024.0);
+
+	printf("old: %.3f s (%.0f MB/s), marker end at %lld\n", tOld, mb / tOld, (long long) resOld);
+	printf("new: %.3f s (%.0f MB/s), marker end at %lld\n", tNew, mb / tNew, (long long) resNew);
+	printf("expected marker end at %lld\n", (long long) fileSize);
+
+	remove(path);
+	return (resNew == fileSize) ? 0 : 2;
+}
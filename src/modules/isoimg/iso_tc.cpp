@@ -155,7 +155,7 @@ static DWORD ReadDataByPos( const IsoImage* image, LONGLONG position, DWORD size
 	return 0;
 }
 
-static LONGLONG GetBlockOffset( const IsoImage* image, DWORD block )
+LONGLONG GetBlockOffset( const IsoImage* image, DWORD block )
 {
     return (LONGLONG)(DWORD)block * (WORD)image->RealBlockSize + (image->HeaderSize ? image->HeaderSize : image->DataOffset);
 }
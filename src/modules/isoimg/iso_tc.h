@@ -11,5 +11,7 @@ bool FreeImage( IsoImage* image );
 bool LoadAllTrees( IsoImage* image, Directory** dirs, DWORD* count, bool boot = false );
 
 DWORD ReadBlock( const IsoImage* image, DWORD block, DWORD size, void* data );
+// Position of the block in the image file (in unpacked data for ISZ)
+LONGLONG GetBlockOffset( const IsoImage* image, DWORD block );
 
 #endif //_ISO_TC_H_
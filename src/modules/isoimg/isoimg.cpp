@@ -105,10 +105,13 @@ int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo
 	if (dir.VolumeDescriptor->XBOX)
 	{
 		item_info->Size = (DWORD) dir.XBOXRecord.DataLength;
+		item_info->DataPosition = GetBlockOffset(image, dir.XBOXRecord.LocationOfExtent);
 	}
 	else
 	{
 		item_info->Size = (dir.Record.FileFlags & FATTR_DIRECTORY)? 0 : (DWORD) dir.Record.DataLength;
+		if ((dir.Record.FileFlags & FATTR_DIRECTORY) == 0)
+			item_info->DataPosition = GetBlockOffset(image, (DWORD) dir.Record.LocationOfExtent);
 
 		FILETIME ftime = VolumeDateTimeToFileTime(dir.Record.RecordingDateAndTime);
 		
@@ -116,6 +119,11 @@ int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo
 		item_info->CreationTime = ftime;
 	}
 
+	// Plain image with user data only sectors keeps file extent as is
+	DWORD sector = dir.VolumeDescriptor->XBOX ? 0x800 : (WORD)dir.VolumeDescriptor->VolumeDescriptor.LogicalBlockSize;
+	if (item_info->DataPosition > 0 && image->ImageType == ISOTYPE_RAW && sector == image->RealBlockSize)
+		item_info->DataFlags = ITEM_DATA_CONTIGUOUS;
+
 	return GET_ITEM_OK;
 }
 
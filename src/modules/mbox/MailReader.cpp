@@ -85,6 +85,12 @@ void IMailReader::Close()
 		fclose(m_pSrcFile);
 		m_pSrcFile = NULL;
 	}
+
+	if (m_pCopyBuf != NULL)
+	{
+		free(m_pCopyBuf);
+		m_pCopyBuf = NULL;
+	}
 }
 
 int IMailReader::Extract( int itemindex, const wchar_t* destpath )
@@ -98,18 +104,33 @@ int IMailReader::Extract( int itemindex, const wchar_t* destpath )
 
 	const MBoxItem& item = m_vItems[itemindex];
 
-	size_t copySize = (size_t) item.GetSize();
-	char* copyBuf = (char*) malloc(copySize);
+	if (m_pCopyBuf == NULL)
+		m_pCopyBuf = (char*) malloc(MAIL_COPY_BUFFER_SIZE);
+
 	int nRet = SER_SUCCESS;
 	
-	_fseeki64(m_pSrcFile, item.StartPos, SEEK_SET);
-	if (fread(copyBuf, 1, copySize, m_pSrcFile) != copySize)
-		nRet = SER_ERROR_READ;
-	else if (fwrite(copyBuf, 1, copySize, outp) != copySize)
-		nRet = SER_ERROR_WRITE;
+	// Host extracts items in index order, so usually we are already at the right place
+	if (_ftelli64(m_pSrcFile) != item.StartPos)
+		_fseeki64(m_pSrcFile, item.StartPos, SEEK_SET);
+
+	__int64 bytesLeft = item.GetSize();
+	while (bytesLeft > 0)
+	{
+		size_t copySize = (size_t) min(bytesLeft, (__int64) MAIL_COPY_BUFFER_SIZE);
+		if (fread(m_pCopyBuf, 1, copySize, m_pSrcFile) != copySize)
+		{
+			nRet = SER_ERROR_READ;
+			break;
+		}
+		if (fwrite(m_pCopyBuf, 1, copySize, outp) != copySize)
+		{
+			nRet = SER_ERROR_WRITE;
+			break;
+		}
+		bytesLeft -= copySize;
+	}
 	
 	fclose(outp);
-	free(copyBuf);
 
 	if (nRet != SER_SUCCESS)
 		_wunlink(destpath);
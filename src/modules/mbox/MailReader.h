@@ -21,16 +21,19 @@ struct MBoxItem
 	__int64 GetSize() const { return EndPos - StartPos; }
 };
 
+#define MAIL_COPY_BUFFER_SIZE (1024 * 1024)
+
 class IMailReader
 {
 protected:
 	FILE* m_pSrcFile;
+	char* m_pCopyBuf;
 	std::vector<MBoxItem> m_vItems;
 
 	const char* GetSenderAddress(GMimeMessage* message);
 
 public:
-	IMailReader() : m_pSrcFile(NULL) {}
+	IMailReader() : m_pSrcFile(NULL), m_pCopyBuf(NULL) {}
 	virtual ~IMailReader() { Close(); }
 
 	bool Open(const wchar_t* filepath);
@@ -0,0 +1,305 @@
+#include "StdAfx.h"
+#include "ContentDecode.h"
+
+#include <io.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define USE_SSSE3_BASE64
+#include <intrin.h>
+#include <tmmintrin.h>
+#endif
+
+#define DECODE_BUFFER_SIZE (256 * 1024)
+
+#define B64_SKIP 0x80
+#define B64_PAD 0x81
+
+struct Base64Table
+{
+	unsigned char Values[256];
+
+	Base64Table()
+	{
+		static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		memset(Values, B64_SKIP, sizeof(Values));
+		for (int i = 0; i < 64; i++)
+			Values[(unsigned char) alphabet[i]] = (unsigned char) i;
+		Values['='] = B64_PAD;
+	}
+};
+
+static const Base64Table g_Base64;
+
+struct DecodeState
+{
+	unsigned int accum;
+	int count;
+	bool finished;
+
+	DecodeState() : accum(0), count(0), finished(false) {}
+};
+
+#ifdef USE_SSSE3_BASE64
+
+static bool cpu_has_ssse3()
+{
+	int cpuInfo[4] = {0};
+	__cpuid(cpuInfo, 1);
+	return (cpuInfo[2] & (1 << 9)) != 0;
+}
+
+static bool g_fUseSsse3 = cpu_has_ssse3();
+
+// Decodes 16 byte blocks until the first block with non-alphabet character.
+// Each block produces 12 bytes, but 16 bytes are written, so output needs 4 spare bytes.
+// Returns number of input bytes consumed.
+static size_t base64_decode_blocks_ssse3(const unsigned char* in, size_t inSize, unsigned char* out)
+{
+	// Nibble lookup tables from W. Mula's "Base64 decoding with SIMD instructions"
+	const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i maskNibble = _mm_set1_epi8(0x0F);
+	const __m128i charSlash = _mm_set1_epi8('/');
+	const __m128i mergeBytes = _mm_set1_epi32(0x01400140);
+	const __m128i mergeWords = _mm_set1_epi32(0x00011000);
+	const __m128i packOrder = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t pos = 0;
+	while (inSize - pos >= 16)
+	{
+		__m128i src = _mm_loadu_si128((const __m128i*) (in + pos));
+		__m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(src, 4), maskNibble);
+		__m128i loNibbles = _mm_and_si128(src, maskNibble);
+
+		__m128i check = _mm_and_si128(_mm_shuffle_epi8(lutLo, loNibbles), _mm_shuffle_epi8(lutHi, hiNibbles));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(check, zero)) != 0xFFFF)
+			break;
+
+		__m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(src, charSlash), hiNibbles));
+		__m128i values = _mm_add_epi8(src, roll);
+
+		__m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(values, mergeBytes), mergeWords);
+		_mm_storeu_si128((__m128i*) out, _mm_shuffle_epi8(merged, packOrder));
+
+		out += 12;
+		pos += 16;
+	}
+
+	return pos;
+}
+
+#endif
+
+// Returns number of input bytes consumed, output size is returned in outSize
+typedef size_t (*DecodeStepFunc)(const unsigned char* in, size_t inSize, bool isFinal, unsigned char* out, size_t &outSize, DecodeState &state);
+
+static size_t base64_decode_step(const unsigned char* in, size_t inSize, bool isFinal, unsigned char* out, size_t &outSize, DecodeState &state)
+{
+	const unsigned char* table = g_Base64.Values;
+	const unsigned char* inPtr = in;
+	const unsigned char* inEnd = in + inSize;
+	unsigned char* outPtr = out;
+
+	while (!state.finished && (inPtr < inEnd))
+	{
+		// Fast path for whole quads, line breaks and padding are handled below
+		if (state.count == 0)
+		{
+#ifdef USE_SSSE3_BASE64
+			if (g_fUseSsse3)
+			{
+				size_t blocksSize = base64_decode_blocks_ssse3(inPtr, inEnd - inPtr, outPtr);
+				inPtr += blocksSize;
+				outPtr += blocksSize / 4 * 3;
+			}
+#endif
+			while (inEnd - inPtr >= 4)
+			{
+				unsigned int a = table[inPtr[0]], b = table[inPtr[1]], c = table[inPtr[2]], d = table[inPtr[3]];
+				if ((a | b | c | d) & 0x80) break;
+
+				unsigned int v = (a << 18) | (b << 12) | (c << 6) | d;
+				outPtr[0] = (unsigned char) (v >> 16);
+				outPtr[1] = (unsigned char) (v >> 8);
+				outPtr[2] = (unsigned char) v;
+
+				outPtr += 3;
+				inPtr += 4;
+			}
+			if (inPtr == inEnd) break;
+		}
+
+		unsigned char c = table[*inPtr++];
+		if (c == B64_SKIP) continue;
+
+		if (c == B64_PAD)
+		{
+			if (state.count == 2)
+			{
+				*outPtr++ = (unsigned char) (state.accum >> 4);
+			}
+			else if (state.count == 3)
+			{
+				*outPtr++ = (unsigned char) (state.accum >> 10);
+				*outPtr++ = (unsigned char) (state.accum >> 2);
+			}
+			state.finished = true;
+			break;
+		}
+
+		state.accum = (state.accum << 6) | c;
+		if (++state.count == 4)
+		{
+			outPtr[0] = (unsigned char) (state.accum >> 16);
+			outPtr[1] = (unsigned char) (state.accum >> 8);
+			outPtr[2] = (unsigned char) state.accum;
+			outPtr += 3;
+
+			state.accum = 0;
+			state.count = 0;
+		}
+	}
+
+	outSize = outPtr - out;
+	return state.finished ? inSize : (inPtr - in);
+}
+
+static inline int hex_value(unsigned char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+static size_t qp_decode_step(const unsigned char* in, size_t inSize, bool isFinal, unsigned char* out, size_t &outSize, DecodeState &state)
+{
+	const unsigned char* inPtr = in;
+	const unsigned char* inEnd = in + inSize;
+	unsigned char* outPtr = out;
+
+	while (inPtr < inEnd)
+	{
+		const unsigned char* eqPtr = (const unsigned char*) memchr(inPtr, '=', inEnd - inPtr);
+		if (!eqPtr)
+		{
+			memcpy(outPtr, inPtr, inEnd - inPtr);
+			outPtr += inEnd - inPtr;
+			inPtr = inEnd;
+			break;
+		}
+
+		memcpy(outPtr, inPtr, eqPtr - inPtr);
+		outPtr += eqPtr - inPtr;
+		inPtr = eqPtr;
+
+		size_t bytesLeft = inEnd - inPtr;
+		
+		// Escape sequence may continue in the next chunk
+		if ((bytesLeft < 3) && !isFinal) break;
+
+		if ((bytesLeft >= 2) && (inPtr[1] == '\n'))
+		{
+			inPtr += 2; // Soft line break
+		}
+		else if ((bytesLeft >= 3) && (inPtr[1] == '\r') && (inPtr[2] == '\n'))
+		{
+			inPtr += 3; // Soft line break
+		}
+		else if ((bytesLeft >= 3) && (hex_value(inPtr[1]) >= 0) && (hex_value(inPtr[2]) >= 0))
+		{
+			*outPtr++ = (unsigned char) ((hex_value(inPtr[1]) << 4) | hex_value(inPtr[2]));
+			inPtr += 3;
+		}
+		else
+		{
+			// Broken sequence, keep it as is
+			*outPtr++ = *inPtr++;
+		}
+	}
+
+	outSize = outPtr - out;
+	return inPtr - in;
+}
+
+static size_t copy_step(const unsigned char* in, size_t inSize, bool isFinal, unsigned char* out, size_t &outSize, DecodeState &state)
+{
+	memcpy(out, in, inSize);
+	outSize = inSize;
+	return inSize;
+}
+
+__int64 DecodePartContent(int fh, __int64 start, __int64 end, MimeContentEncoding encoding, FILE* dest)
+{
+	DecodeStepFunc decodeFunc;
+	switch (encoding)
+	{
+	case MIME_ENC_BASE64:
+		decodeFunc = base64_decode_step;
+		break;
+	case MIME_ENC_QP:
+		decodeFunc = qp_decode_step;
+		break;
+	case MIME_ENC_IDENTITY:
+		decodeFunc = copy_step;
+		break;
+	default:
+		// Let GMime filters handle everything else
+		return DECODE_UNSUPPORTED;
+	}
+
+	if (_lseeki64(fh, start, SEEK_SET) != start)
+		return DECODE_ERROR;
+
+	// Decoded data is never larger then input, so output also has room for 16 byte vector stores
+	unsigned char* inBuf = (unsigned char*) malloc(DECODE_BUFFER_SIZE);
+	unsigned char* outBuf = (unsigned char*) malloc(DECODE_BUFFER_SIZE);
+
+	DecodeState state;
+	__int64 totalSize = 0;
+	__int64 bytesLeft = end - start;
+	size_t bufDataSize = 0;
+	bool fError = false;
+
+	while (!fError)
+	{
+		size_t readSize = DECODE_BUFFER_SIZE - bufDataSize;
+		if ((__int64) readSize > bytesLeft) readSize = (size_t) bytesLeft;
+
+		int numRead = (readSize > 0) ? _read(fh, inBuf + bufDataSize, (unsigned int) readSize) : 0;
+		if (numRead < 0)
+		{
+			fError = true;
+			break;
+		}
+
+		bufDataSize += numRead;
+		bytesLeft -= numRead;
+		bool isFinal = (numRead == 0) || (bytesLeft == 0);
+
+		size_t outSize = 0;
+		size_t consumed = decodeFunc(inBuf, bufDataSize, isFinal, outBuf, outSize, state);
+
+		if (dest && (outSize > 0) && (fwrite(outBuf, 1, outSize, dest) != outSize))
+		{
+			fError = true;
+			break;
+		}
+		totalSize += outSize;
+
+		// Keep unprocessed tail for the next step
+		bufDataSize -= consumed;
+		if (bufDataSize > 0)
+			memmove(inBuf, inBuf + consumed, bufDataSize);
+
+		if (isFinal || state.finished) break;
+	}
+
+	free(inBuf);
+	free(outBuf);
+
+	return fError ? DECODE_ERROR : totalSize;
+}
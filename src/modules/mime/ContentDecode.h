@@ -0,0 +1,14 @@
+#ifndef ContentDecode_h__
+#define ContentDecode_h__
+
+#include "MimeIndex.h"
+
+#define DECODE_UNSUPPORTED -1
+#define DECODE_ERROR -2
+
+// Decodes part content straight from the file range using large buffers.
+// If dest is NULL then content is only measured.
+// Returns decoded size or one of DECODE_* codes.
+__int64 DecodePartContent(int fh, __int64 start, __int64 end, MimeContentEncoding encoding, FILE* dest);
+
+#endif // ContentDecode_h__
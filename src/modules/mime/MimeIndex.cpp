@@ -0,0 +1,669 @@
+#include "StdAfx.h"
+#include "MimeIndex.h"
+
+#define INDEX_BUFFER_SIZE (1024 * 1024)
+#define MAX_LINE_PREFIX (16 * 1024)
+
+//////////////////////////////////////////////////////////////////////////
+
+static bool is_header_space(char c)
+{
+	return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static std::string trim(const std::string &str)
+{
+	size_t start = 0, end = str.size();
+	while ((start < end) && is_header_space(str[start])) start++;
+	while ((end > start) && is_header_space(str[end - 1])) end--;
+
+	return str.substr(start, end - start);
+}
+
+static std::string trim_lower(const std::string &str)
+{
+	std::string result = trim(str);
+	for (size_t i = 0; i < result.size(); i++)
+		if (result[i] >= 'A' && result[i] <= 'Z') result[i] += 'a' - 'A';
+	return result;
+}
+
+__int64 SniffMimeHeaders(const char* buf, size_t bufSize)
+{
+	static const char* known_headers[] = { "From:", "Message-ID:", "MIME-Version:" };
+
+	size_t pos = 0;
+	if ((bufSize >= 3) && (memcmp(buf, "\xEF\xBB\xBF", 3) == 0))
+		pos = 3;
+	while ((pos < bufSize) && is_header_space(buf[pos]))
+		pos++;
+
+	size_t headerStart = pos;
+	while (pos < bufSize)
+	{
+		const char* line = buf + pos;
+		size_t lineLen = 0;
+		while ((pos + lineLen < bufSize) && (line[lineLen] != '\n'))
+			lineLen++;
+
+		// Empty line terminates header block
+		if ((lineLen == 0) || (lineLen == 1 && line[0] == '\r'))
+			return -1;
+
+		// Last line may be cut by the buffer end, so we can't judge it
+		if (pos + lineLen >= bufSize)
+			break;
+
+		if (line[0] != ' ' && line[0] != '\t')
+		{
+			// Header line should start with a field name followed by colon
+			size_t nameLen = 0;
+			while ((nameLen < lineLen) && (line[nameLen] > 32) && (line[nameLen] < 127) && (line[nameLen] != ':'))
+				nameLen++;
+			if ((nameLen == 0) || (nameLen == lineLen) || (line[nameLen] != ':'))
+				return -1;
+
+			for (size_t i = 0; i < _countof(known_headers); i++)
+			{
+				size_t hdrLen = strlen(known_headers[i]);
+				if ((nameLen + 1 == hdrLen) && (_strnicmp(line, known_headers[i], hdrLen) == 0))
+					return headerStart;
+			}
+		}
+
+		pos += lineLen + 1;
+	}
+
+	// Header block is longer then sample, let the parser decide
+	return (pos > headerStart) ? headerStart : -1;
+}
+
+bool ReadMimeHeaderBlock(MimeReadFunc readFunc, void* context, size_t maxSize, std::string &headers)
+{
+	headers.clear();
+
+	char buf[4096];
+	while (headers.size() < maxSize)
+	{
+		int numRead = readFunc(context, buf, sizeof(buf));
+		if (numRead < 0) return false;
+		if (numRead == 0) return true;
+
+		size_t searchStart = (headers.size() > 2) ? headers.size() - 2 : 0;
+		headers.append(buf, numRead);
+
+		for (size_t pos = headers.find('\n', searchStart); pos != std::string::npos; pos = headers.find('\n', pos + 1))
+		{
+			size_t next = pos + 1;
+			if ((next < headers.size()) && (headers[next] == '\r')) next++;
+			if ((next < headers.size()) && (headers[next] == '\n'))
+			{
+				headers.resize(next + 1);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+struct MimeLine
+{
+	__int64 Start;
+	__int64 Length;         // Without line ending
+	int EndingLen;
+	std::string Prefix;     // Up to MAX_LINE_PREFIX bytes of line
+	bool Truncated;         // Line does not fit into prefix, rest was passed to the counter
+};
+
+// Calculates decoded size the same way decoder would produce it, without storing any output.
+// Last line ending before boundary belongs to the boundary, so ending is kept pending
+// until next line arrives.
+class DecodedSizeCounter
+{
+private:
+	MimeContentEncoding m_nEncoding;
+	__int64 m_nSize;
+	int m_nPendingEnding;
+	bool m_fHasPending;
+
+	// Base64
+	__int64 m_nB64Chars;
+	bool m_fB64Padded;
+
+	// QP: 0 - plain text, 1 - after '=', 2 - after '=' and one hex digit
+	int m_nQpState;
+
+	void CommitPending()
+	{
+		if (!m_fHasPending) return;
+
+		if (m_nEncoding == MIME_ENC_QP && m_nQpState == 1)
+			m_nQpState = 0; // Soft line break
+		else if (m_nEncoding == MIME_ENC_QP)
+			m_nSize += m_nPendingEnding;
+
+		m_fHasPending = false;
+	}
+
+public:
+	DecodedSizeCounter(MimeContentEncoding enc) : m_nEncoding(enc), m_nSize(0), m_nPendingEnding(0), m_fHasPending(false),
+		m_nB64Chars(0), m_fB64Padded(false), m_nQpState(0) {}
+
+	void Data(const char* data, size_t dataSize)
+	{
+		CommitPending();
+
+		if (m_nEncoding == MIME_ENC_BASE64)
+		{
+			for (size_t i = 0; (i < dataSize) && !m_fB64Padded; i++)
+			{
+				char c = data[i];
+				if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (c == '+') || (c == '/'))
+					m_nB64Chars++;
+				else if (c == '=')
+					m_fB64Padded = true;
+			}
+		}
+		else if (m_nEncoding == MIME_ENC_QP)
+		{
+			for (size_t i = 0; i < dataSize; i++)
+			{
+				char c = data[i];
+				bool isHex = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
+
+				if (m_nQpState == 1)
+				{
+					if (isHex) { m_nQpState = 2; continue; }
+					m_nSize++; // Broken sequence, '=' is kept
+					m_nQpState = 0;
+				}
+				else if (m_nQpState == 2)
+				{
+					m_nQpState = 0;
+					if (isHex) { m_nSize++; continue; }
+					m_nSize += 2;
+				}
+
+				if (c == '=')
+					m_nQpState = 1;
+				else
+					m_nSize++;
+			}
+		}
+	}
+
+	void LineEnd(int endingLen)
+	{
+		CommitPending();
+
+		if (m_nEncoding == MIME_ENC_QP && m_nQpState == 2)
+		{
+			m_nSize += 2;
+			m_nQpState = 0;
+		}
+
+		m_nPendingEnding = endingLen;
+		m_fHasPending = true;
+	}
+
+	__int64 Finish(bool keepLastEnding)
+	{
+		if (keepLastEnding)
+			CommitPending();
+		m_fHasPending = false;
+
+		if (m_nEncoding == MIME_ENC_BASE64)
+		{
+			__int64 result = (m_nB64Chars / 4) * 3;
+			if (m_fB64Padded && (m_nB64Chars % 4 > 1))
+				result += (m_nB64Chars % 4) - 1;
+			return result;
+		}
+
+		if (m_nQpState == 1)
+			m_nSize++;
+		else if (m_nQpState == 2)
+			m_nSize += 2;
+		m_nQpState = 0;
+
+		return m_nSize;
+	}
+};
+
+class MimeLineReader
+{
+private:
+	MimeReadFunc m_fnRead;
+	void* m_pContext;
+
+	char* m_pBuf;
+	size_t m_nDataSize;
+	size_t m_nBufPos;
+	__int64 m_nBufOffset;
+	bool m_fEof;
+	bool m_fError;
+
+	bool Fill()
+	{
+		if (m_fEof) return false;
+
+		if (m_nBufPos > 0)
+		{
+			memmove(m_pBuf, m_pBuf + m_nBufPos, m_nDataSize - m_nBufPos);
+			m_nBufOffset += m_nBufPos;
+			m_nDataSize -= m_nBufPos;
+			m_nBufPos = 0;
+		}
+
+		int numRead = m_fnRead(m_pContext, m_pBuf + m_nDataSize, (int) (INDEX_BUFFER_SIZE - m_nDataSize));
+		if (numRead <= 0)
+		{
+			m_fEof = true;
+			m_fError = (numRead < 0);
+			return false;
+		}
+
+		m_nDataSize += numRead;
+		return true;
+	}
+
+	void Consume(MimeLine &line, size_t size, DecodedSizeCounter* counter)
+	{
+		const char* data = m_pBuf + m_nBufPos;
+		size_t prefixSpace = MAX_LINE_PREFIX - line.Prefix.size();
+
+		if (!line.Truncated && (size <= prefixSpace))
+		{
+			line.Prefix.append(data, size);
+		}
+		else
+		{
+			// Line is too long to be a boundary, so its content goes straight to the counter
+			if (!line.Truncated)
+			{
+				line.Truncated = true;
+				if (counter) counter->Data(line.Prefix.data(), line.Prefix.size());
+			}
+			if (counter) counter->Data(data, size);
+		}
+
+		line.Length += size;
+		m_nBufPos += size;
+	}
+
+public:
+	MimeLineReader(MimeReadFunc readFunc, void* context, __int64 startOffset)
+		: m_fnRead(readFunc), m_pContext(context), m_nDataSize(0), m_nBufPos(0), m_nBufOffset(startOffset), m_fEof(false), m_fError(false)
+	{
+		m_pBuf = (char*) malloc(INDEX_BUFFER_SIZE);
+	}
+
+	~MimeLineReader()
+	{
+		free(m_pBuf);
+	}
+
+	__int64 GetPos() const { return m_nBufOffset + m_nBufPos; }
+	bool IsError() const { return m_fError; }
+
+	// Returns false if there is no more lines
+	bool ReadLine(MimeLine &line, DecodedSizeCounter* counter)
+	{
+		line.Start = GetPos();
+		line.Length = 0;
+		line.EndingLen = 0;
+		line.Prefix.clear();
+		line.Truncated = false;
+
+		if ((m_nBufPos == m_nDataSize) && !Fill())
+			return false;
+
+		for (;;)
+		{
+			const char* data = m_pBuf + m_nBufPos;
+			size_t dataLeft = m_nDataSize - m_nBufPos;
+
+			const char* nl = (const char*) memchr(data, '\n', dataLeft);
+			if (nl)
+			{
+				size_t bodyLen = nl - data;
+				bool hasCR = (bodyLen > 0) && (nl[-1] == '\r');
+				if (hasCR) bodyLen--;
+
+				Consume(line, bodyLen, counter);
+				line.EndingLen = hasCR ? 2 : 1;
+				m_nBufPos += line.EndingLen;
+				return true;
+			}
+
+			// CR at the end of buffer may be a part of line ending
+			size_t safeLen = dataLeft;
+			if ((safeLen > 0) && (data[safeLen - 1] == '\r'))
+				safeLen--;
+			Consume(line, safeLen, counter);
+
+			if (!Fill())
+			{
+				// Last line without line ending
+				if (m_nBufPos < m_nDataSize)
+					Consume(line, m_nDataSize - m_nBufPos, counter);
+				return true;
+			}
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+enum ScanStop
+{
+	SCAN_EOF,
+	SCAN_BOUNDARY
+};
+
+struct ScanResult
+{
+	ScanStop Stop;
+	size_t Level;     // Index of matched boundary in the stack
+	bool IsClose;
+};
+
+struct EntityHeaders
+{
+	std::string ContentType;
+	std::string ContentDisposition;
+	std::string ContentLocation;
+	std::string ContentEncoding;
+	std::string Subject;
+};
+
+class MimeScanner
+{
+private:
+	MimeLineReader m_reader;
+	std::vector<std::string> m_boundaries;
+	std::vector<MimeIndexEntry> &m_entries;
+
+	// Returns true if line is a boundary of any open multipart, innermost goes first
+	bool MatchBoundary(const MimeLine &line, ScanResult &result)
+	{
+		if (line.Truncated || (line.Length < 2) || (line.Prefix[0] != '-') || (line.Prefix[1] != '-'))
+			return false;
+
+		for (size_t i = m_boundaries.size(); i > 0; i--)
+		{
+			const std::string &bnd = m_boundaries[i - 1];
+			if ((line.Prefix.size() < bnd.size() + 2) || (line.Prefix.compare(2, bnd.size(), bnd) != 0))
+				continue;
+
+			size_t pos = bnd.size() + 2;
+			bool isClose = (line.Prefix.compare(pos, 2, "--") == 0);
+			if (isClose) pos += 2;
+			while ((pos < line.Prefix.size()) && is_header_space(line.Prefix[pos]))
+				pos++;
+
+			if (pos == line.Prefix.size())
+			{
+				result.Stop = SCAN_BOUNDARY;
+				result.Level = i - 1;
+				result.IsClose = isClose;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static void StoreHeader(const std::string &line, EntityHeaders &headers, std::string* &current)
+	{
+		current = NULL;
+
+		size_t colonPos = line.find(':');
+		if (colonPos == std::string::npos) return;
+
+		std::string name = trim_lower(line.substr(0, colonPos));
+		if (name == "content-type")
+			current = &headers.ContentType;
+		else if (name == "content-disposition")
+			current = &headers.ContentDisposition;
+		else if (name == "content-location")
+			current = &headers.ContentLocation;
+		else if (name == "content-transfer-encoding")
+			current = &headers.ContentEncoding;
+		else if (name == "subject")
+			current = &headers.Subject;
+
+		if (current)
+			current->assign(line, colonPos + 1, std::string::npos);
+	}
+
+	// Reads header block, returns false if it was terminated by boundary or end of file
+	bool ReadHeaders(EntityHeaders &headers, ScanResult &result)
+	{
+		std::string* current = NULL;
+		MimeLine line;
+
+		while (m_reader.ReadLine(line, NULL))
+		{
+			if (MatchBoundary(line, result))
+				return false;
+
+			if (line.Length == 0)
+				return true;
+
+			if ((line.Prefix[0] == ' ' || line.Prefix[0] == '\t'))
+			{
+				if (current) current->append(line.Prefix);
+			}
+			else
+			{
+				StoreHeader(line.Prefix, headers, current);
+			}
+		}
+
+		result.Stop = SCAN_EOF;
+		return false;
+	}
+
+	static std::string GetBoundary(const std::string &contentType)
+	{
+		// Simple parameter lookup, boundary has to be a plain token or a quoted string
+		std::string origType = trim(contentType);
+		std::string lowerType = trim_lower(contentType);
+
+		size_t pos = 0;
+		while ((pos = lowerType.find("boundary", pos)) != std::string::npos)
+		{
+			bool isParam = (pos > 0) && (lowerType[pos - 1] == ';' || is_header_space(lowerType[pos - 1]));
+			size_t valPos = pos + 8;
+			pos = valPos;
+
+			while ((valPos < lowerType.size()) && is_header_space(lowerType[valPos])) valPos++;
+			if (!isParam || (valPos >= lowerType.size()) || (lowerType[valPos] != '='))
+				continue;
+			valPos++;
+			while ((valPos < lowerType.size()) && is_header_space(lowerType[valPos])) valPos++;
+
+			// Value is taken from the original string to keep the case
+			if ((valPos < origType.size()) && (origType[valPos] == '"'))
+			{
+				size_t endPos = origType.find('"', valPos + 1);
+				if (endPos == std::string::npos) return "";
+				return origType.substr(valPos + 1, endPos - valPos - 1);
+			}
+
+			size_t endPos = valPos;
+			while ((endPos < origType.size()) && (origType[endPos] != ';') && !is_header_space(origType[endPos]))
+				endPos++;
+			return origType.substr(valPos, endPos - valPos);
+		}
+
+		return "";
+	}
+
+	static MimeContentEncoding GetEncoding(const std::string &encoding)
+	{
+		std::string enc = trim_lower(encoding);
+		if (enc == "base64")
+			return MIME_ENC_BASE64;
+		if (enc == "quoted-printable")
+			return MIME_ENC_QP;
+		if (enc == "x-uuencode" || enc == "uuencode" || enc == "x-uue")
+			return MIME_ENC_OTHER;
+
+		// Same as GMime, unknown values are treated as no encoding
+		return MIME_ENC_IDENTITY;
+	}
+
+	ScanResult ScanLeaf(const EntityHeaders &headers, const std::string &mediaType)
+	{
+		MimeIndexEntry entry;
+		entry.ContentType = headers.ContentType;
+		entry.ContentDisposition = headers.ContentDisposition;
+		entry.ContentLocation = headers.ContentLocation;
+		entry.ContentEncoding = headers.ContentEncoding;
+		entry.Encoding = GetEncoding(headers.ContentEncoding);
+		entry.ContentStart = m_reader.GetPos();
+
+		if (mediaType == "message/rfc822" || mediaType == "message/news" || mediaType == "message/global")
+			entry.Kind = MIME_ENTRY_MESSAGE;
+		else if (mediaType == "message/partial")
+			entry.Kind = MIME_ENTRY_PARTIAL;
+
+		bool useCounter = (entry.Kind == MIME_ENTRY_PART) && (entry.Encoding == MIME_ENC_BASE64 || entry.Encoding == MIME_ENC_QP);
+		DecodedSizeCounter counter(entry.Encoding);
+
+		// Embedded message headers are scanned for subject
+		bool inSubHeaders = (entry.Kind == MIME_ENTRY_MESSAGE);
+		std::string* subHeader = NULL;
+		EntityHeaders subHeaders;
+
+		ScanResult result = { SCAN_EOF, 0, false };
+		int prevEnding = -1;
+		MimeLine line;
+
+		while (m_reader.ReadLine(line, useCounter ? &counter : NULL))
+		{
+			if (MatchBoundary(line, result))
+			{
+				entry.ContentEnd = (prevEnding >= 0) ? line.Start - prevEnding : entry.ContentStart;
+				break;
+			}
+
+			if (inSubHeaders)
+			{
+				if (line.Length == 0)
+					inSubHeaders = false;
+				else if (line.Prefix[0] == ' ' || line.Prefix[0] == '\t')
+					{ if (subHeader) subHeader->append(line.Prefix); }
+				else
+					StoreHeader(line.Prefix, subHeaders, subHeader);
+			}
+
+			if (useCounter)
+			{
+				if (!line.Truncated) counter.Data(line.Prefix.data(), line.Prefix.size());
+				counter.LineEnd(line.EndingLen);
+			}
+			prevEnding = line.EndingLen;
+		}
+
+		if (result.Stop == SCAN_EOF)
+			entry.ContentEnd = m_reader.GetPos();
+
+		entry.Subject = subHeaders.Subject;
+		if (useCounter)
+			entry.DecodedSize = counter.Finish(result.Stop == SCAN_EOF);
+		else if (entry.Kind == MIME_ENTRY_PARTIAL)
+			entry.DecodedSize = 0;
+		else if (entry.Encoding == MIME_ENC_OTHER && entry.Kind == MIME_ENTRY_PART)
+			entry.DecodedSize = -1;
+		else
+			entry.DecodedSize = entry.ContentEnd - entry.ContentStart;
+
+		m_entries.push_back(entry);
+		return result;
+	}
+
+	// Skips lines until boundary of the enclosing multipart or end of file
+	ScanResult SkipToBoundary()
+	{
+		ScanResult result = { SCAN_EOF, 0, false };
+		MimeLine line;
+		while (m_reader.ReadLine(line, NULL))
+		{
+			if (MatchBoundary(line, result))
+				break;
+		}
+		return result;
+	}
+
+	ScanResult ScanEntity(const char* defaultType)
+	{
+		EntityHeaders headers;
+		ScanResult result = { SCAN_EOF, 0, false };
+		__int64 entityStart = m_reader.GetPos();
+		if (!ReadHeaders(headers, result))
+		{
+			// Nothing after the last boundary
+			if ((result.Stop == SCAN_EOF) && (m_reader.GetPos() == entityStart))
+				return result;
+
+			// Truncated entity, list it as an empty part
+			MimeIndexEntry entry;
+			entry.ContentType = headers.ContentType;
+			entry.ContentDisposition = headers.ContentDisposition;
+			entry.ContentLocation = headers.ContentLocation;
+			entry.ContentStart = entry.ContentEnd = m_reader.GetPos();
+			m_entries.push_back(entry);
+			return result;
+		}
+
+		std::string mediaType = trim_lower(headers.ContentType.substr(0, headers.ContentType.find(';')));
+		if (mediaType.empty())
+			mediaType = defaultType;
+
+		std::string boundary = (mediaType.compare(0, 10, "multipart/") == 0) ? GetBoundary(headers.ContentType) : "";
+		if (boundary.empty())
+			return ScanLeaf(headers, mediaType);
+
+		size_t level = m_boundaries.size();
+		m_boundaries.push_back(boundary);
+
+		// Preamble
+		result = SkipToBoundary();
+
+		const char* childType = (mediaType == "multipart/digest") ? "message/rfc822" : "text/plain";
+		while ((result.Stop == SCAN_BOUNDARY) && (result.Level == level) && !result.IsClose)
+			result = ScanEntity(childType);
+
+		m_boundaries.pop_back();
+
+		// Epilogue
+		if ((result.Stop == SCAN_BOUNDARY) && (result.Level == level))
+			result = SkipToBoundary();
+
+		return result;
+	}
+
+public:
+	MimeScanner(MimeReadFunc readFunc, void* context, __int64 startOffset, std::vector<MimeIndexEntry> &entries)
+		: m_reader(readFunc, context, startOffset), m_entries(entries) {}
+
+	bool Scan()
+	{
+		ScanEntity("text/plain");
+		return !m_reader.IsError();
+	}
+};
+
+bool BuildMimeIndex(MimeReadFunc readFunc, void* context, __int64 startOffset, std::vector<MimeIndexEntry> &entries)
+{
+	entries.clear();
+
+	MimeScanner scanner(readFunc, context, startOffset, entries);
+	return scanner.Scan();
+}
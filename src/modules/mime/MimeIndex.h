@@ -0,0 +1,56 @@
+#ifndef MimeIndex_h__
+#define MimeIndex_h__
+
+#include <string>
+#include <vector>
+
+enum MimeEntryKind
+{
+	MIME_ENTRY_PART,
+	MIME_ENTRY_MESSAGE,     // message/rfc822, extracted as is
+	MIME_ENTRY_PARTIAL      // message/partial, has no content of its own
+};
+
+enum MimeContentEncoding
+{
+	MIME_ENC_IDENTITY,      // 7bit, 8bit, binary or missing header
+	MIME_ENC_BASE64,
+	MIME_ENC_QP,
+	MIME_ENC_OTHER          // Anything else is decoded by GMime
+};
+
+struct MimeIndexEntry
+{
+	MimeEntryKind Kind;
+	MimeContentEncoding Encoding;
+
+	// Raw unfolded header values
+	std::string ContentType;
+	std::string ContentDisposition;
+	std::string ContentLocation;
+	std::string ContentEncoding;
+	std::string Subject;    // Subject of embedded message for MIME_ENTRY_MESSAGE
+
+	__int64 ContentStart;
+	__int64 ContentEnd;
+	__int64 DecodedSize;    // -1 if size can not be calculated without decoding
+
+	MimeIndexEntry() : Kind(MIME_ENTRY_PART), Encoding(MIME_ENC_IDENTITY), ContentStart(0), ContentEnd(0), DecodedSize(0) {}
+};
+
+// Returns number of bytes read, 0 on end of file or negative value on error
+typedef int (*MimeReadFunc)(void* context, char* buf, int size);
+
+// Skips BOM and leading blank space, returns offset where header block starts
+// or -1 if sample does not look like the start of MIME message.
+__int64 SniffMimeHeaders(const char* buf, size_t bufSize);
+
+// Reads top level header block starting at current reader position.
+// Data includes terminating empty line if it is present.
+bool ReadMimeHeaderBlock(MimeReadFunc readFunc, void* context, size_t maxSize, std::string &headers);
+
+// Scans whole message starting at current reader position (which corresponds to startOffset)
+// and records location of every leaf part. Content is not decoded.
+bool BuildMimeIndex(MimeReadFunc readFunc, void* context, __int64 startOffset, std::vector<MimeIndexEntry> &entries);
+
+#endif // MimeIndex_h__
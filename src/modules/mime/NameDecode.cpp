@@ -5,10 +5,8 @@ static bool SameText(const char* str1, const char* str2)
 	return _stricmp(str1, str2) == 0;
 }
 
-static void GenerateFileName(GMimeObject* entity, wchar_t* dest, size_t destSize)
+static void GenerateFileName(GMimeContentType* ctype, wchar_t* dest, size_t destSize)
 {
-	GMimeContentType* ctype = g_mime_object_get_content_type(entity);
-
 	const char* szType = g_mime_content_type_get_media_type(ctype);
 	const char* szSubType = g_mime_content_type_get_media_subtype(ctype);
 
@@ -71,32 +69,31 @@ static void RemoveUrlComponent(wchar_t* filename)
 	if (bPos) wmemmove(filename, bPos + 1, wcslen(bPos + 1) + 1);
 }
 
-void GetEntityName(GMimePart* entity, wchar_t* dest, size_t destSize, GMimeParserOptions* parserOpts)
+static bool TryEntityName(const char* value, wchar_t* dest, size_t destSize, GMimeParserOptions* parserOpts)
 {
-	const char* contentDesp = g_mime_object_get_content_disposition_parameter((GMimeObject*) entity, "filename");
-	if (contentDesp)
-	{
-		DecodeStr(contentDesp, dest, destSize, parserOpts);
-		RemoveUrlComponent(dest);
-		if (wcslen(dest) > 1) return;
-	}
+	if (!value) return false;
 
-	const char* contentType = g_mime_object_get_content_type_parameter((GMimeObject*) entity, "name");
-	if (contentType)
-	{
-		DecodeStr(contentType, dest, destSize, parserOpts);
-		RemoveUrlComponent(dest);
-		if (wcslen(dest) > 1) return;
-	}
+	DecodeStr(value, dest, destSize, parserOpts);
+	RemoveUrlComponent(dest);
+	return wcslen(dest) > 1;
+}
 
-	const char* contetLocation = g_mime_part_get_content_location(entity);
-	if (contetLocation)
-	{
-		DecodeStr(contetLocation, dest, destSize, parserOpts);
+void GetEntityName(const char* contentType, const char* contentDisposition, const char* contentLocation, wchar_t* dest, size_t destSize, GMimeParserOptions* parserOpts)
+{
+	GMimeContentType* ctype = g_mime_content_type_parse(parserOpts, (contentType && *contentType) ? contentType : "text/plain");
+	GMimeContentDisposition* disp = (contentDisposition && *contentDisposition) ? g_mime_content_disposition_parse(parserOpts, contentDisposition) : NULL;
 
-		RemoveUrlComponent(dest);
-		if (wcslen(dest) > 1) return;
+	std::string strLocation(contentLocation ? contentLocation : "");
+	strLocation.erase(0, strLocation.find_first_not_of(" \t\r\n"));
+	strLocation.erase(strLocation.find_last_not_of(" \t\r\n") + 1);
+
+	if (!TryEntityName(disp ? g_mime_content_disposition_get_parameter(disp, "filename") : NULL, dest, destSize, parserOpts)
+		&& !TryEntityName(g_mime_content_type_get_parameter(ctype, "name"), dest, destSize, parserOpts)
+		&& !TryEntityName(strLocation.empty() ? NULL : strLocation.c_str(), dest, destSize, parserOpts))
+	{
+		GenerateFileName(ctype, dest, destSize);
 	}
 
-	GenerateFileName((GMimeObject*) entity, dest, destSize);
+	if (disp) g_object_unref(disp);
+	g_object_unref(ctype);
 }
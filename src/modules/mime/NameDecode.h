@@ -4,6 +4,7 @@
 //std::wstring GetEntityName(mimetic::MimeEntity* entity);
 //void AppendDigit(std::wstring &fileName, int num);
 
-void GetEntityName(GMimePart* entity, wchar_t* dest, size_t destSize, GMimeParserOptions* parserOpts);
+// Takes raw header values, any of them may be NULL
+void GetEntityName(const char* contentType, const char* contentDisposition, const char* contentLocation, wchar_t* dest, size_t destSize, GMimeParserOptions* parserOpts);
 
 #endif // NameDecode_h__
\ No newline at end of file
@@ -0,0 +1,279 @@
+// Standalone benchmark for MIME part decoding.
+// Not part of the module build.
+//
+// Writes base64 (76 chars per line) and quoted-printable test parts to work dir,
+// checks that native decoder restores the original data and then measures:
+//   - native decoder with SSSE3 blocks (x86/x64 only),
+//   - native decoder with scalar code only,
+//   - GMime data wrapper, the path used before native decoding was added
+//     (only if GMime headers are available).
+//
+// Build next to module sources, for example:
+//   cl /O2 /EHsc /I.. /I<gmime and glib include dirs> decode_bench.cpp gmime-3.0.lib glib-2.0.lib gobject-2.0.lib
+// Usage: decode_bench <work dir> [part size in MB] [runs]
+
+#include "../ContentDecode.cpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#if defined(__has_include)
+#if __has_include(<gmime/gmime.h>)
+#define BENCH_WITH_GMIME
+#endif
+#endif
+
+static const char g_Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void make_source(std::vector<unsigned char> &data, size_t size, bool isText)
+{
+	data.resize(size);
+	unsigned int seed = 1;
+	for (size_t i = 0; i < size; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		unsigned char val = (unsigned char) (seed >> 24);
+		if (isText)
+		{
+			size_t linePos = i % 74;
+			val = (linePos == 72) ? '\r' : (linePos == 73) ? '\n' : ((val < 8) ? 0xE0 + (val & 7) : 'a' + val % 26);
+		}
+		data[i] = val;
+	}
+}
+
+static std::string encode_base64(const std::vector<unsigned char> &data)
+{
+	std::string result;
+	result.reserve(data.size() / 3 * 4 + data.size() / 57 * 2 + 8);
+
+	size_t lineLen = 0;
+	for (size_t i = 0; i < data.size(); i += 3)
+	{
+		unsigned int v = data[i] << 16;
+		size_t n = data.size() - i;
+		if (n > 1) v |= data[i + 1] << 8;
+		if (n > 2) v |= data[i + 2];
+
+		result += g_Alphabet[(v >> 18) & 63];
+		result += g_Alphabet[(v >> 12) & 63];
+		result += (n > 1) ? g_Alphabet[(v >> 6) & 63] : '=';
+		result += (n > 2) ? g_Alphabet[v & 63] : '=';
+
+		lineLen += 4;
+		if (lineLen == 76)
+		{
+			result += "\r\n";
+			lineLen = 0;
+		}
+	}
+	return result;
+}
+
+static std::string encode_qp(const std::vector<unsigned char> &data)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	std::string result;
+
+	size_t lineLen = 0;
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		unsigned char c = data[i];
+		if (c == '\r' && (i + 1 < data.size()) && data[i + 1] == '\n')
+		{
+			result += "\r\n";
+			lineLen = 0;
+			i++;
+			continue;
+		}
+
+		if (lineLen >= 72)
+		{
+			result += "=\r\n";
+			lineLen = 0;
+		}
+
+		if (c >= 128 || c == '=' || c == '\r' || c == '\n')
+		{
+			result += '=';
+			result += hex[c >> 4];
+			result += hex[c & 15];
+			lineLen += 3;
+		}
+		else
+		{
+			result += (char) c;
+			lineLen++;
+		}
+	}
+	return result;
+}
+
+static bool write_file(const std::string &path, const std::string &content)
+{
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f) return false;
+	bool ok = fwrite(content.data(), 1, content.size(), f) == content.size();
+	fclose(f);
+	return ok;
+}
+
+static bool read_file(const std::string &path, std::vector<unsigned char> &content)
+{
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f) return false;
+	content.clear();
+	unsigned char buf[64 * 1024];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		content.insert(content.end(), buf, buf + n);
+	fclose(f);
+	return true;
+}
+
+static double run_native(int fh, __int64 size, MimeContentEncoding enc, __int64 &decodedSize)
+{
+	auto start = std::chrono::steady_clock::now();
+	decodedSize = DecodePartContent(fh, 0, size, enc, NULL);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#ifdef BENCH_WITH_GMIME
+static double run_gmime(int fh, __int64 size, GMimeContentEncoding enc, __int64 &decodedSize)
+{
+	_lseeki64(fh, 0, SEEK_SET);
+	GMimeStream* fileStream = g_mime_stream_fs_new(fh);
+	g_mime_stream_fs_set_owner((GMimeStreamFs*) fileStream, FALSE);
+	GMimeStream* partStream = g_mime_stream_substream_new(fileStream, 0, size);
+	GMimeDataWrapper* wrap = g_mime_data_wrapper_new_with_stream(partStream, enc);
+	GMimeStream* nullStream = g_mime_stream_null_new();
+
+	auto start = std::chrono::steady_clock::now();
+	decodedSize = g_mime_data_wrapper_write_to_stream(wrap, nullStream);
+	double result = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	g_object_unref(nullStream);
+	g_object_unref(wrap);
+	g_object_unref(partStream);
+	g_object_unref(fileStream);
+	return result;
+}
+#endif
+
+static bool bench_encoding(const std::string &workDir, const char* name, MimeContentEncoding enc, size_t dataSize, int runs)
+{
+	std::vector<unsigned char> source;
+	make_source(source, dataSize, enc == MIME_ENC_QP);
+	std::string encoded = (enc == MIME_ENC_QP) ? encode_qp(source) : encode_base64(source);
+
+	std::string encPath = workDir + "/" + name + ".enc";
+	std::string decPath = workDir + "/" + name + ".dec";
+	if (!write_file(encPath, encoded))
+	{
+		printf("Can not write %s\n", encPath.c_str());
+		return false;
+	}
+
+	int fh = _open(encPath.c_str(), _O_RDONLY | _O_BINARY);
+	if (fh < 0) return false;
+
+	// Correctness check through file output, the same as ExtractItem does
+	FILE* dest = fopen(decPath.c_str(), "wb");
+	__int64 written = DecodePartContent(fh, 0, encoded.size(), enc, dest);
+	fclose(dest);
+
+	std::vector<unsigned char> decoded;
+	read_file(decPath, decoded);
+	remove(decPath.c_str());
+	if (written != (__int64) source.size() || decoded != source)
+	{
+		printf("%s: decoded data mismatch (%lld of %zu bytes)\n", name, written, source.size());
+		_close(fh);
+		return false;
+	}
+
+	printf("%s: %.1f MB encoded, %.1f MB decoded\n", name, encoded.size() / 1048576.0, source.size() / 1048576.0);
+	for (int i = 0; i < runs; i++)
+	{
+		__int64 size;
+		double t;
+#ifdef USE_SSSE3_BASE64
+		if (enc == MIME_ENC_BASE64 && cpu_has_ssse3())
+		{
+			g_fUseSsse3 = true;
+			t = run_native(fh, encoded.size(), enc, size);
+			printf("  native ssse3  %.3f s  %.0f MB/s\n", t, encoded.size() / t / 1048576.0);
+		}
+		g_fUseSsse3 = false;
+#endif
+		t = run_native(fh, encoded.size(), enc, size);
+		printf("  native scalar %.3f s  %.0f MB/s\n", t, encoded.size() / t / 1048576.0);
+
+#ifdef BENCH_WITH_GMIME
+		t = run_gmime(fh, encoded.size(), (enc == MIME_ENC_QP) ? GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE : GMIME_CONTENT_ENCODING_BASE64, size);
+		printf("  gmime         %.3f s  %.0f MB/s%s\n", t, encoded.size() / t / 1048576.0, (size == (__int64) source.size()) ? "" : "  (size mismatch)");
+#endif
+	}
+
+	_close(fh);
+	remove(encPath.c_str());
+	return true;
+}
+
+#ifdef USE_SSSE3_BASE64
+// Vector block has to stop on every character the scalar table does not accept
+static bool check_ssse3_alphabet()
+{
+	unsigned char block[16], out[16];
+	for (int c = 0; c < 256; c++)
+	{
+		memset(block, 'A', sizeof(block));
+		block[c % 16] = (unsigned char) c;
+
+		bool isValid = (g_Base64.Values[c] & 0x80) == 0;
+		size_t consumed = base64_decode_blocks_ssse3(block, sizeof(block), out);
+		if ((consumed == 16) != isValid)
+		{
+			printf("SSSE3 block check failed for character %d\n", c);
+			return false;
+		}
+	}
+	return true;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: decode_bench <work dir> [part size in MB] [runs]\n");
+		return 1;
+	}
+
+	std::string workDir = argv[1];
+	size_t dataSize = ((argc > 2) ? atoi(argv[2]) : 64) * 1024 * 1024 + 1;
+	int runs = (argc > 3) ? atoi(argv[3]) : 3;
+
+#ifdef BENCH_WITH_GMIME
+	g_mime_init();
+#else
+	printf("GMime headers not found, only native decoder is measured\n");
+#endif
+
+#ifdef USE_SSSE3_BASE64
+	if (cpu_has_ssse3() && !check_ssse3_alphabet())
+		return 2;
+#endif
+
+	bool ok = bench_encoding(workDir, "base64", MIME_ENC_BASE64, dataSize, runs)
+		&& bench_encoding(workDir, "qp", MIME_ENC_QP, dataSize, runs);
+
+#ifdef BENCH_WITH_GMIME
+	g_mime_shutdown();
+#endif
+
+	return ok ? 0 : 2;
+}
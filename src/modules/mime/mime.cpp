@@ -11,20 +11,29 @@
 #include <sys/stat.h>
 #include <share.h>
 
+#include "MimeIndex.h"
 #include "NameDecode.h"
+#include "ContentDecode.h"
 
 static GMimeParserOptions* g_parserOpts = nullptr;
 
+#define MIME_SNIFF_SIZE (4 * 1024)
+#define MIME_MAX_HEADERS_SIZE (1024 * 1024)
+
 struct MimeFileInfo
 {
-	GMimeParser* parserRef;
-	GMimeMessage* messageRef;
+	int fileHandle;
+	GMimeStream* fileStream;
+	__int64 headersStart;
 
-	std::vector<GMimeObject*> messageParts;
+	GMimeMessage* headersRef;       // Message built from the top header block only
 	GMimeStream* headersDecoded;
 	FILETIME msgTime;
 
-	MimeFileInfo() : parserRef(NULL), messageRef(NULL), msgTime(), headersDecoded(NULL) {}
+	std::vector<MimeIndexEntry> parts;
+	bool partsIndexed;
+
+	MimeFileInfo() : fileHandle(-1), fileStream(NULL), headersStart(0), headersRef(NULL), headersDecoded(NULL), msgTime(), partsIndexed(false) {}
 };
 
 static bool is_mbox(int fh)
@@ -39,14 +48,9 @@ static bool is_mbox(int fh)
 	return fResult;
 }
 
-static void message_foreach_callback(GMimeObject *parent, GMimeObject *part, gpointer user_data)
+static int read_file_callback(void* context, char* buf, int size)
 {
-	MimeFileInfo* mi = (MimeFileInfo*) user_data;
-	
-	if (GMIME_IS_MULTIPART (part))
-		; // Skip these parts
-	else
-		mi->messageParts.push_back(part);
+	return _read(*(int*) context, buf, size);
 }
 
 static void generate_headers_fake_file(MimeFileInfo *info)
@@ -54,7 +58,7 @@ static void generate_headers_fake_file(MimeFileInfo *info)
 	GMimeStream* memStrm = g_mime_stream_mem_new();
 	g_mime_stream_mem_set_owner((GMimeStreamMem*) memStrm, TRUE);
 
-	GMimeHeaderList* headers = g_mime_object_get_header_list((GMimeObject*) info->messageRef);
+	GMimeHeaderList* headers = g_mime_object_get_header_list((GMimeObject*) info->headersRef);
 	int numHeaders = g_mime_header_list_get_count(headers);
 	for (int i = 0; i < numHeaders; ++i)
 	{
@@ -69,16 +73,30 @@ static void generate_headers_fake_file(MimeFileInfo *info)
 	info->headersDecoded = memStrm;
 }
 
+// Decodes content with GMime filters, used for encodings without native decoder
+static __int64 write_part_with_gmime(MimeFileInfo* info, const MimeIndexEntry &part, GMimeStream* destStream)
+{
+	GMimeStream* partStream = g_mime_stream_substream_new(info->fileStream, part.ContentStart, part.ContentEnd);
+	GMimeContentEncoding enc = g_mime_content_encoding_from_string(part.ContentEncoding.c_str());
+	GMimeDataWrapper* wrap = g_mime_data_wrapper_new_with_stream(partStream, enc);
+
+	__int64 result = g_mime_data_wrapper_write_to_stream(wrap, destStream);
+
+	g_object_unref(wrap);
+	g_object_unref(partStream);
+	return result;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, StorageGeneralInfo* info)
 {
 	__int64 nSize = GetFileSize(params.FilePath);
-	if (nSize < 10 || nSize > 100 * 1024 * 1024)
+	if (nSize < 10)
 		return SOR_INVALID_FILE;
 	
 	int fh;
-	if (_wsopen_s(&fh, params.FilePath, _O_RDONLY, _SH_DENYWR, _S_IREAD) != 0)
+	if (_wsopen_s(&fh, params.FilePath, _O_RDONLY | _O_BINARY, _SH_DENYWR, _S_IREAD) != 0)
 		return SOR_INVALID_FILE;
 
 	// Check if we are dealing with mbox file
@@ -87,19 +105,45 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 		_close(fh);
 		return SOR_INVALID_FILE;
 	}
-	
-	GMimeStream* stream = g_mime_stream_fs_new(fh);
-	g_mime_stream_fs_set_owner((GMimeStreamFs*)stream, TRUE);
 
-	GMimeParser* parser = g_mime_parser_new_with_stream(stream);
-	g_mime_parser_set_persist_stream(parser, TRUE);
-	g_mime_parser_set_format(parser, GMIME_FORMAT_MESSAGE);
-	g_object_unref(stream);
+	// Sniff headers before reading anything else
+	char sniffBuf[MIME_SNIFF_SIZE];
+	const char* sniffData = (const char*) params.Data;
+	size_t sniffSize = params.DataSize;
+	if (!sniffData || (sniffSize < MIME_SNIFF_SIZE && sniffSize < (size_t) nSize))
+	{
+		int numRead = _read(fh, sniffBuf, sizeof(sniffBuf));
+
+		sniffData = sniffBuf;
+		sniffSize = (numRead > 0) ? (size_t) numRead : 0;
+	}
+
+	__int64 headersStart = SniffMimeHeaders(sniffData, (sniffSize < MIME_SNIFF_SIZE) ? sniffSize : MIME_SNIFF_SIZE);
+	if (headersStart < 0)
+	{
+		_close(fh);
+		return SOR_INVALID_FILE;
+	}
 
+	// Only top header block is parsed here, parts are indexed when listing is requested
+	std::string strHeaders;
+	_lseeki64(fh, headersStart, SEEK_SET);
+	if (!ReadMimeHeaderBlock(read_file_callback, &fh, MIME_MAX_HEADERS_SIZE, strHeaders))
+	{
+		_close(fh);
+		return SOR_INVALID_FILE;
+	}
+
+	GMimeStream* headersStream = g_mime_stream_mem_new_with_buffer(strHeaders.data(), strHeaders.size());
+	GMimeParser* parser = g_mime_parser_new_with_stream(headersStream);
+	g_mime_parser_set_format(parser, GMIME_FORMAT_MESSAGE);
 	GMimeMessage* message = g_mime_parser_construct_message(parser, g_parserOpts);
+	g_object_unref(parser);
+	g_object_unref(headersStream);
+
 	if (message == NULL)
 	{
-		g_object_unref(parser);
+		_close(fh);
 		return SOR_INVALID_FILE;
 	}
 
@@ -110,22 +154,23 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 		const char* hdr_ver_str = g_mime_object_get_header((GMimeObject*)message, "MIME-Version");
 		if (!hdr_from_str && !hdr_msg_id && !hdr_ver_str)
 		{
-			g_object_unref(parser);
 			g_object_unref(message);
+			_close(fh);
 			return SOR_INVALID_FILE;
 		}
 	}
 
 	GMimeObject* mime_part = g_mime_message_get_mime_part(message);
-	GMimeContentType* ctype = g_mime_object_get_content_type(mime_part);
+	GMimeContentType* ctype = mime_part ? g_mime_object_get_content_type(mime_part) : NULL;
 	const char* szType = ctype ? g_mime_content_type_get_media_type(ctype) : NULL;
 	const char* szSubType = ctype ? g_mime_content_type_get_media_subtype(ctype) : NULL;
 
 	GDateTime* dtMsgTime = g_mime_message_get_date(message);
 
 	MimeFileInfo* minfo = new MimeFileInfo();
-	minfo->messageRef = message;
-	minfo->parserRef = parser;
+	minfo->fileHandle = fh;
+	minfo->headersStart = headersStart;
+	minfo->headersRef = message;
 	
 	if (dtMsgTime)
 	{
@@ -134,9 +179,6 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 		g_date_time_unref(dtMsgUtc);
 	}
 
-	g_mime_message_foreach(message, message_foreach_callback, minfo);
-	generate_headers_fake_file(minfo);
-	
 	*storage = minfo;
 
 	memset(info, 0, sizeof(StorageGeneralInfo));
@@ -152,9 +194,12 @@ void MODULE_EXPORT CloseStorage(HANDLE storage)
 	MimeFileInfo *minfo = (MimeFileInfo*) storage;
 	if (minfo)
 	{
-		g_object_unref(minfo->messageRef);
-		g_object_unref(minfo->parserRef);
-		g_object_unref(minfo->headersDecoded);
+		g_object_unref(minfo->headersRef);
+		if (minfo->headersDecoded)
+			g_object_unref(minfo->headersDecoded);
+		if (minfo->fileStream)
+			g_object_unref(minfo->fileStream);
+		_close(minfo->fileHandle);
 
 		delete minfo;
 	}
@@ -162,6 +207,29 @@ void MODULE_EXPORT CloseStorage(HANDLE storage)
 
 int MODULE_EXPORT PrepareFiles(HANDLE storage)
 {
+	MimeFileInfo *minfo = (MimeFileInfo*) storage;
+	if (minfo == NULL) return FALSE;
+
+	// Parts are only located here, content is decoded on extraction
+	if (!minfo->partsIndexed)
+	{
+		// GMime stream is used only for rare encodings, it does not own the handle.
+		// Stream is bound from the current position, so it has to be created at file start.
+		if (!minfo->fileStream)
+		{
+			_lseeki64(minfo->fileHandle, 0, SEEK_SET);
+			minfo->fileStream = g_mime_stream_fs_new(minfo->fileHandle);
+			g_mime_stream_fs_set_owner((GMimeStreamFs*) minfo->fileStream, FALSE);
+		}
+
+		_lseeki64(minfo->fileHandle, minfo->headersStart, SEEK_SET);
+		if (!BuildMimeIndex(read_file_callback, &minfo->fileHandle, minfo->headersStart, minfo->parts))
+			return FALSE;
+
+		generate_headers_fake_file(minfo);
+		minfo->partsIndexed = true;
+	}
+
 	return TRUE;
 }
 
@@ -171,19 +239,15 @@ int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo
 	if (minfo == NULL) return GET_ITEM_ERROR;
 
 	if (item_index < 0) return GET_ITEM_ERROR;
-	if (item_index > (int)minfo->messageParts.size()) return GET_ITEM_NOMOREITEMS;
-
-	// Index 0 is a fake file with decoded headers
-
-	GMimeObject* pObj = item_index > 0 ? minfo->messageParts[item_index-1] : NULL;
+	if (item_index > (int)minfo->parts.size()) return GET_ITEM_NOMOREITEMS;
 
 	memset(item_info, 0, sizeof(StorageItemInfo));
 	item_info->Attributes = FILE_ATTRIBUTE_NORMAL;
 	item_info->ModificationTime = minfo->msgTime;
 
+	// Index 0 is a fake file with decoded headers
 	if (item_index == 0)
 	{
-		// Headers file
 		wcscat_s(item_info->Path, STRBUF_SIZE(item_info->Path), L"{headers}");
 		item_info->Size = 0;
 		if (minfo->headersDecoded != NULL)
@@ -191,54 +255,49 @@ int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo
 			GByteArray* bytePtr = g_mime_stream_mem_get_byte_array((GMimeStreamMem*) minfo->headersDecoded);
 			item_info->Size = bytePtr->len;
 		}
+		return GET_ITEM_OK;
 	}
-	else if (GMIME_IS_MESSAGE_PART (pObj))
+
+	MimeIndexEntry &part = minfo->parts[item_index - 1];
+	switch (part.Kind)
 	{
+	case MIME_ENTRY_MESSAGE:
 		/* message/rfc822 or message/news */
-		GMimeMessage* subMsg = g_mime_message_part_get_message((GMimeMessagePart*) pObj);
-		const char* subj = g_mime_message_get_subject(subMsg);
-		if (subj)
+		if (!part.Subject.empty())
 		{
+			char* subj = g_mime_utils_header_decode_text(g_parserOpts, part.Subject.c_str());
+			g_strstrip(subj);
 			MultiByteToWideChar(CP_UTF8, 0, subj, -1, item_info->Path, STRBUF_SIZE(item_info->Path));
 			wcscat_s(item_info->Path, STRBUF_SIZE(item_info->Path), L".eml");
+			g_free(subj);
 		}
 		else
 		{
 			swprintf_s(item_info->Path, STRBUF_SIZE(item_info->Path), L"%04d.eml", item_index);
 		}
-
-		GMimeStream* nullStream = g_mime_stream_null_new();
-		item_info->Size = g_mime_object_write_to_stream((GMimeObject*) subMsg, g_mime_format_options_get_default(), nullStream);
-		g_object_unref(nullStream);
-	}
-	else if (GMIME_IS_MESSAGE_PARTIAL (pObj))
-	{
+		break;
+	case MIME_ENTRY_PARTIAL:
 		/* message/partial */
 		/* this is an incomplete message part, probably a large message that the sender has broken into smaller parts and is sending us bit by bit. */
 		swprintf_s(item_info->Path, STRBUF_SIZE(item_info->Path), L"%04d - partial", item_index);
-	}
-	else if (GMIME_IS_MULTIPART (pObj))
-	{
-		/* multipart/*. This branch should not be reached in normal circumstances. */
-		swprintf_s(item_info->Path, STRBUF_SIZE(item_info->Path), L"%04d - multi part", item_index);
-	}
-	else if (GMIME_IS_PART (pObj))
-	{
+		break;
+	default:
 		/* a normal leaf part, could be text/plain or image/jpeg etc */
-		GetEntityName((GMimePart*) pObj, item_info->Path, STRBUF_SIZE(item_info->Path), g_parserOpts);
-		
-		GMimeStream* nullStream = g_mime_stream_null_new();
-		GMimeDataWrapper* wrap = g_mime_part_get_content((GMimePart*) pObj);
-		item_info->Size = wrap ? g_mime_data_wrapper_write_to_stream(wrap, nullStream) : 0;
-		
-		g_object_unref(nullStream);
-	}
-	else
-	{
-		// Should not reach this
-		return GET_ITEM_ERROR;
+		GetEntityName(part.ContentType.c_str(), part.ContentDisposition.c_str(), part.ContentLocation.c_str(),
+			item_info->Path, STRBUF_SIZE(item_info->Path), g_parserOpts);
+
+		// Size of rare encodings is only known after decoding, it is calculated once
+		if (part.DecodedSize < 0)
+		{
+			GMimeStream* nullStream = g_mime_stream_null_new();
+			part.DecodedSize = write_part_with_gmime(minfo, part, nullStream);
+			g_object_unref(nullStream);
+		}
+		break;
 	}
 
+	item_info->Size = (part.DecodedSize > 0) ? part.DecodedSize : 0;
+
 	RenameInvalidPathChars(item_info->Path);
 	return GET_ITEM_OK;
 }
@@ -248,15 +307,13 @@ int MODULE_EXPORT ExtractItem(HANDLE storage, ExtractOperationParams params)
 	MimeFileInfo *minfo = (MimeFileInfo*) storage;
 	if (minfo == NULL) return SER_ERROR_SYSTEM;
 
-	if ( (params.ItemIndex < 0) || (params.ItemIndex > (int) minfo->messageParts.size()) )
+	if ( (params.ItemIndex < 0) || (params.ItemIndex > (int) minfo->parts.size()) )
 		return SER_ERROR_SYSTEM;
 
 	FILE* dfh;
 	if (_wfopen_s(&dfh, params.DestPath, L"wb") != 0)
 		return SER_ERROR_WRITE;
 
-	GMimeObject* pObj = params.ItemIndex > 0 ? minfo->messageParts[params.ItemIndex-1] : nullptr;
-
 	int retVal = SER_ERROR_READ;
 	if (params.ItemIndex == 0)
 	{
@@ -268,38 +325,32 @@ int MODULE_EXPORT ExtractItem(HANDLE storage, ExtractOperationParams params)
 		g_object_unref(destStream);
 		retVal = SER_SUCCESS;
 	}
-	else if (GMIME_IS_MESSAGE_PART (pObj))
-	{
-		GMimeMessage* subMsg = g_mime_message_part_get_message((GMimeMessagePart*) pObj);
-
-		GMimeStream* destStream = g_mime_stream_file_new(dfh);
-		g_mime_stream_file_set_owner((GMimeStreamFile*) destStream, FALSE);
-
-		g_mime_object_write_to_stream((GMimeObject*) subMsg, g_mime_format_options_get_default(), destStream);
-		g_object_unref(destStream);
-		retVal = SER_SUCCESS;
-	}
-	else if (GMIME_IS_MESSAGE_PARTIAL (pObj))
-	{
-		//
-	}
-	else if (GMIME_IS_MULTIPART (pObj))
-	{
-		// Should not have this case
-	}
-	else if (GMIME_IS_PART (pObj))
+	else
 	{
-		GMimeDataWrapper* wrap = g_mime_part_get_content((GMimePart*) pObj);
-		
-		if (wrap)
+		const MimeIndexEntry &part = minfo->parts[params.ItemIndex - 1];
+		if (part.Kind == MIME_ENTRY_MESSAGE)
+		{
+			// Embedded message is stored as is
+			__int64 decodeRes = DecodePartContent(minfo->fileHandle, part.ContentStart, part.ContentEnd, MIME_ENC_IDENTITY, dfh);
+			retVal = (decodeRes >= 0) ? SER_SUCCESS : SER_ERROR_WRITE;
+		}
+		else if (part.Kind == MIME_ENTRY_PART)
 		{
-			GMimeStream* destStream = g_mime_stream_file_new(dfh);
-			g_mime_stream_file_set_owner((GMimeStreamFile*) destStream, FALSE);
+			__int64 decodeRes = DecodePartContent(minfo->fileHandle, part.ContentStart, part.ContentEnd, part.Encoding, dfh);
+			if (decodeRes == DECODE_UNSUPPORTED)
+			{
+				GMimeStream* destStream = g_mime_stream_file_new(dfh);
+				g_mime_stream_file_set_owner((GMimeStreamFile*) destStream, FALSE);
 
-			g_mime_data_wrapper_write_to_stream(wrap, destStream);
+				write_part_with_gmime(minfo, part, destStream);
 		
-			g_object_unref(destStream);
-			retVal = SER_SUCCESS;
+				g_object_unref(destStream);
+				retVal = SER_SUCCESS;
+			}
+			else
+			{
+				retVal = (decodeRes >= 0) ? SER_SUCCESS : SER_ERROR_WRITE;
+			}
 		}
 	}
 
@@ -0,0 +1,174 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "MpqVerify.h"
+
+// Upper limit for automatic thread count, verification is mostly limited by disk
+#define MAX_AUTO_VERIFY_THREADS 4
+// How often calling thread reports progress when only other threads have files left
+#define VERIFY_PROGRESS_INTERVAL_MS 50
+
+struct VerifyState
+{
+	const TCHAR* szArchivePath;
+	DWORD dwOpenFlags;
+	const std::vector<SFILE_FIND_DATA>* files;
+	std::vector<DWORD>* results;
+
+	std::atomic<size_t> nextItem;
+	std::atomic<size_t> doneItems;
+	std::atomic<unsigned long long> doneBytes;
+	std::atomic<bool> aborted;
+};
+
+static void VerifyOneFile(HANDLE hMpq, VerifyState* state, size_t itemIndex)
+{
+	const SFILE_FIND_DATA &ffd = (*state->files)[itemIndex];
+	(*state->results)[itemIndex] = SFileVerifyFile(hMpq, ffd.cFileName, SFILE_VERIFY_ALL);
+
+	state->doneBytes += ffd.dwFileSize;
+	state->doneItems++;
+}
+
+static void VerifyFilesThread(VerifyState* state)
+{
+	HANDLE hMpq = NULL;
+	if (!SFileOpenArchive(state->szArchivePath, 0, state->dwOpenFlags, &hMpq))
+		return;
+
+	size_t itemIndex;
+	while (!state->aborted && (itemIndex = state->nextItem++) < state->files->size())
+		VerifyOneFile(hMpq, state, itemIndex);
+
+	SFileCloseArchive(hMpq);
+}
+
+bool MpqVerifyFiles(HANDLE hMpq, const TCHAR* szArchivePath, DWORD dwOpenFlags, const std::vector<SFILE_FIND_DATA> &files,
+	int numThreads, MpqVerifyProgressFunc progress, void* context, std::vector<DWORD> &results)
+{
+	VerifyState state;
+	state.szArchivePath = szArchivePath;
+	state.dwOpenFlags = dwOpenFlags;
+	state.files = &files;
+	state.results = &results;
+	state.nextItem = 0;
+	state.doneItems = 0;
+	state.doneBytes = 0;
+	state.aborted = false;
+
+	results.assign(files.size(), 0);
+
+	if (numThreads <= 0)
+	{
+		numThreads = (int) std::thread::hardware_concurrency();
+		if (numThreads > MAX_AUTO_VERIFY_THREADS)
+			numThreads = MAX_AUTO_VERIFY_THREADS;
+	}
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < numThreads; i++)
+		workers.push_back(std::thread(VerifyFilesThread, &state));
+
+	// Calling thread works too, it is the only one that reports progress
+	unsigned long long reportedBytes = 0;
+	auto reportProgress = [&]() -> bool
+	{
+		if (!progress) return true;
+		unsigned long long doneBytes = state.doneBytes;
+		bool fContinue = progress(context, doneBytes - reportedBytes);
+		reportedBytes = doneBytes;
+		return fContinue;
+	};
+
+	size_t itemIndex;
+	while (!state.aborted && (itemIndex = state.nextItem++) < files.size())
+	{
+		VerifyOneFile(hMpq, &state, itemIndex);
+		if (!reportProgress())
+			state.aborted = true;
+	}
+
+	// Last files may still be checked by other threads, keep progress and abort working
+	while (!state.aborted && state.doneItems < files.size())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(VERIFY_PROGRESS_INTERVAL_MS));
+		if (!reportProgress())
+			state.aborted = true;
+	}
+
+	for (auto it = workers.begin(); it != workers.end(); ++it)
+		it->join();
+
+	return !state.aborted;
+}
+
+static std::string DescribeVerifyResult(DWORD result)
+{
+	static const struct { DWORD flag; const char* text; } errorNames[] = {
+		{ VERIFY_OPEN_ERROR, "open error" },
+		{ VERIFY_READ_ERROR, "read error" },
+		{ VERIFY_FILE_SECTOR_CRC_ERROR, "sector CRC mismatch" },
+		{ VERIFY_FILE_CHECKSUM_ERROR, "CRC32 mismatch" },
+		{ VERIFY_FILE_MD5_ERROR, "MD5 mismatch" },
+		{ VERIFY_FILE_RAW_MD5_ERROR, "raw MD5 mismatch" },
+	};
+
+	std::string strText;
+	for (size_t i = 0; i < sizeof(errorNames) / sizeof(errorNames[0]); i++)
+	{
+		if (result & errorNames[i].flag)
+		{
+			if (!strText.empty()) strText += ", ";
+			strText += errorNames[i].text;
+		}
+	}
+	return strText;
+}
+
+static const char* DescribeSignatureResult(DWORD result)
+{
+	switch (result)
+	{
+		case ERROR_NO_SIGNATURE:
+			return "none";
+		case ERROR_WEAK_SIGNATURE_OK:
+			return "weak, valid";
+		case ERROR_WEAK_SIGNATURE_ERROR:
+			return "weak, INVALID";
+		case ERROR_STRONG_SIGNATURE_OK:
+			return "strong, valid";
+		case ERROR_STRONG_SIGNATURE_ERROR:
+			return "strong, INVALID";
+	}
+	return "verification failed";
+}
+
+std::string MpqBuildVerifyReport(HANDLE hMpq, const std::vector<SFILE_FIND_DATA> &files, const std::vector<DWORD> &results)
+{
+	DWORD dwSignature = SFileVerifyArchive(hMpq);
+
+	std::string strCorrupted;
+	size_t numCorrupted = 0;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		if (results[i] & VERIFY_FILE_ERROR_MASK)
+		{
+			strCorrupted += files[i].cFileName;
+			strCorrupted += " : ";
+			strCorrupted += DescribeVerifyResult(results[i]);
+			strCorrupted += "\r\n";
+			numCorrupted++;
+		}
+	}
+
+	std::string strReport = "Files checked: " + std::to_string(files.size()) + "\r\n"
+		+ "Corrupted files: " + std::to_string(numCorrupted) + "\r\n"
+		+ "Signature: " + DescribeSignatureResult(dwSignature) + "\r\n";
+	if (numCorrupted > 0)
+	{
+		strReport += "\r\n";
+		strReport += strCorrupted;
+	}
+	return strReport;
+}
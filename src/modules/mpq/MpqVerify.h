@@ -0,0 +1,24 @@
+#ifndef MpqVerify_h__
+#define MpqVerify_h__
+
+#include <vector>
+#include <string>
+
+#define STORMLIB_NO_AUTO_LINK 1
+#include "StormLib/src/StormLib.h"
+
+// Called on the calling thread only, bytes is total size of files verified since previous call
+// (by any thread). Returning false aborts verification.
+typedef bool (*MpqVerifyProgressFunc)(void* context, unsigned long long bytes);
+
+// Checks files with SFileVerifyFile on several threads (numThreads <= 0 means automatic).
+// Calling thread uses hMpq, other threads open archive again with given path and flags,
+// since StormLib handles can not be shared between threads.
+// Results receive SFileVerifyFile flags for every file. Returns false if aborted.
+bool MpqVerifyFiles(HANDLE hMpq, const TCHAR* szArchivePath, DWORD dwOpenFlags, const std::vector<SFILE_FIND_DATA> &files,
+	int numThreads, MpqVerifyProgressFunc progress, void* context, std::vector<DWORD> &results);
+
+// Text report with number of checked and corrupted files, archive signature and list of corrupted files
+std::string MpqBuildVerifyReport(HANDLE hMpq, const std::vector<SFILE_FIND_DATA> &files, const std::vector<DWORD> &results);
+
+#endif // MpqVerify_h__
@@ -0,0 +1,143 @@
+// Standalone benchmark for shared listfile index (SListFileCreateIndex / SFileAddListFileIndex).
+// Not part of the module build.
+//
+// Creates external listfile with many names and several archives without internal listfile,
+// then compares name resolution with SFileAddListFile per archive against one index shared
+// by all archives, the way mpq module does it.
+//
+// Build with bundled StormLib sources, for example:
+//   g++ -O2 -I../../../depends/StormLib/src listfile_index_bench.cpp libstorm.a -lz -lbz2
+// Usage: listfile_index_bench <work dir> [names in listfile] [archives] [files per archive]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "StormLib.h"
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+static std::string make_name(int index)
+{
+	char buf[128];
+	snprintf(buf, sizeof(buf), "Data\\Folder%03d\\Sub%02d\\file_%07d.blp", index % 500, index % 37, index);
+	return buf;
+}
+
+static bool create_archive(const std::string &path, int firstName, int nameStep, int numFiles)
+{
+	HANDLE hMpq = NULL;
+	remove(path.c_str());
+	// No MPQ_CREATE_LISTFILE, so names are known only from external listfile
+	if (!SFileCreateArchive(path.c_str(), MPQ_CREATE_ARCHIVE_V1, numFiles + 16, &hMpq))
+		return false;
+
+	char data[64];
+	for (int i = 0; i < numFiles; i++)
+	{
+		std::string name = make_name(firstName + i * nameStep);
+		HANDLE hFile = NULL;
+		int dataSize = snprintf(data, sizeof(data), "content of %d", i);
+		if (!SFileCreateFile(hMpq, name.c_str(), 0, dataSize, 0, MPQ_FILE_REPLACEEXISTING, &hFile))
+			return false;
+		SFileWriteFile(hFile, data, dataSize, 0);
+		SFileFinishFile(hFile);
+	}
+
+	SFileCloseArchive(hMpq);
+	return true;
+}
+
+// Returns number of files with resolved names
+static int count_named_files(HANDLE hMpq)
+{
+	int numNamed = 0;
+	SFILE_FIND_DATA ffd;
+	HANDLE hSearch = SFileFindFirstFile(hMpq, "*", &ffd, NULL);
+	if (hSearch == NULL) return 0;
+	do
+	{
+		if (strncmp(ffd.cFileName, "File", 4) != 0)
+			numNamed++;
+	} while (SFileFindNextFile(hSearch, &ffd));
+	SFileFindClose(hSearch);
+	return numNamed;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: listfile_index_bench <work dir> [names in listfile] [archives] [files per archive]\n");
+		return 1;
+	}
+
+	std::string workDir = argv[1];
+	int numNames = (argc > 2) ? atoi(argv[2]) : 300000;
+	int numArchives = (argc > 3) ? atoi(argv[3]) : 20;
+	int filesPerArchive = (argc > 4) ? atoi(argv[4]) : 2000;
+
+	std::string listfilePath = workDir + "/listfile.txt";
+	FILE* lf = fopen(listfilePath.c_str(), "wb");
+	if (!lf) return 1;
+	for (int i = 0; i < numNames; i++)
+		fprintf(lf, "%s\r\n", make_name(i).c_str());
+	fclose(lf);
+
+	std::vector<std::string> archives;
+	for (int i = 0; i < numArchives; i++)
+	{
+		std::string path = workDir + "/test" + std::to_string(i) + ".mpq";
+		if (!create_archive(path, i, numNames / filesPerArchive, filesPerArchive))
+		{
+			printf("Can not create %s\n", path.c_str());
+			return 1;
+		}
+		archives.push_back(path);
+	}
+
+	// Per archive listfile parsing
+	auto start = std::chrono::steady_clock::now();
+	int namedPlain = 0;
+	for (size_t i = 0; i < archives.size(); i++)
+	{
+		HANDLE hMpq = NULL;
+		if (!SFileOpenArchive(archives[i].c_str(), 0, MPQ_OPEN_READ_ONLY, &hMpq)) return 1;
+		SFileAddListFile(hMpq, listfilePath.c_str());
+		namedPlain += count_named_files(hMpq);
+		SFileCloseArchive(hMpq);
+	}
+	double tPlain = seconds_since(start);
+
+	// Shared index
+	start = std::chrono::steady_clock::now();
+	HANDLE hIndex = SListFileCreateIndex(listfilePath.c_str());
+	double tIndex = seconds_since(start);
+	int namedIndex = 0;
+	for (size_t i = 0; i < archives.size(); i++)
+	{
+		HANDLE hMpq = NULL;
+		if (!SFileOpenArchive(archives[i].c_str(), 0, MPQ_OPEN_READ_ONLY, &hMpq)) return 1;
+		SFileAddListFileIndex(hMpq, hIndex);
+		namedIndex += count_named_files(hMpq);
+		SFileCloseArchive(hMpq);
+	}
+	double tIndexTotal = seconds_since(start);
+	SListFileCloseIndex(hIndex);
+
+	printf("%d names in listfile, %d archives x %d files\n", numNames, numArchives, filesPerArchive);
+	printf("SFileAddListFile per archive: %.3f s, %d names resolved\n", tPlain, namedPlain);
+	printf("shared index: %.3f s (index build %.3f s), %d names resolved\n", tIndexTotal, tIndex, namedIndex);
+
+	for (size_t i = 0; i < archives.size(); i++)
+		remove(archives[i].c_str());
+	remove(listfilePath.c_str());
+
+	return (namedIndex == namedPlain) ? 0 : 2;
+}
@@ -0,0 +1,141 @@
+// Standalone throughput benchmark for reading compressed MPQ files.
+// Not part of the module build.
+//
+// Creates archive with one large zlib compressed file and reads it with SFileReadFile
+// in 1 MB chunks, the same way mpq module extracts files. The file is read with
+// serial sector processing (SFileSetSectorThreads(1)) and with the given number
+// of sector threads, output of both modes is compared byte by byte.
+//
+// Build with bundled StormLib sources, for example:
+//   g++ -O2 -pthread -I../../../depends/StormLib/src sector_read_bench.cpp libstorm.a -lz -lbz2
+// Usage: sector_read_bench <work dir> [file size in MB] [runs] [threads, 0 = auto]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "StormLib.h"
+
+#define READ_CHUNK_SIZE (1024*1024)
+
+static bool create_archive(const std::string &path, DWORD fileSize)
+{
+	HANDLE hMpq = NULL, hFile = NULL;
+	remove(path.c_str());
+	if (!SFileCreateArchive(path.c_str(), MPQ_CREATE_ARCHIVE_V2, 16, &hMpq))
+		return false;
+
+	if (!SFileCreateFile(hMpq, "data\\big.bin", 0, fileSize, 0, MPQ_FILE_COMPRESS | MPQ_FILE_REPLACEEXISTING, &hFile))
+		return false;
+
+	// Partly compressible content, close to typical game data
+	std::vector<unsigned char> chunk(READ_CHUNK_SIZE);
+	unsigned int seed = 1;
+	for (DWORD written = 0; written < fileSize; written += READ_CHUNK_SIZE)
+	{
+		for (size_t i = 0; i < chunk.size(); i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			chunk[i] = (i & 3) ? (unsigned char) (seed >> 24) : (unsigned char) (i >> 10);
+		}
+		DWORD writeSize = std::min((DWORD) READ_CHUNK_SIZE, fileSize - written);
+		if (!SFileWriteFile(hFile, &chunk[0], writeSize, MPQ_COMPRESSION_ZLIB))
+			return false;
+	}
+
+	SFileFinishFile(hFile);
+	SFileCloseArchive(hMpq);
+	return true;
+}
+
+// Reads the whole file, keeps content in output when it is not NULL.
+// Returns best time of all runs or negative value on error.
+static double read_file(const std::string &path, DWORD fileSize, int numRuns, std::vector<unsigned char>* output)
+{
+	std::vector<unsigned char> buf(READ_CHUNK_SIZE);
+	double best = 1e9;
+	for (int run = 0; run < numRuns; run++)
+	{
+		HANDLE hMpq = NULL, hFile = NULL;
+		if (!SFileOpenArchive(path.c_str(), 0, MPQ_OPEN_READ_ONLY, &hMpq) || !SFileOpenFileEx(hMpq, "data\\big.bin", 0, &hFile))
+			return -1;
+
+		if (output) output->clear();
+
+		auto start = std::chrono::steady_clock::now();
+		DWORD totalRead = 0, dwRead = 0;
+		while (SFileReadFile(hFile, &buf[0], READ_CHUNK_SIZE, &dwRead, NULL) || dwRead > 0)
+		{
+			totalRead += dwRead;
+			if (output) output->insert(output->end(), buf.begin(), buf.begin() + dwRead);
+			if (dwRead < READ_CHUNK_SIZE) break;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		SFileCloseFile(hFile);
+		SFileCloseArchive(hMpq);
+
+		if (totalRead != fileSize)
+		{
+			printf("Read %u bytes instead of %u\n", (unsigned) totalRead, (unsigned) fileSize);
+			return -1;
+		}
+		// Copying to output is not part of the measured work
+		if (!output) best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: sector_read_bench <work dir> [file size in MB] [runs] [threads, 0 = auto]\n");
+		return 1;
+	}
+
+	std::string path = std::string(argv[1]) + "/sector_bench.mpq";
+	DWORD fileSize = ((argc > 2) ? atoi(argv[2]) : 256) * 1024 * 1024;
+	int numRuns = (argc > 3) ? atoi(argv[3]) : 3;
+	DWORD numThreads = (argc > 4) ? atoi(argv[4]) : 0;
+
+	if (!create_archive(path, fileSize))
+	{
+		printf("Can not create test archive\n");
+		return 1;
+	}
+
+	// Threads are set before each pass, the pool is recreated on next read
+	std::vector<unsigned char> serialData, parallelData;
+
+	SFileSetSectorThreads(1);
+	double serialTime = read_file(path, fileSize, numRuns, NULL);
+	if (serialTime < 0 || read_file(path, fileSize, 1, &serialData) < 0)
+		return 2;
+
+	SFileSetSectorThreads(numThreads);
+	double parallelTime = read_file(path, fileSize, numRuns, NULL);
+	if (parallelTime < 0 || read_file(path, fileSize, 1, &parallelData) < 0)
+		return 2;
+
+	SFileSetSectorThreads(1);
+
+	double sizeMB = fileSize / 1048576.0;
+	printf("Serial:   %u MB read in %.3f s (%.0f MB/s), best of %d runs\n", (unsigned) (fileSize >> 20), serialTime, sizeMB / serialTime, numRuns);
+	printf("Parallel: %u MB read in %.3f s (%.0f MB/s), %u threads\n", (unsigned) (fileSize >> 20), parallelTime, sizeMB / parallelTime, (unsigned) numThreads);
+
+	remove(path.c_str());
+
+	if (serialData != parallelData)
+	{
+		size_t pos = 0;
+		while (pos < serialData.size() && pos < parallelData.size() && serialData[pos] == parallelData[pos]) pos++;
+		printf("FAILED: output differs at offset %u\n", (unsigned) pos);
+		return 3;
+	}
+	printf("Output matches\n");
+	return 0;
+}
@@ -0,0 +1,241 @@
+// Standalone check of MPQ verification on corrupted archives.
+// Not part of the module build.
+//
+// Creates archive with sector CRC and (attributes) MD5/CRC32, verifies it with
+// MpqVerifyFiles (the code mpq module uses for the verification report), then flips
+// single data bytes in chosen files and checks that exactly those files are reported
+// as corrupted. Progress must account for all checked data and must be able to abort.
+//
+// Build with bundled StormLib sources, for example:
+//   g++ -O2 -pthread -I../../../depends verify_corrupt_test.cpp libstorm.a -lz -lbz2
+// Usage: verify_corrupt_test <work dir> [threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <set>
+
+#include "../MpqVerify.cpp"
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+static const int NumFiles = 40;
+static const DWORD FileSize = 50000;
+
+static std::string file_name(int index)
+{
+	return "data\\file" + std::to_string(index) + ".bin";
+}
+
+static bool create_archive(const std::string &path)
+{
+	HANDLE hMpq = NULL;
+	remove(path.c_str());
+	if (!SFileCreateArchive(path.c_str(), MPQ_CREATE_ARCHIVE_V2 | MPQ_CREATE_LISTFILE | MPQ_CREATE_ATTRIBUTES, NumFiles + 16, &hMpq))
+		return false;
+
+	std::vector<unsigned char> data(FileSize);
+	for (int i = 0; i < NumFiles; i++)
+	{
+		// Partly compressible content, so sectors stay compressed
+		for (DWORD j = 0; j < FileSize; j++)
+			data[j] = (unsigned char) ((j * (i + 3)) ^ (j >> 5));
+
+		HANDLE hFile = NULL;
+		DWORD dwFlags = MPQ_FILE_COMPRESS | MPQ_FILE_SECTOR_CRC | MPQ_FILE_REPLACEEXISTING;
+		if (!SFileCreateFile(hMpq, file_name(i).c_str(), 0, FileSize, 0, dwFlags, &hFile))
+			return false;
+		if (!SFileWriteFile(hFile, &data[0], FileSize, MPQ_COMPRESSION_ZLIB))
+			return false;
+		SFileFinishFile(hFile);
+	}
+
+	SFileCloseArchive(hMpq);
+	return true;
+}
+
+struct ProgressCounter
+{
+	unsigned long long bytes;
+	int calls;
+	int abortAfter;		// Number of calls before abort, 0 to never abort
+};
+
+static bool count_progress(void* context, unsigned long long bytes)
+{
+	ProgressCounter* counter = (ProgressCounter*) context;
+	counter->bytes += bytes;
+	counter->calls++;
+	return (counter->abortAfter == 0) || (counter->calls < counter->abortAfter);
+}
+
+// Lists archive the same way as mpq module, internal files included
+static bool list_files(HANDLE hMpq, std::vector<SFILE_FIND_DATA> &files)
+{
+	SFILE_FIND_DATA ffd;
+	HANDLE hSearch = SFileFindFirstFile(hMpq, "*", &ffd, NULL);
+	if (hSearch == NULL) return false;
+	do 
+	{
+		files.push_back(ffd);
+	} while (SFileFindNextFile(hSearch, &ffd));
+	SFileFindClose(hSearch);
+	return true;
+}
+
+// Returns indexes of corrupted test files, or -1 in the set on failure
+static std::set<int> verify_archive(const std::string &path, int numThreads)
+{
+	std::set<int> corrupted;
+	HANDLE hMpq = NULL;
+	std::vector<SFILE_FIND_DATA> files;
+	if (!SFileOpenArchive(path.c_str(), 0, MPQ_OPEN_READ_ONLY, &hMpq) || !list_files(hMpq, files))
+	{
+		corrupted.insert(-1);
+		return corrupted;
+	}
+
+	std::vector<DWORD> results;
+	ProgressCounter counter = { 0, 0, 0 };
+	if (!MpqVerifyFiles(hMpq, path.c_str(), MPQ_OPEN_READ_ONLY, files, numThreads, count_progress, &counter, results))
+	{
+		printf("  verification aborted\n");
+		corrupted.insert(-1);
+	}
+
+	unsigned long long totalBytes = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		totalBytes += files[i].dwFileSize;
+		if (results[i] & VERIFY_FILE_ERROR_MASK)
+		{
+			printf("  %s: flags 0x%04X\n", files[i].cFileName, (unsigned) results[i]);
+			int fileIndex = -1;
+			for (int j = 0; j < NumFiles; j++)
+				if (file_name(j) == files[i].cFileName) fileIndex = j;
+			corrupted.insert(fileIndex);
+		}
+	}
+	if (counter.bytes != totalBytes)
+	{
+		printf("  progress reported %llu bytes of %llu\n", counter.bytes, totalBytes);
+		corrupted.insert(-1);
+	}
+
+	std::string strReport = MpqBuildVerifyReport(hMpq, files, results);
+	printf("%s", strReport.c_str());
+
+	SFileCloseArchive(hMpq);
+	return corrupted;
+}
+
+// Progress callback must be able to stop verification
+static bool check_abort(const std::string &path, int numThreads)
+{
+	HANDLE hMpq = NULL;
+	std::vector<SFILE_FIND_DATA> files;
+	if (!SFileOpenArchive(path.c_str(), 0, MPQ_OPEN_READ_ONLY, &hMpq) || !list_files(hMpq, files))
+		return false;
+
+	std::vector<DWORD> results;
+	ProgressCounter counter = { 0, 0, 1 };
+	bool fCompleted = MpqVerifyFiles(hMpq, path.c_str(), MPQ_OPEN_READ_ONLY, files, numThreads, count_progress, &counter, results);
+
+	SFileCloseArchive(hMpq);
+	return !fCompleted && counter.calls == 1;
+}
+
+// Flips one byte of file data, either in the middle of stored data or the first byte of
+// the first sector (stored data ends with compressed sector CRC table, which StormLib
+// ignores when damaged, so the end of stored data is not a useful target)
+static bool corrupt_file(const std::string &path, int fileIndex, bool firstSector)
+{
+	HANDLE hMpq = NULL, hFile = NULL;
+	ULONGLONG byteOffset = 0;
+	DWORD compSize = 0;
+
+	if (!SFileOpenArchive(path.c_str(), 0, MPQ_OPEN_READ_ONLY, &hMpq))
+		return false;
+	bool fOk = SFileOpenFileEx(hMpq, file_name(fileIndex).c_str(), 0, &hFile)
+		&& SFileGetFileInfo(hFile, SFileInfoByteOffset, &byteOffset, sizeof(byteOffset), NULL)
+		&& SFileGetFileInfo(hFile, SFileInfoCompressedSize, &compSize, sizeof(compSize), NULL);
+	if (hFile) SFileCloseFile(hFile);
+	SFileCloseArchive(hMpq);
+	if (!fOk || compSize < 2) return false;
+
+	FILE* f = fopen(path.c_str(), "r+b");
+	if (!f) return false;
+
+	long long pos = (long long) byteOffset + compSize / 2;
+	if (firstSector)
+	{
+		// Sector offset table starts the stored data, first entry points to sector 0
+		DWORD sectorOffset = 0;
+		fOk = (fseek64(f, (long long) byteOffset, SEEK_SET) == 0) && (fread(&sectorOffset, sizeof(sectorOffset), 1, f) == 1);
+		pos = (long long) byteOffset + sectorOffset;
+	}
+
+	unsigned char b = 0;
+	fOk = fOk && (fseek64(f, pos, SEEK_SET) == 0) && (fread(&b, 1, 1, f) == 1);
+	b ^= 0x5A;
+	fOk = fOk && (fseek64(f, pos, SEEK_SET) == 0) && (fwrite(&b, 1, 1, f) == 1);
+	fclose(f);
+	return fOk;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: verify_corrupt_test <work dir> [threads]\n");
+		return 1;
+	}
+
+	std::string path = std::string(argv[1]) + "/verify_test.mpq";
+	int numThreads = (argc > 2) ? atoi(argv[2]) : 4;
+
+	if (!create_archive(path))
+	{
+		printf("Can not create test archive\n");
+		return 1;
+	}
+
+	int failures = 0;
+
+	printf("Intact archive:\n");
+	if (!verify_archive(path, numThreads).empty())
+	{
+		printf("FAIL: intact archive reported corrupted files\n");
+		failures++;
+	}
+
+	if (!check_abort(path, numThreads))
+	{
+		printf("FAIL: verification was not aborted by progress callback\n");
+		failures++;
+	}
+
+	const int corruptMiddle = 7, corruptFirst = 23;
+	if (!corrupt_file(path, corruptMiddle, false) || !corrupt_file(path, corruptFirst, true))
+	{
+		printf("Can not corrupt test archive\n");
+		return 1;
+	}
+
+	printf("Archive with 2 corrupted files:\n");
+	std::set<int> expected = { corruptMiddle, corruptFirst };
+	if (verify_archive(path, numThreads) != expected)
+	{
+		printf("FAIL: corrupted files were not detected exactly\n");
+		failures++;
+	}
+
+	remove(path.c_str());
+	printf(failures ? "FAILED\n" : "OK\n");
+	return failures ? 2 : 0;
+}
@@ -8,17 +8,32 @@
 
 #define STORMLIB_NO_AUTO_LINK 1
 #include "StormLib/src/StormLib.h"
+#include "MpqVerify.h"
+
+// Large reads let StormLib decompress many sectors of a file at once
+#define EXTRACT_BUFFER_SIZE (1024 * 1024)
 
 static wchar_t optListfilesLocation[MAX_PATH] = {0};
 static bool optListfilesRecursive = true;
+static bool optVerifyReport = false;
+static int optVerifyThreads = 0;
+static int optDecompressThreads = 0;
+
+// Virtual item, extracting it checks all files of the archive
+#define VERIFY_REPORT_NAME L"{verify}.txt"
 
 static std::vector<std::wstring> g_Listfiles;
 static bool g_ListfileEnumComplete = false;
 
+// Listfiles are loaded and hashed once, then shared by all archives
+static std::vector<HANDLE> g_ListfileIndexes;
+static bool g_ListfileIndexComplete = false;
+
 struct MoPaQ_File
 {
 	HANDLE hMpq;
 	bool isEncrypted;
+	std::wstring FilePath;
 	
 	bool bListfilesApplied;
 	std::vector<SFILE_FIND_DATA> vFiles;
@@ -62,6 +77,64 @@ static void EnumListfiles(const wchar_t* path, bool recurse, std::vector<std::ws
 	FindClose(hFind);
 }
 
+static void LoadListfileIndexes()
+{
+	for (auto cit = g_Listfiles.cbegin(); cit != g_Listfiles.cend(); ++cit)
+	{
+		HANDLE hIndex = SListFileCreateIndex(cit->c_str());
+		if (hIndex != NULL)
+			g_ListfileIndexes.push_back(hIndex);
+	}
+	g_ListfileIndexComplete = true;
+}
+
+static void FreeListfileIndexes()
+{
+	for (auto cit = g_ListfileIndexes.cbegin(); cit != g_ListfileIndexes.cend(); ++cit)
+	{
+		SListFileCloseIndex(*cit);
+	}
+	g_ListfileIndexes.clear();
+	g_ListfileIndexComplete = false;
+}
+
+static DWORD GetMpqOpenFlags(bool encrypted)
+{
+	return (encrypted ? STREAM_PROVIDER_MPQE : STREAM_PROVIDER_FLAT) | MPQ_OPEN_READ_ONLY;
+}
+
+static bool OpenMpqArchive(const wchar_t* path, bool encrypted, HANDLE *hMpq)
+{
+	return SFileOpenArchive(path, 0, GetMpqOpenFlags(encrypted), hMpq);
+}
+
+static bool VerifyProgress(void* context, unsigned long long bytes)
+{
+	ExtractProcessCallbacks* callbacks = (ExtractProcessCallbacks*) context;
+	return !callbacks->FileProgress || callbacks->FileProgress(callbacks->signalContext, (__int64) bytes);
+}
+
+// Checks all files and writes list of corrupted ones
+static int VerifyArchive(MoPaQ_File* fileObj, ExtractOperationParams &params)
+{
+	std::vector<DWORD> results;
+	if (!MpqVerifyFiles(fileObj->hMpq, fileObj->FilePath.c_str(), GetMpqOpenFlags(fileObj->isEncrypted), fileObj->vFiles,
+		optVerifyThreads, VerifyProgress, &params.Callbacks, results))
+		return SER_USERABORT;
+
+	std::string strReport = MpqBuildVerifyReport(fileObj->hMpq, fileObj->vFiles, results);
+
+	HANDLE hOutFile = CreateFileW(params.DestPath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (hOutFile == INVALID_HANDLE_VALUE)
+		return SER_ERROR_WRITE;
+
+	DWORD dwWritten;
+	BOOL fWriteResult = WriteFile(hOutFile, strReport.c_str(), (DWORD) strReport.size(), &dwWritten, NULL);
+	CloseHandle(hOutFile);
+
+	return fWriteResult ? SER_SUCCESS : SER_ERROR_WRITE;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, StorageGeneralInfo* info)
@@ -70,11 +143,11 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 	bool fEncrypted = false;
 
 	// First try to open file as plain MPQ
-	if (!SFileOpenArchive(params.FilePath, 0, STREAM_PROVIDER_FLAT | MPQ_OPEN_READ_ONLY, &hMpq))
+	if (!OpenMpqArchive(params.FilePath, false, &hMpq))
 	{
 		// Additionally try to open file as encrypted MPQ
 		fEncrypted = true;
-		if (!SFileOpenArchive(params.FilePath, 0, STREAM_PROVIDER_MPQE | MPQ_OPEN_READ_ONLY, &hMpq))
+		if (!OpenMpqArchive(params.FilePath, true, &hMpq))
 			return SOR_INVALID_FILE;
 	}
 
@@ -98,6 +171,7 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 	MoPaQ_File* file = new MoPaQ_File();
 	file->hMpq = hMpq;
 	file->isEncrypted = fEncrypted;
+	file->FilePath = params.FilePath;
 	file->bListfilesApplied = false;
 
 	*storage = file;
@@ -106,6 +180,10 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 	wcscpy_s(info->Format, STORAGE_FORMAT_NAME_MAX_LEN, L"MoPaQ Container");
 	wcscpy_s(info->Comment, STORAGE_PARAM_MAX_LEN, L"-");
 	wcscpy_s(info->Compression, STORAGE_PARAM_MAX_LEN, file->isEncrypted ? L"Mixed (Encrypted)" : L"Mixed");
+
+	DWORD dwNumFiles = 0;
+	if (SFileGetFileInfo(hMpq, SFileMpqNumberOfFiles, &dwNumFiles, sizeof(dwNumFiles), NULL))
+		info->NumFiles = (int) dwNumFiles + (optVerifyReport ? 1 : 0);
 	
 	return SOR_SUCCESS;
 }
@@ -129,9 +207,11 @@ int MODULE_EXPORT PrepareFiles(HANDLE storage)
 	if (!fileObj->bListfilesApplied)
 	{
 		fileObj->bListfilesApplied = true;
-		for (auto cit = g_Listfiles.cbegin(); cit != g_Listfiles.cend(); ++cit)
+		if (!g_ListfileIndexComplete)
+			LoadListfileIndexes();
+		for (auto cit = g_ListfileIndexes.cbegin(); cit != g_ListfileIndexes.cend(); ++cit)
 		{
-			SFileAddListFile(fileObj->hMpq, cit->c_str());
+			SFileAddListFileIndex(fileObj->hMpq, *cit);
 		}
 	}
 	
@@ -154,6 +234,17 @@ int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo
 	MoPaQ_File* fileObj = (MoPaQ_File*) storage;
 	if (fileObj == NULL || item_index < 0) return GET_ITEM_ERROR;
 
+	if (optVerifyReport && item_index == (int) fileObj->vFiles.size())
+	{
+		memset(item_info, 0, sizeof(StorageItemInfo));
+		wcscpy_s(item_info->Path, STRBUF_SIZE(item_info->Path), VERIFY_REPORT_NAME);
+		item_info->Attributes = FILE_ATTRIBUTE_NORMAL;
+		// Progress of the report is the amount of checked data
+		for (auto cit = fileObj->vFiles.cbegin(); cit != fileObj->vFiles.cend(); ++cit)
+			item_info->Size += cit->dwFileSize;
+		return GET_ITEM_OK;
+	}
+
 	if (item_index >= (int) fileObj->vFiles.size())
 		return GET_ITEM_NOMOREITEMS;
 
@@ -165,6 +256,9 @@ int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo
 	MultiByteToWideChar(itemCP, 0, ffd.cFileName, -1, item_info->Path, STRBUF_SIZE(item_info->Path));
 	item_info->Size = ffd.dwFileSize;
 	item_info->PackedSize = ffd.dwCompSize;
+	item_info->DataPosition = ffd.ByteOffset;
+	if (!fileObj->isEncrypted && (ffd.dwCompSize == ffd.dwFileSize) && (ffd.dwFileFlags & (MPQ_FILE_COMPRESS_MASK | MPQ_FILE_ENCRYPTED | MPQ_FILE_PATCH_FILE)) == 0)
+		item_info->DataFlags = ITEM_DATA_CONTIGUOUS;
 	item_info->ModificationTime.dwHighDateTime = ffd.dwFileTimeHi;
 	item_info->ModificationTime.dwLowDateTime = ffd.dwFileTimeLo;
 
@@ -176,6 +270,9 @@ int MODULE_EXPORT ExtractItem(HANDLE storage, ExtractOperationParams params)
 	MoPaQ_File* fileObj = (MoPaQ_File*) storage;
 	if (!fileObj) return SER_ERROR_SYSTEM;
 
+	if (optVerifyReport && params.ItemIndex == (int) fileObj->vFiles.size())
+		return VerifyArchive(fileObj, params);
+
 	if (params.ItemIndex < 0 || params.ItemIndex >= (int) fileObj->vFiles.size())
 		return SER_ERROR_SYSTEM;
 
@@ -195,13 +292,15 @@ int MODULE_EXPORT ExtractItem(HANDLE storage, ExtractOperationParams params)
 		return SER_ERROR_WRITE;
 	}
 
-	char copyBuf[32 * 1024];
+	DWORD dwFileSize = SFileGetFileSize(hInFile, NULL);
+	DWORD dwBufSize = (dwFileSize > 0 && dwFileSize < EXTRACT_BUFFER_SIZE) ? dwFileSize : EXTRACT_BUFFER_SIZE;
+	std::vector<char> copyBuf(dwBufSize);
 	DWORD dwBytes = 1;
 	int nRetVal = SER_SUCCESS;
 
 	while (dwBytes > 0)
 	{
-		if (!SFileReadFile(hInFile, copyBuf, sizeof(copyBuf), &dwBytes, NULL) && (GetLastError() != ERROR_HANDLE_EOF))
+		if (!SFileReadFile(hInFile, &copyBuf[0], dwBufSize, &dwBytes, NULL) && (GetLastError() != ERROR_HANDLE_EOF))
 		{
 			nRetVal = SER_ERROR_READ;
 			break;
@@ -211,7 +310,7 @@ int MODULE_EXPORT ExtractItem(HANDLE storage, ExtractOperationParams params)
 		{
 			params.Callbacks.FileProgress(params.Callbacks.signalContext, dwBytes);
 
-			if (!WriteFile(hOutFile, copyBuf, dwBytes, &dwBytes, NULL))
+			if (!WriteFile(hOutFile, &copyBuf[0], dwBytes, &dwBytes, NULL))
 			{
 				nRetVal = SER_ERROR_WRITE;
 				break;
@@ -246,16 +345,25 @@ int MODULE_EXPORT LoadSubModule(ModuleLoadParameters* LoadParams)
 	OptionsList opts(LoadParams->Settings);
 	opts.GetValue(L"ListfilesLocation", optListfilesLocation, _countof(optListfilesLocation));
 	opts.GetValue(L"ListfilesRecursive", optListfilesRecursive);
+	opts.GetValue(L"VerifyReport", optVerifyReport);
+	opts.GetValue(L"VerifyThreads", optVerifyThreads);
+	opts.GetValue(L"DecompressThreads", optDecompressThreads);
 
 	TrimStr(optListfilesLocation);
 	IncludeTrailingPathDelim(optListfilesLocation, _countof(optListfilesLocation));
 
 	g_ListfileEnumComplete = false;
 	g_Listfiles.clear();
+	FreeListfileIndexes();
+
+	SFileSetSectorThreads(optDecompressThreads > 0 ? optDecompressThreads : 0);
 
 	return TRUE;
 }
 
 void MODULE_EXPORT UnloadSubModule()
 {
+	FreeListfileIndexes();
+	// Stops sector decompression threads, must not be left to static destructors
+	SFileSetSectorThreads(1);
 }
@@ -16,4 +16,6 @@
 
 // Additional headers
 #include <vector>
-#include <string>
\ No newline at end of file
+#include <string>
+#include <thread>
+#include <atomic>
\ No newline at end of file
@@ -9,10 +9,15 @@ struct CabCacheItem
 	mscabd_cabinet* data;
 	std::wstring realPath;
 
+	// Cabinet is reopened by name on extraction, so it should live as long as item
+	std::wstring streamName;
+	openfile_s fakeFile;
+
 	CabCacheItem()
 	{
 		decomp = NULL;
 		data = NULL;
+		memset(&fakeFile, 0, sizeof(fakeFile));
 	}
 
 	~CabCacheItem()
@@ -85,6 +90,7 @@ extern struct mspack_system *mspack_fake_system;
 CCabControl::CCabControl(void)
 {
 	m_hOwner = 0;
+	m_pOleStorage = NULL;
 }
 
 CCabControl::~CCabControl(void)
@@ -99,7 +105,8 @@ CCabControl::~CCabControl(void)
 
 bool CCabControl::ExtractFile( const wchar_t* cabName, const wchar_t* cabPath, const wchar_t* sourceFileName, const wchar_t* destFilePath )
 {
-	if (!cabName || !cabPath || !sourceFileName)
+	// Empty cabPath means cabinet is read from the package stream
+	if (!cabName || !sourceFileName)
 		return false;
 	
 	CabCacheItem* item = getCacheItem(cabName, cabPath);
@@ -173,18 +180,19 @@ CabCacheItem* CCabControl::getCacheItem( const wchar_t* cabName, const wchar_t*
 	newItem->decomp = newDecomp;
 	
 	char* openFileName = NULL;
-	openfile_s ofile;
 
-	if (cabPath != NULL)
+	if (cabPath && *cabPath)
 	{
 		newItem->realPath = cabPath;
 		openFileName = (char*) newItem->realPath.c_str();
 	}
 	else
 	{
-		ofile.hMSI = m_hOwner;
-		ofile.streamName = cabName;
-		openFileName = (char *) &ofile;
+		newItem->streamName = cabName;
+		newItem->fakeFile.hMSI = m_hOwner;
+		newItem->fakeFile.oleStorage = m_pOleStorage;
+		newItem->fakeFile.streamName = newItem->streamName.c_str();
+		openFileName = (char *) &newItem->fakeFile;
 	}
 
 	mscabd_cabinet* cabData = newDecomp->open(newDecomp, openFileName);
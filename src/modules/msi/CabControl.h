@@ -9,6 +9,7 @@ class CCabControl
 private:
 	std::map<std::wstring, CabCacheItem*> m_mCabCache;
 	MSIHANDLE m_hOwner;
+	COleStorage* m_pOleStorage;
 
 	CabCacheItem* getCacheItem(const wchar_t* cabName, const wchar_t* cabPath);
 
@@ -20,4 +21,5 @@ public:
 	bool GetFileAttributes(const wchar_t* cabName, const wchar_t* cabPath, const wchar_t* sourceFileName, WIN32_FIND_DATAW &fd);
 
 	void SetOwner(MSIHANDLE owner) { m_hOwner = owner; }
+	void SetOleStorage(COleStorage* storage) { m_pOleStorage = storage; }
 };
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "CabSystem.h"
+#include "OleReader.h"
 
+#include <objbase.h>
 #include <MsiQuery.h>
 #include <mspack.h>
 
@@ -10,23 +12,90 @@ struct mspack_file_s
 {
 	wchar_t* streamName;
 
+	// Stream read through MSI API, it is sequential only so data is cached in memory
 	MSIHANDLE hQuery;
 	MSIHANDLE hStreamRec;
-	int nPos;
-	int nStreamSize;
-
 	char* pMemCache;
 	int nMemCacheSize;
+
+	// Stream read directly from compound file, supports seeking
+	IStream* pStream;
+
+	// Output file for extraction
+	FILE* pOutFile;
+
+	int nPos;
+	int nStreamSize;
 };
 
+static mspack_file_s* msp_fake_alloc(const wchar_t* name)
+{
+	mspack_file_s* fh = (mspack_file_s*) malloc(sizeof(struct mspack_file_s));
+	memset(fh, 0, sizeof(struct mspack_file_s));
+	fh->streamName = _wcsdup(name);
+
+	return fh;
+}
+
+static struct mspack_file *msp_fake_open_output(const char *filename, int mode)
+{
+	const wchar_t* fmode;
+	switch (mode)
+	{
+	case MSPACK_SYS_OPEN_WRITE:  fmode = L"wb";  break;
+	case MSPACK_SYS_OPEN_UPDATE: fmode = L"r+b"; break;
+	case MSPACK_SYS_OPEN_APPEND: fmode = L"ab";  break;
+	default: return NULL;
+	}
+
+	// Output files are passed as regular wide char paths
+	const wchar_t* path = (const wchar_t*) filename;
+	
+	FILE* fp;
+	if (_wfopen_s(&fp, path, fmode) != 0)
+		return NULL;
+
+	mspack_file_s* fh = msp_fake_alloc(path);
+	fh->pOutFile = fp;
+
+	return (mspack_file *) fh;
+}
+
+static struct mspack_file *msp_fake_open_ole(openfile_s* openf)
+{
+	const wchar_t* streamName = openf->streamName[0] == '#' ? openf->streamName + 1 : openf->streamName;
+
+	IStream* pStream = openf->oleStorage->OpenStream(streamName);
+	if (!pStream) return NULL;
+
+	STATSTG stat;
+	if (FAILED(pStream->Stat(&stat, STATFLAG_NONAME)) || (stat.cbSize.QuadPart > INT_MAX))
+	{
+		pStream->Release();
+		return NULL;
+	}
+
+	mspack_file_s* fh = msp_fake_alloc(openf->streamName);
+	fh->pStream = pStream;
+	fh->nStreamSize = (int) stat.cbSize.QuadPart;
+
+	return (mspack_file *) fh;
+}
+
 static struct mspack_file *msp_fake_open(struct mspack_system *thisPtr,	const char *filename, int mode)
 {
 	if (mode != MSPACK_SYS_OPEN_READ)
-		return NULL;
+		return msp_fake_open_output(filename, mode);
+
+	openfile_s* openf = (openfile_s*) filename;
+	if (openf->oleStorage && openf->oleStorage->IsOpen())
+	{
+		mspack_file* oleFile = msp_fake_open_ole(openf);
+		if (oleFile) return oleFile;
+	}
 
 	UINT res;
 	MSIHANDLE hQueryStream, hStreamRec;
-	openfile_s* openf = (openfile_s*) filename;
 
 	res = MsiDatabaseOpenViewW(openf->hMSI, L"SELECT * FROM _Streams", &hQueryStream);
 	if (res != ERROR_SUCCESS) return NULL;
@@ -49,17 +118,11 @@ static struct mspack_file *msp_fake_open(struct mspack_system *thisPtr,	const ch
 
 		if (wcscmp(wszStreamName, openf->streamName + 1) == 0)
 		{
-			mspack_file_s* fh = (mspack_file_s*) malloc(sizeof(struct mspack_file_s));
-			fh->streamName = _wcsdup(openf->streamName);
-
+			mspack_file_s* fh = msp_fake_alloc(openf->streamName);
 			fh->hQuery = hQueryStream;
 			fh->hStreamRec = hStreamRec;
-			fh->nPos = 0;
 			fh->nStreamSize = MsiRecordDataSize(hStreamRec, 2);
 
-			fh->pMemCache = NULL;
-			fh->nMemCacheSize = 0;
-
 			pResult = (mspack_file *) fh;
 			break;
 		}
@@ -81,9 +144,11 @@ static void msp_fake_close(struct mspack_file *file)
 	mspack_file_s* fh = (mspack_file_s*) file;
 	if (fh)
 	{
-		MsiCloseHandle(fh->hStreamRec);
-		MsiCloseHandle(fh->hQuery);
+		if (fh->hStreamRec) MsiCloseHandle(fh->hStreamRec);
+		if (fh->hQuery) MsiCloseHandle(fh->hQuery);
 		if (fh->pMemCache) free(fh->pMemCache);
+		if (fh->pStream) fh->pStream->Release();
+		if (fh->pOutFile) fclose(fh->pOutFile);
 		free(fh->streamName);
 		free(fh);
 	}
@@ -92,7 +157,20 @@ static void msp_fake_close(struct mspack_file *file)
 static int msp_fake_read(struct mspack_file *file, void *buffer, int bytes)
 {
 	mspack_file_s* fh = (mspack_file_s*) file;
-	if (fh)
+	if (fh && fh->pOutFile)
+	{
+		return -1;
+	}
+	else if (fh && fh->pStream)
+	{
+		ULONG cbRead = 0;
+		if (bytes < 0 || FAILED(fh->pStream->Read(buffer, (ULONG) bytes, &cbRead)))
+			return -1;
+
+		fh->nPos += (int) cbRead;
+		return (int) cbRead;
+	}
+	else if (fh)
 	{
 		// Cache data to buffer
 		int nRequredSize = fh->nPos + bytes;
@@ -129,14 +207,51 @@ static int msp_fake_read(struct mspack_file *file, void *buffer, int bytes)
 
 static int msp_fake_write(struct mspack_file *file, void *buffer, int bytes)
 {
-	//Don't need this
+	// Only extraction output can be written
+	mspack_file_s* fh = (mspack_file_s*) file;
+	if (fh && fh->pOutFile && buffer && bytes >= 0)
+	{
+		size_t count = fwrite(buffer, 1, (size_t) bytes, fh->pOutFile);
+		if (!ferror(fh->pOutFile)) return (int) count;
+	}
+
 	return -1;
 }
 
 static int msp_fake_seek(struct mspack_file *file, off_t offset, int mode)
 {
 	mspack_file_s* fh = (mspack_file_s*) file;
-	if (fh)
+	if (fh && fh->pOutFile)
+	{
+		switch (mode)
+		{
+		case MSPACK_SYS_SEEK_START: return fseek(fh->pOutFile, offset, SEEK_SET);
+		case MSPACK_SYS_SEEK_CUR:   return fseek(fh->pOutFile, offset, SEEK_CUR);
+		case MSPACK_SYS_SEEK_END:   return fseek(fh->pOutFile, offset, SEEK_END);
+		}
+	}
+	else if (fh && fh->pStream)
+	{
+		LARGE_INTEGER liMove;
+		liMove.QuadPart = offset;
+
+		DWORD dwOrigin;
+		switch (mode)
+		{
+		case MSPACK_SYS_SEEK_START: dwOrigin = STREAM_SEEK_SET; break;
+		case MSPACK_SYS_SEEK_CUR:   dwOrigin = STREAM_SEEK_CUR; break;
+		case MSPACK_SYS_SEEK_END:   dwOrigin = STREAM_SEEK_END; break;
+		default: return -1;
+		}
+
+		ULARGE_INTEGER liNewPos;
+		if (FAILED(fh->pStream->Seek(liMove, dwOrigin, &liNewPos)))
+			return -1;
+
+		fh->nPos = (int) liNewPos.QuadPart;
+		return 0;
+	}
+	else if (fh)
 	{
 		switch (mode)
 		{
@@ -162,7 +277,9 @@ static int msp_fake_seek(struct mspack_file *file, off_t offset, int mode)
 static off_t msp_fake_tell(struct mspack_file *file)
 {
 	mspack_file_s* fh = (mspack_file_s*) file;
-	if (fh)
+	if (fh && fh->pOutFile)
+		return ftell(fh->pOutFile);
+	else if (fh)
 		return fh->nPos;
 
 	return -1;
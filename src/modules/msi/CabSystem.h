@@ -3,9 +3,12 @@
 
 #include <Msi.h>
 
+class COleStorage;
+
 struct openfile_s
 {
 	MSIHANDLE hMSI;
+	COleStorage* oleStorage;	// Optional, gives seekable access to streams
 	const wchar_t* streamName;
 };
 
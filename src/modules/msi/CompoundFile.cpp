@@ -0,0 +1,348 @@
+#include "stdafx.h"
+#include "CompoundFile.h"
+
+#define CFB_FREESECT 0xFFFFFFFF
+#define CFB_ENDOFCHAIN 0xFFFFFFFE
+#define CFB_MAXREGSECT 0xFFFFFFFA
+#define CFB_NOSTREAM 0xFFFFFFFF
+
+#define CFB_HEADER_SIZE 512
+#define CFB_DIRENTRY_SIZE 128
+#define CFB_HEADER_DIFAT_COUNT 109
+
+#define CFB_OBJ_STORAGE 1
+#define CFB_OBJ_STREAM 2
+#define CFB_OBJ_ROOT 5
+
+static const uint8_t CFB_SIGNATURE[] = { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 };
+
+#pragma pack(push, 1)
+struct CfbHeader
+{
+	uint8_t Signature[8];
+	uint8_t Clsid[16];
+	uint16_t MinorVersion;
+	uint16_t MajorVersion;
+	uint16_t ByteOrder;
+	uint16_t SectorShift;
+	uint16_t MiniSectorShift;
+	uint8_t Reserved[6];
+	uint32_t NumDirSectors;
+	uint32_t NumFatSectors;
+	uint32_t FirstDirSector;
+	uint32_t TransactionSignature;
+	uint32_t MiniStreamCutoff;
+	uint32_t FirstMiniFatSector;
+	uint32_t NumMiniFatSectors;
+	uint32_t FirstDifatSector;
+	uint32_t NumDifatSectors;
+	uint32_t Difat[CFB_HEADER_DIFAT_COUNT];
+};
+
+struct CfbDirEntry
+{
+	wchar_t Name[32];
+	uint16_t NameLength;
+	uint8_t ObjectType;
+	uint8_t ColorFlag;
+	uint32_t LeftSibling;
+	uint32_t RightSibling;
+	uint32_t Child;
+	uint8_t Clsid[16];
+	uint32_t StateBits;
+	FILETIME CreationTime;
+	FILETIME ModifiedTime;
+	uint32_t StartSector;
+	uint64_t StreamSize;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CfbHeader) == CFB_HEADER_SIZE, "Invalid CFB header size");
+static_assert(sizeof(CfbDirEntry) == CFB_DIRENTRY_SIZE, "Invalid CFB directory entry size");
+
+// Version 3 files may have garbage in high part of the size
+static uint64_t getStreamSize(const CfbDirEntry &entry, uint32_t sectorSize)
+{
+	return (sectorSize == 512) ? (entry.StreamSize & 0xFFFFFFFF) : entry.StreamSize;
+}
+
+CCompoundFile::CCompoundFile()
+	: m_hFile(INVALID_HANDLE_VALUE), m_hMapping(NULL), m_pData(nullptr), m_nFileSize(0),
+	m_nSectorSize(0), m_nMiniSectorSize(0), m_nMiniStreamCutoff(0)
+{
+}
+
+CCompoundFile::~CCompoundFile()
+{
+	Close();
+}
+
+bool CCompoundFile::Open(const wchar_t* path)
+{
+	Close();
+
+	m_hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx(m_hFile, &liSize) || (liSize.QuadPart < CFB_HEADER_SIZE) || ((uint64_t) liSize.QuadPart > SIZE_MAX))
+	{
+		Close();
+		return false;
+	}
+	m_nFileSize = liSize.QuadPart;
+
+	m_hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_hMapping)
+		m_pData = (const uint8_t*) MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+
+	const CfbHeader* hdr = (const CfbHeader*) m_pData;
+	if ((memcmp(hdr->Signature, CFB_SIGNATURE, sizeof(CFB_SIGNATURE)) != 0)
+		|| (hdr->SectorShift != 9 && hdr->SectorShift != 12)
+		|| (hdr->MiniSectorShift != 6))
+	{
+		Close();
+		return false;
+	}
+
+	m_nSectorSize = 1 << hdr->SectorShift;
+	m_nMiniSectorSize = 1 << hdr->MiniSectorShift;
+	m_nMiniStreamCutoff = hdr->MiniStreamCutoff;
+
+	if (!loadFat() || !loadDirectory(hdr->FirstDirSector))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void CCompoundFile::Close()
+{
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+		m_pData = nullptr;
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+
+	m_nFileSize = 0;
+	m_vFat.clear();
+	m_vMiniFat.clear();
+	m_vMiniStream.clear();
+	m_mStreams.clear();
+}
+
+const uint8_t* CCompoundFile::getSector(uint32_t sectorIndex) const
+{
+	if (sectorIndex > CFB_MAXREGSECT)
+		return nullptr;
+
+	uint64_t offset = ((uint64_t) sectorIndex + 1) * m_nSectorSize;
+	if (offset + m_nSectorSize > m_nFileSize)
+		return nullptr;
+
+	return m_pData + offset;
+}
+
+bool CCompoundFile::readChain(uint32_t startSector, uint64_t size, std::vector<uint8_t> &dest) const
+{
+	dest.clear();
+
+	// Size comes from directory entry, do not trust it more than the file itself
+	if (size > m_nFileSize)
+		return false;
+	dest.reserve((size_t) min(size, (uint64_t) m_vFat.size() * m_nSectorSize));
+
+	uint32_t sector = startSector;
+	size_t maxSteps = m_vFat.size();
+	while ((dest.size() < size) && (sector != CFB_ENDOFCHAIN))
+	{
+		// Protect from broken or looped chains
+		const uint8_t* data = getSector(sector);
+		if (!data || (sector >= m_vFat.size()) || (maxSteps-- == 0))
+			return false;
+
+		size_t copySize = (size_t) min((uint64_t) m_nSectorSize, size - dest.size());
+		dest.insert(dest.end(), data, data + copySize);
+		
+		sector = m_vFat[sector];
+	}
+
+	return dest.size() == size;
+}
+
+bool CCompoundFile::readMiniChain(uint32_t startSector, uint64_t size, std::vector<uint8_t> &dest) const
+{
+	dest.clear();
+
+	if (size > m_vMiniStream.size())
+		return false;
+	dest.reserve((size_t) min(size, (uint64_t) m_vMiniFat.size() * m_nMiniSectorSize));
+
+	uint32_t sector = startSector;
+	size_t maxSteps = m_vMiniFat.size();
+	while ((dest.size() < size) && (sector != CFB_ENDOFCHAIN))
+	{
+		uint64_t offset = (uint64_t) sector * m_nMiniSectorSize;
+		if ((sector >= m_vMiniFat.size()) || (offset + m_nMiniSectorSize > m_vMiniStream.size()) || (maxSteps-- == 0))
+			return false;
+
+		size_t copySize = (size_t) min((uint64_t) m_nMiniSectorSize, size - dest.size());
+		const uint8_t* data = m_vMiniStream.data() + offset;
+		dest.insert(dest.end(), data, data + copySize);
+
+		sector = m_vMiniFat[sector];
+	}
+
+	return dest.size() == size;
+}
+
+bool CCompoundFile::loadFat()
+{
+	const CfbHeader* hdr = (const CfbHeader*) m_pData;
+	const uint32_t entriesPerSector = m_nSectorSize / sizeof(uint32_t);
+
+	// Collect FAT sector locations from header and DIFAT chain
+	std::vector<uint32_t> vFatSectors;
+	for (uint32_t i = 0; (i < CFB_HEADER_DIFAT_COUNT) && (vFatSectors.size() < hdr->NumFatSectors); i++)
+		vFatSectors.push_back(hdr->Difat[i]);
+
+	uint32_t difatSector = hdr->FirstDifatSector;
+	for (uint32_t n = 0; (n < hdr->NumDifatSectors) && (vFatSectors.size() < hdr->NumFatSectors); n++)
+	{
+		const uint32_t* difat = (const uint32_t*) getSector(difatSector);
+		if (!difat) return false;
+
+		for (uint32_t i = 0; (i < entriesPerSector - 1) && (vFatSectors.size() < hdr->NumFatSectors); i++)
+			vFatSectors.push_back(difat[i]);
+		
+		difatSector = difat[entriesPerSector - 1];
+	}
+
+	if (vFatSectors.size() != hdr->NumFatSectors)
+		return false;
+
+	m_vFat.reserve(vFatSectors.size() * entriesPerSector);
+	for (auto it = vFatSectors.begin(); it != vFatSectors.end(); ++it)
+	{
+		const uint32_t* fat = (const uint32_t*) getSector(*it);
+		if (!fat) return false;
+
+		m_vFat.insert(m_vFat.end(), fat, fat + entriesPerSector);
+	}
+
+	// Mini FAT is stored as a regular chain
+	if (hdr->NumMiniFatSectors > 0)
+	{
+		std::vector<uint8_t> vMiniFatData;
+		if (!readChain(hdr->FirstMiniFatSector, (uint64_t) hdr->NumMiniFatSectors * m_nSectorSize, vMiniFatData))
+			return false;
+
+		const uint32_t* miniFat = (const uint32_t*) vMiniFatData.data();
+		m_vMiniFat.assign(miniFat, miniFat + vMiniFatData.size() / sizeof(uint32_t));
+	}
+
+	return true;
+}
+
+bool CCompoundFile::loadDirectory(uint32_t firstDirSector)
+{
+	// Directory size is not stored in v3 files, so just walk the chain
+	std::vector<uint8_t> vDirData;
+	uint32_t sector = firstDirSector;
+	size_t maxSteps = m_vFat.size();
+	while (sector != CFB_ENDOFCHAIN)
+	{
+		const uint8_t* data = getSector(sector);
+		if (!data || (sector >= m_vFat.size()) || (maxSteps-- == 0))
+			return false;
+
+		vDirData.insert(vDirData.end(), data, data + m_nSectorSize);
+		sector = m_vFat[sector];
+	}
+
+	const CfbDirEntry* entries = (const CfbDirEntry*) vDirData.data();
+	size_t numEntries = vDirData.size() / CFB_DIRENTRY_SIZE;
+	if ((numEntries == 0) || (entries[0].ObjectType != CFB_OBJ_ROOT))
+		return false;
+
+	// Root entry holds the mini stream
+	const CfbDirEntry &root = entries[0];
+	uint64_t nMiniStreamSize = getStreamSize(root, m_nSectorSize);
+	if ((nMiniStreamSize > 0) && !readChain(root.StartSector, nMiniStreamSize, m_vMiniStream))
+		return false;
+
+	// Walk siblings tree of the root storage children
+	std::vector<uint32_t> vStack;
+	std::vector<bool> vVisited(numEntries, false);
+	if (root.Child != CFB_NOSTREAM)
+		vStack.push_back(root.Child);
+	
+	while (!vStack.empty())
+	{
+		uint32_t index = vStack.back();
+		vStack.pop_back();
+
+		if ((index >= numEntries) || vVisited[index]) continue;
+		vVisited[index] = true;
+
+		const CfbDirEntry &entry = entries[index];
+		if (entry.LeftSibling != CFB_NOSTREAM) vStack.push_back(entry.LeftSibling);
+		if (entry.RightSibling != CFB_NOSTREAM) vStack.push_back(entry.RightSibling);
+
+		if ((entry.ObjectType == CFB_OBJ_STREAM) && (entry.NameLength >= 2) && (entry.NameLength <= sizeof(entry.Name)))
+		{
+			std::wstring strName(entry.Name, entry.NameLength / sizeof(wchar_t) - 1);
+
+			StreamEntry se;
+			se.StartSector = entry.StartSector;
+			se.Size = getStreamSize(entry, m_nSectorSize);
+			m_mStreams[strName] = se;
+		}
+	}
+
+	return true;
+}
+
+void CCompoundFile::GetStreamNames(std::vector<std::wstring> &names) const
+{
+	names.clear();
+	for (auto it = m_mStreams.cbegin(); it != m_mStreams.cend(); ++it)
+		names.push_back(it->first);
+}
+
+bool CCompoundFile::ReadStream(const std::wstring &name, std::vector<uint8_t> &dest) const
+{
+	auto it = m_mStreams.find(name);
+	if (it == m_mStreams.end())
+		return false;
+
+	const StreamEntry &se = it->second;
+	if (se.Size == 0)
+	{
+		dest.clear();
+		return true;
+	}
+
+	if (se.Size < m_nMiniStreamCutoff)
+		return readMiniChain(se.StartSector, se.Size, dest);
+	else
+		return readChain(se.StartSector, se.Size, dest);
+}
@@ -0,0 +1,47 @@
+#ifndef CompoundFile_h__
+#define CompoundFile_h__
+
+// Read-only Compound File Binary (OLE2) reader over memory mapped file.
+// Only streams from root storage are accessible, which is enough for MSI packages.
+class CCompoundFile
+{
+private:
+	struct StreamEntry
+	{
+		uint32_t StartSector;
+		uint64_t Size;
+	};
+
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+	const uint8_t* m_pData;
+	uint64_t m_nFileSize;
+
+	uint32_t m_nSectorSize;
+	uint32_t m_nMiniSectorSize;
+	uint32_t m_nMiniStreamCutoff;
+
+	std::vector<uint32_t> m_vFat;
+	std::vector<uint32_t> m_vMiniFat;
+	std::vector<uint8_t> m_vMiniStream;
+	std::map<std::wstring, StreamEntry> m_mStreams;
+
+	const uint8_t* getSector(uint32_t sectorIndex) const;
+	bool readChain(uint32_t startSector, uint64_t size, std::vector<uint8_t> &dest) const;
+	bool readMiniChain(uint32_t startSector, uint64_t size, std::vector<uint8_t> &dest) const;
+	bool loadFat();
+	bool loadDirectory(uint32_t firstDirSector);
+
+public:
+	CCompoundFile();
+	~CCompoundFile();
+
+	bool Open(const wchar_t* path);
+	void Close();
+
+	// Names are raw compound names, as stored in directory
+	void GetStreamNames(std::vector<std::wstring> &names) const;
+	bool ReadStream(const std::wstring &name, std::vector<uint8_t> &dest) const;
+};
+
+#endif // CompoundFile_h__
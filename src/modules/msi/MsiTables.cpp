@@ -0,0 +1,298 @@
+#include "stdafx.h"
+#include "MsiTables.h"
+#include "OleReader.h"
+
+#include <MsiQuery.h>
+
+#define MSI_LONG_STRING_REFS 0x8000
+
+static const std::wstring EmptyString;
+
+//////////////////////////////////////////////////////////////////////////
+
+uint32_t CMsiTable::getRawValue(size_t row, size_t col) const
+{
+	const MsiColumnInfo &colInfo = m_vColumns[col];
+	const uint8_t* valPtr = m_vData.data() + colInfo.DataOffset + row * colInfo.DataSize;
+
+	switch (colInfo.DataSize)
+	{
+	case 2:
+		return valPtr[0] | (valPtr[1] << 8);
+	case 3:
+		return valPtr[0] | (valPtr[1] << 8) | (valPtr[2] << 16);
+	case 4:
+		return valPtr[0] | (valPtr[1] << 8) | (valPtr[2] << 16) | ((uint32_t) valPtr[3] << 24);
+	}
+
+	return 0;
+}
+
+const std::wstring& CMsiTable::GetString(size_t row, size_t col) const
+{
+	if ((row >= m_nRowCount) || (col >= m_vColumns.size()) || !(m_vColumns[col].Type & MSICOL_STRING))
+		return EmptyString;
+
+	return m_pOwner->getString(getRawValue(row, col));
+}
+
+int CMsiTable::GetInteger(size_t row, size_t col) const
+{
+	if ((row >= m_nRowCount) || (col >= m_vColumns.size()) || (m_vColumns[col].Type & MSICOL_STRING))
+		return MSI_NULL_INTEGER;
+
+	uint32_t rawVal = getRawValue(row, col);
+	if (rawVal == 0)
+		return MSI_NULL_INTEGER;
+
+	// Integers are stored with inverted sign bit
+	if (m_vColumns[col].DataSize == 2)
+		return (int16_t) (rawVal ^ 0x8000);
+	else
+		return (int32_t) (rawVal ^ 0x80000000);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CMsiDatabaseReader::CMsiDatabaseReader() : m_nCodepage(CP_ACP), m_nStringRefSize(2)
+{
+}
+
+bool CMsiDatabaseReader::Open(const wchar_t* path)
+{
+	Close();
+
+	if (!m_cfFile.Open(path))
+		return false;
+
+	std::vector<std::wstring> vNames;
+	m_cfFile.GetStreamNames(vNames);
+	for (auto it = vNames.begin(); it != vNames.end(); ++it)
+	{
+		std::wstring strDecodedName;
+		if (DecodeMsiStreamName(it->c_str(), strDecodedName))
+			m_mStreamNames[strDecodedName] = *it;
+	}
+
+	if (!loadStringPool() || !loadColumns())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void CMsiDatabaseReader::Close()
+{
+	m_cfFile.Close();
+	m_mStreamNames.clear();
+	m_vStringData.clear();
+	m_vStringOffsets.clear();
+	m_vStringSizes.clear();
+	m_vStrings.clear();
+	m_vStringDecoded.clear();
+	m_mTableColumns.clear();
+}
+
+bool CMsiDatabaseReader::readStream(const wchar_t* name, std::vector<uint8_t> &dest) const
+{
+	auto it = m_mStreamNames.find(name);
+	if (it == m_mStreamNames.end())
+		return false;
+
+	return m_cfFile.ReadStream(it->second, dest);
+}
+
+bool CMsiDatabaseReader::loadStringPool()
+{
+	std::vector<uint8_t> vPool;
+	if (!readStream(L"!_StringPool", vPool) || !readStream(L"!_StringData", m_vStringData))
+		return false;
+
+	if (vPool.size() < 4) return false;
+
+	const uint16_t* pool = (const uint16_t*) vPool.data();
+	size_t count = vPool.size() / 4;
+
+	// First entry holds database codepage and string reference size flag
+	m_nCodepage = pool[0] | ((pool[1] & ~MSI_LONG_STRING_REFS) << 16);
+	m_nStringRefSize = (pool[1] & MSI_LONG_STRING_REFS) ? 3 : 2;
+	if (m_nCodepage == 0)
+		m_nCodepage = CP_ACP;
+
+	// String id 0 is always null string
+	m_vStringOffsets.push_back(0);
+	m_vStringSizes.push_back(0);
+
+	size_t nDataOffset = 0;
+	size_t i = 1;
+	while (i < count)
+	{
+		uint16_t refs = pool[i * 2 + 1];
+		size_t len;
+
+		if ((pool[i * 2] == 0) && (refs == 0))
+		{
+			// Empty entry still has an id
+			len = 0;
+			i++;
+		}
+		else if (pool[i * 2] == 0)
+		{
+			// Strings longer then 64k use two entries
+			if (i + 1 >= count) return false;
+			len = ((size_t) pool[i * 2 + 3] << 16) | pool[i * 2 + 2];
+			i += 2;
+		}
+		else
+		{
+			len = pool[i * 2];
+			i++;
+		}
+
+		if (nDataOffset + len > m_vStringData.size())
+			return false;
+
+		m_vStringOffsets.push_back(nDataOffset);
+		m_vStringSizes.push_back(len);
+		nDataOffset += len;
+	}
+
+	m_vStrings.resize(m_vStringOffsets.size());
+	m_vStringDecoded.resize(m_vStringOffsets.size(), false);
+
+	return true;
+}
+
+const std::wstring& CMsiDatabaseReader::getString(uint32_t stringId) const
+{
+	if ((stringId == 0) || (stringId >= m_vStrings.size()))
+		return EmptyString;
+
+	if (!m_vStringDecoded[stringId])
+	{
+		size_t len = m_vStringSizes[stringId];
+		if (len > 0)
+		{
+			const char* src = (const char*) m_vStringData.data() + m_vStringOffsets[stringId];
+			int wlen = MultiByteToWideChar(m_nCodepage, 0, src, (int) len, NULL, 0);
+			if (wlen > 0)
+			{
+				std::wstring &dest = m_vStrings[stringId];
+				dest.resize(wlen);
+				MultiByteToWideChar(m_nCodepage, 0, src, (int) len, &dest[0], wlen);
+			}
+		}
+		m_vStringDecoded[stringId] = true;
+	}
+
+	return m_vStrings[stringId];
+}
+
+size_t CMsiDatabaseReader::getColumnSize(int colType) const
+{
+	// Binary columns hold stream references
+	if ((colType & ~MSICOL_NULLABLE) == (MSICOL_STRING | MSICOL_VALID))
+		return 2;
+	if (colType & MSICOL_STRING)
+		return m_nStringRefSize;
+	if ((colType & MSICOL_SIZE_MASK) <= 2)
+		return 2;
+	return 4;
+}
+
+bool CMsiDatabaseReader::loadColumns()
+{
+	// _Columns table has fixed layout: Table (string), Number (short), Name (string), Type (short)
+	CMsiTable colTable;
+	colTable.m_pOwner = this;
+
+	MsiColumnInfo fixedCols[] = {
+		{ L"Table", 1, MSICOL_VALID | MSICOL_STRING | 64, 0, 0 },
+		{ L"Number", 2, MSICOL_VALID | 2, 0, 0 },
+		{ L"Name", 3, MSICOL_VALID | MSICOL_STRING | 64, 0, 0 },
+		{ L"Type", 4, MSICOL_VALID | 2, 0, 0 },
+	};
+
+	if (!readStream(L"!_Columns", colTable.m_vData))
+		return false;
+
+	size_t nRowSize = 0;
+	for (size_t i = 0; i < _countof(fixedCols); i++)
+		nRowSize += getColumnSize(fixedCols[i].Type);
+	colTable.m_nRowCount = colTable.m_vData.size() / nRowSize;
+
+	size_t nOffset = 0;
+	for (size_t i = 0; i < _countof(fixedCols); i++)
+	{
+		fixedCols[i].DataOffset = nOffset;
+		fixedCols[i].DataSize = getColumnSize(fixedCols[i].Type);
+		nOffset += fixedCols[i].DataSize * colTable.m_nRowCount;
+
+		colTable.m_vColumns.push_back(fixedCols[i]);
+	}
+
+	for (size_t row = 0; row < colTable.GetRowCount(); row++)
+	{
+		MsiColumnInfo colInfo;
+		colInfo.Number = colTable.GetInteger(row, 1);
+		colInfo.Name = colTable.GetString(row, 2);
+		colInfo.Type = colTable.GetInteger(row, 3);
+		colInfo.DataOffset = 0;
+		colInfo.DataSize = 0;
+
+		if ((colInfo.Number == MSI_NULL_INTEGER) || (colInfo.Type == MSI_NULL_INTEGER))
+			return false;
+
+		// Stored type value has inverted high bit like any short integer
+		colInfo.Type &= 0xFFFF;
+		
+		m_mTableColumns[colTable.GetString(row, 0)].push_back(colInfo);
+	}
+
+	return true;
+}
+
+static bool ColumnNumberSortPred(const MsiColumnInfo &col1, const MsiColumnInfo &col2)
+{
+	return col1.Number < col2.Number;
+}
+
+bool CMsiDatabaseReader::ReadTable(const wchar_t* tableName, CMsiTable &table) const
+{
+	auto colIt = m_mTableColumns.find(tableName);
+	if (colIt == m_mTableColumns.end())
+		return false;
+
+	table.m_pOwner = this;
+	table.m_vColumns = colIt->second;
+	std::sort(table.m_vColumns.begin(), table.m_vColumns.end(), ColumnNumberSortPred);
+
+	// Table without stream is just empty
+	std::wstring strStreamName = std::wstring(L"!") + tableName;
+	if (!readStream(strStreamName.c_str(), table.m_vData))
+		table.m_vData.clear();
+
+	size_t nRowSize = 0;
+	for (auto it = table.m_vColumns.begin(); it != table.m_vColumns.end(); ++it)
+	{
+		if (!(it->Type & MSICOL_TEMPORARY))
+			nRowSize += getColumnSize(it->Type);
+	}
+	if (nRowSize == 0) return false;
+
+	table.m_nRowCount = table.m_vData.size() / nRowSize;
+
+	size_t nOffset = 0;
+	for (auto it = table.m_vColumns.begin(); it != table.m_vColumns.end(); ++it)
+	{
+		if (it->Type & MSICOL_TEMPORARY) continue;
+
+		it->DataOffset = nOffset;
+		it->DataSize = getColumnSize(it->Type);
+		nOffset += it->DataSize * table.m_nRowCount;
+	}
+
+	return true;
+}
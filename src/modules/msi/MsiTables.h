@@ -0,0 +1,84 @@
+#ifndef MsiTables_h__
+#define MsiTables_h__
+
+#include "CompoundFile.h"
+
+// Column type bits from MSI database format
+#define MSICOL_SIZE_MASK 0x00FF
+#define MSICOL_VALID 0x0100
+#define MSICOL_STRING 0x0800
+#define MSICOL_NULLABLE 0x1000
+#define MSICOL_TEMPORARY 0x4000
+
+struct MsiColumnInfo
+{
+	std::wstring Name;
+	int Number;
+	int Type;
+	
+	size_t DataOffset;
+	size_t DataSize;
+};
+
+class CMsiDatabaseReader;
+
+// Table data as loaded from table stream, values are stored column by column
+class CMsiTable
+{
+	friend class CMsiDatabaseReader;
+
+private:
+	const CMsiDatabaseReader* m_pOwner;
+	std::vector<MsiColumnInfo> m_vColumns;
+	std::vector<uint8_t> m_vData;
+	size_t m_nRowCount;
+
+	uint32_t getRawValue(size_t row, size_t col) const;
+
+public:
+	CMsiTable() : m_pOwner(nullptr), m_nRowCount(0) {}
+
+	size_t GetRowCount() const { return m_nRowCount; }
+	size_t GetColumnCount() const { return m_vColumns.size(); }
+
+	// Column indices are zero based
+	const std::wstring& GetString(size_t row, size_t col) const;
+	int GetInteger(size_t row, size_t col) const;
+};
+
+// Reads MSI tables straight from compound file without Windows Installer API
+class CMsiDatabaseReader
+{
+	friend class CMsiTable;
+
+private:
+	CCompoundFile m_cfFile;
+	std::map<std::wstring, std::wstring> m_mStreamNames;
+
+	// String pool, strings are decoded on first access
+	UINT m_nCodepage;
+	size_t m_nStringRefSize;
+	std::vector<uint8_t> m_vStringData;
+	std::vector<size_t> m_vStringOffsets;
+	std::vector<size_t> m_vStringSizes;
+	mutable std::vector<std::wstring> m_vStrings;
+	mutable std::vector<bool> m_vStringDecoded;
+
+	std::map<std::wstring, std::vector<MsiColumnInfo>> m_mTableColumns;
+
+	bool readStream(const wchar_t* name, std::vector<uint8_t> &dest) const;
+	bool loadStringPool();
+	bool loadColumns();
+	size_t getColumnSize(int colType) const;
+	const std::wstring& getString(uint32_t stringId) const;
+
+public:
+	CMsiDatabaseReader();
+
+	bool Open(const wchar_t* path);
+	void Close();
+
+	bool ReadTable(const wchar_t* tableName, CMsiTable &table) const;
+};
+
+#endif // MsiTables_h__
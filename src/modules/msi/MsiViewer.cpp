@@ -95,6 +95,7 @@ CMsiViewer::CMsiViewer(void)
 	memset(&m_ftCreateTime, 0, sizeof(m_ftCreateTime));
 	m_pCabControl = new CCabControl();
 	m_eType = MsiFileType::Unknown;
+	m_fNativeDbOpen = false;
 }
 
 CMsiViewer::~CMsiViewer(void)
@@ -116,6 +117,9 @@ int CMsiViewer::Open( const wchar_t* path, DWORD openFlags )
 		
 	OK( MsiOpenDatabaseW(path, MSIDBOPEN_READONLY, &m_hMsi) );
 
+	// Main tables are read directly from file if possible, it is much faster then MSI API
+	m_fNativeDbOpen = m_nativeDb.Open(path);
+
 	DirectoryNodesMap mDirs;
 	ComponentEntryMap mComponents;
 
@@ -131,6 +135,9 @@ int CMsiViewer::Open( const wchar_t* path, DWORD openFlags )
 	// Get File entry list
 	OK ( readFiles(mDirs, mComponents) );
 
+	m_nativeDb.Close();
+	m_fNativeDbOpen = false;
+
 	// List all embedded binary streams as files
 	OK ( readEmbeddedFiles(mDirs) );
 
@@ -163,6 +170,10 @@ int CMsiViewer::Open( const wchar_t* path, DWORD openFlags )
 
 	m_strStorageLocation = path;
 	m_pCabControl->SetOwner(m_hMsi);
+
+	// Direct access to compound file streams lets us read embedded cabinets without temp copies
+	if (m_oleStorage.Open(path))
+		m_pCabControl->SetOleStorage(&m_oleStorage);
 	
 	return ERROR_SUCCESS;
 }
@@ -179,6 +190,23 @@ UINT CMsiViewer::readDirectories(DirectoryNodesMap &nodemap)
 	if (m_pRootDir)
 		delete m_pRootDir;
 	m_pRootDir = new DirectoryNode();
+
+	CMsiTable tblDirs;
+	if (m_fNativeDbOpen && m_nativeDb.ReadTable(L"Directory", tblDirs))
+	{
+		for (size_t i = 0; i < tblDirs.GetRowCount(); i++)
+		{
+			DirectoryEntry dirEntry;
+
+			dirEntry.Key = tblDirs.GetString(i, 0);
+			dirEntry.ParentKey = tblDirs.GetString(i, 1);
+			dirEntry.DefaultDir = tblDirs.GetString(i, 2);
+
+			addDirectoryEntry(dirEntry, appSearch, nodemap);
+		}
+
+		return ERROR_SUCCESS;
+	}
 	
 	PMSIHANDLE hQueryDirs;
 	OK_MISS( MsiDatabaseOpenViewW(m_hMsi, L"SELECT * FROM Directory", &hQueryDirs) );
@@ -196,23 +224,49 @@ UINT CMsiViewer::readDirectories(DirectoryNodesMap &nodemap)
 		dirEntry.ParentKey = GetCellString(hDirRec, 2);
 		dirEntry.DefaultDir = GetCellString(hDirRec, 3);
 
-		if (dirEntry.Key.empty()) continue;
-
-		auto citer = appSearch.find(dirEntry.Key);
-		bool fIsAppSearch = (citer != appSearch.end());
-
-		DirectoryNode *node = new DirectoryNode();
-		if (node->Init(&dirEntry, fIsAppSearch))
-			nodemap[dirEntry.Key] = node;
-		else
-			delete node;
+		addDirectoryEntry(dirEntry, appSearch, nodemap);
 	}
 
 	return ERROR_SUCCESS;
 }
 
+void CMsiViewer::addDirectoryEntry(DirectoryEntry &dirEntry, const WStringMap &appSearch, DirectoryNodesMap &nodemap)
+{
+	if (dirEntry.Key.empty()) return;
+
+	auto citer = appSearch.find(dirEntry.Key);
+	bool fIsAppSearch = (citer != appSearch.end());
+
+	DirectoryNode *node = new DirectoryNode();
+	if (node->Init(&dirEntry, fIsAppSearch))
+		nodemap[dirEntry.Key] = node;
+	else
+		delete node;
+}
+
 UINT CMsiViewer::readComponents( ComponentEntryMap &componentmap )
 {
+	CMsiTable tblComps;
+	if (m_fNativeDbOpen && m_nativeDb.ReadTable(L"Component", tblComps))
+	{
+		for (size_t i = 0; i < tblComps.GetRowCount(); i++)
+		{
+			ComponentEntry compEntry;
+
+			compEntry.Key = tblComps.GetString(i, 0);
+			compEntry.Directory_ = tblComps.GetString(i, 2);
+			int nAttributes = tblComps.GetInteger(i, 3);
+
+			if (!compEntry.Key.empty() && (nAttributes != MSI_NULL_INTEGER))
+			{
+				compEntry.Attributes = nAttributes;
+				componentmap[compEntry.Key] = compEntry;
+			}
+		}
+
+		return ERROR_SUCCESS;
+	}
+
 	return iterateOptionalMsiTable(L"Component", [&componentmap](MSIHANDLE hCompRec) {
 		ComponentEntry compEntry;
 
@@ -234,6 +288,26 @@ UINT CMsiViewer::readFiles( DirectoryNodesMap &nodemap, ComponentEntryMap &compo
 	if (nodemap.size() == 0 || componentmap.size() == 0)
 		return ERROR_SUCCESS;
 
+	CMsiTable tblFiles;
+	if (m_fNativeDbOpen && m_nativeDb.ReadTable(L"File", tblFiles))
+	{
+		for (size_t i = 0; i < tblFiles.GetRowCount(); i++)
+		{
+			FileEntry fileEntry;
+
+			fileEntry.Key = tblFiles.GetString(i, 0);
+			fileEntry.Component_ = tblFiles.GetString(i, 1);
+			fileEntry.FileName = tblFiles.GetString(i, 2);
+			fileEntry.FileSize = tblFiles.GetInteger(i, 3);
+			fileEntry.Attributes = tblFiles.GetInteger(i, 6);
+			fileEntry.Sequence = tblFiles.GetInteger(i, 7);
+
+			addFileEntry(fileEntry, nodemap, componentmap);
+		}
+
+		return ERROR_SUCCESS;
+	}
+
 	OK( MsiDatabaseOpenViewW(m_hMsi, L"SELECT * FROM File", &hQueryFile) );
 	OK( MsiViewExecute(hQueryFile, 0) );
 
@@ -252,30 +326,35 @@ UINT CMsiViewer::readFiles( DirectoryNodesMap &nodemap, ComponentEntryMap &compo
 		fileEntry.Attributes = MsiRecordGetInteger(hFileRec, 7);
 		fileEntry.Sequence = MsiRecordGetInteger(hFileRec, 8);
 
-		// Sometimes there are strange files with empty component, let's just skip them
-		if (fileEntry.Component_.empty() || (fileEntry.Component_ == L" "))
-			continue;
+		addFileEntry(fileEntry, nodemap, componentmap);
+	}
 
-		// If file refers to non-existing component then skip it
-		if (componentmap.find(fileEntry.Component_) == componentmap.end())
-			continue;
+	return ERROR_SUCCESS;
+}
 
-		FileNode *node = new FileNode();
-		node->Init(&fileEntry);
+void CMsiViewer::addFileEntry(FileEntry &fileEntry, DirectoryNodesMap &nodemap, ComponentEntryMap &componentmap)
+{
+	// Sometimes there are strange files with empty component, let's just skip them
+	if (fileEntry.Component_.empty() || (fileEntry.Component_ == L" "))
+		return;
 
-		const ComponentEntry &component = componentmap[fileEntry.Component_];
-		DirectoryNode *dir = nodemap[component.Directory_];
-		
-		if (!dir)
-		{
-			dir = new DirectoryNode();
-			dir->Init(component.Directory_);
-			nodemap[component.Directory_] = dir;
-		}
-		dir->AddFile(node);
-	}
+	// If file refers to non-existing component then skip it
+	if (componentmap.find(fileEntry.Component_) == componentmap.end())
+		return;
 
-	return ERROR_SUCCESS;
+	FileNode *node = new FileNode();
+	node->Init(&fileEntry);
+
+	const ComponentEntry &component = componentmap[fileEntry.Component_];
+	DirectoryNode *dir = nodemap[component.Directory_];
+	
+	if (!dir)
+	{
+		dir = new DirectoryNode();
+		dir->Init(component.Directory_);
+		nodemap[component.Directory_] = dir;
+	}
+	dir->AddFile(node);
 }
 
 UINT CMsiViewer::readAppSearch(WStringMap &entries)
@@ -944,11 +1023,34 @@ UINT CMsiViewer::generateLicenseText()
 	return ERROR_SUCCESS;
 }
 
+static bool MediaSortPred(const MediaEntry &media1, const MediaEntry &media2)
+{
+	return media1.LastSequence < media2.LastSequence;
+}
+
 UINT CMsiViewer::readMediaSources()
 {
 	UINT res;
 	PMSIHANDLE hQueryMedia;
 
+	CMsiTable tblMedia;
+	if (m_fNativeDbOpen && m_nativeDb.ReadTable(L"Media", tblMedia))
+	{
+		for (size_t i = 0; i < tblMedia.GetRowCount(); i++)
+		{
+			MediaEntry mEntry;
+
+			mEntry.DiskId = tblMedia.GetInteger(i, 0);
+			mEntry.LastSequence = tblMedia.GetInteger(i, 1);
+			mEntry.Cabinet = tblMedia.GetString(i, 3);
+
+			m_vMedias.push_back(mEntry);
+		}
+		std::stable_sort(m_vMedias.begin(), m_vMedias.end(), MediaSortPred);
+
+		return ERROR_SUCCESS;
+	}
+
 	OK_MISS( MsiDatabaseOpenViewW(m_hMsi, L"SELECT * FROM Media ORDER BY `LastSequence`", &hQueryMedia) );
 	OK( MsiViewExecute(hQueryMedia, 0) );
 
@@ -1117,10 +1219,15 @@ int CMsiViewer::DumpFileContent( FileNode *file, const wchar_t *destFilePath, Ex
 		else
 		{
 			std::wstring strCabPath;
+			bool fDirectStream = false;
 			if (cab[0] == '#' || m_eType == MsiFileType::MergeModule)
 			{
-				// Copy from internal stream
-				if (cacheInternalStream(cab))
+				const wchar_t* msiInternalStreamName = cab[0] == '#' ? cab + 1 : cab;
+				
+				// Read internal stream in place if possible, otherwise copy it to temp folder
+				if (m_oleStorage.IsOpen() && m_oleStorage.HasStream(msiInternalStreamName))
+					fDirectStream = true;
+				else if (cacheInternalStream(cab))
 					strCabPath = m_mStreamCache[cab];
 			}
 			else
@@ -1130,9 +1237,9 @@ int CMsiViewer::DumpFileContent( FileNode *file, const wchar_t *destFilePath, Ex
 				strCabPath.append(cab);
 			}
 
-			if (strCabPath.length() > 0)
+			if (fDirectStream || (strCabPath.length() > 0))
 			{
-				bool extr_res = m_pCabControl->ExtractFile(cab, strCabPath.c_str(), file->Key.c_str(), destFilePath);
+				bool extr_res = m_pCabControl->ExtractFile(cab, fDirectStream ? NULL : strCabPath.c_str(), file->Key.c_str(), destFilePath);
 				result = extr_res ? SER_SUCCESS : SER_ERROR_READ;
 			}
 		}
@@ -2,6 +2,8 @@
 
 #include "ContentStructs.h"
 #include "CabControl.h"
+#include "OleReader.h"
+#include "MsiTables.h"
 #include "ModuleDef.h"
 
 typedef std::map<std::wstring, DirectoryNode*> DirectoryNodesMap;
@@ -35,6 +37,9 @@ private:
 	MsiFileType m_eType;
 	
 	CCabControl* m_pCabControl;
+	COleStorage m_oleStorage;
+	CMsiDatabaseReader m_nativeDb;
+	bool m_fNativeDbOpen;
 	std::wstring m_strStreamCacheLocation;
 	std::map<std::wstring, std::wstring> m_mStreamCache;
 
@@ -47,6 +52,9 @@ private:
 	UINT readEmbeddedFiles(DirectoryNodesMap &nodemap);
 	UINT readPackageType();
 
+	void addDirectoryEntry(DirectoryEntry &dirEntry, const WStringMap &appSearch, DirectoryNodesMap &nodemap);
+	void addFileEntry(FileEntry &fileEntry, DirectoryNodesMap &nodemap, ComponentEntryMap &componentmap);
+
 	void assignParentDirs(DirectoryNodesMap &nodemap, bool processSpecialDirs);
 	void removeEmptyFolders(DirectoryNode *root, WStringMap &forcedFolders);
 	void mergeDotFolders(DirectoryNode *root);
@@ -45,7 +45,7 @@ bool COleStorage::Open(const wchar_t* storagePath)
 				if (rgelt.type == STGTY_STREAM)
 				{
 					std::wstring fileName;
-					if (CompoundMsiNameToFileName(rgelt.pwcsName, fileName))
+					if (DecodeMsiStreamName(rgelt.pwcsName, fileName))
 						m_mStreamNames[fileName] = rgelt.pwcsName;
 				}
 				
@@ -75,18 +75,27 @@ void COleStorage::Close()
 	m_mStreamNames.clear();
 }
 
-bool COleStorage::ExtractStream(const wchar_t* streamFileName, const wchar_t* destPath)
+IStream* COleStorage::OpenStream(const wchar_t* streamFileName)
 {
+	if (!m_pStoragePtr) return nullptr;
+
 	auto findIt = m_mStreamNames.find(streamFileName);
 	if (findIt == m_mStreamNames.end())
-		return false;
+		return nullptr;
 
 	auto streamCompoundName = findIt->second;
 	IStorage* pStor = (IStorage*)m_pStoragePtr;
 
 	IStream *pStream;
 	HRESULT hr = pStor->OpenStream(streamCompoundName.c_str(), NULL, STGM_READ | STGM_SHARE_EXCLUSIVE, 0, &pStream);
-	if (SUCCEEDED(hr))
+	
+	return SUCCEEDED(hr) ? pStream : nullptr;
+}
+
+bool COleStorage::ExtractStream(const wchar_t* streamFileName, const wchar_t* destPath)
+{
+	IStream *pStream = OpenStream(streamFileName);
+	if (pStream)
 	{
 		STATSTG stat;
 		if (SUCCEEDED(pStream->Stat(&stat, STATFLAG_DEFAULT)))
@@ -109,7 +118,7 @@ bool COleStorage::ExtractStream(const wchar_t* streamFileName, const wchar_t* de
 			while (bytesLeft > 0)
 			{
 				copySize = (ULONG) min(cnCopyBufSize, bytesLeft);
-				hr = pStream->Read(copyBuf, copySize, &cbRead);
+				HRESULT hr = pStream->Read(copyBuf, copySize, &cbRead);
 				if (SUCCEEDED(hr))
 				{
 					WriteFile(hOutFile, copyBuf, copySize, &cbRead, NULL);
@@ -127,13 +136,15 @@ bool COleStorage::ExtractStream(const wchar_t* streamFileName, const wchar_t* de
 
 			return isSuccess;
 		}
+
+		pStream->Release();
 	}
 
 	return false;
 }
 
 // Code from 7zip sources
-bool COleStorage::CompoundMsiNameToFileName(const wchar_t *compoundMsiName, std::wstring &outFileName)
+bool DecodeMsiStreamName(const wchar_t *compoundMsiName, std::wstring &outFileName)
 {
 	size_t name_len = wcslen(compoundMsiName);
 
@@ -1,6 +1,8 @@
 #ifndef OleReader_h__
 #define OleReader_h__
 
+struct IStream;
+
 class COleStorage
 {
 public:
@@ -10,13 +12,19 @@ public:
 	bool Open(const wchar_t* storagePath);
 	void Close();
 
+	bool IsOpen() const { return m_pStoragePtr != nullptr; }
+	bool HasStream(const wchar_t* streamFileName) const { return m_mStreamNames.find(streamFileName) != m_mStreamNames.end(); }
+
 	bool ExtractStream(const wchar_t* streamFileName, const wchar_t* destPath);
+	IStream* OpenStream(const wchar_t* streamFileName);
 
 private:
 	void* m_pStoragePtr;
 	std::map<std::wstring, std::wstring> m_mStreamNames;
 
-	bool CompoundMsiNameToFileName(const wchar_t *name, std::wstring &res);
 };
 
+// Converts compressed MSI stream name from compound file to a readable one
+bool DecodeMsiStreamName(const wchar_t *compoundMsiName, std::wstring &outFileName);
+
 #endif // OleReader_h__
@@ -0,0 +1,216 @@
+// Standalone benchmark for direct MSI table reading (CMsiDatabaseReader).
+// Not part of the module build. Windows only, since it compares results with Windows Installer API.
+//
+// Reads Directory, Component, File and Media tables of the package through CMsiDatabaseReader
+// and through MsiDatabaseOpenView / MsiViewFetch, the way MsiViewer did it before.
+// Every cell is compared and time spent by each method is printed.
+//
+// Build from Visual Studio command prompt, for example:
+//   cl /O2 /EHsc /I.. /I..\..\..\common table_read_bench.cpp msi.lib ole32.lib
+// Usage: table_read_bench <package.msi> [runs]
+
+#include "stdafx.h"
+
+#include <stdio.h>
+#include <chrono>
+
+#include <Msi.h>
+#include <MsiQuery.h>
+
+#include "../CompoundFile.cpp"
+#include "../MsiTables.cpp"
+#include "../OleReader.cpp"
+
+#pragma comment(lib, "msi.lib")
+#pragma comment(lib, "ole32.lib")
+
+static const wchar_t* BenchTables[] = { L"Directory", L"Component", L"File", L"Media" };
+
+// Cell values of one table, strings and integers are kept as text for comparison
+typedef std::vector<std::vector<std::wstring>> TableCells;
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+static std::wstring int_cell(int value)
+{
+	return (value == MSI_NULL_INTEGER) ? std::wstring() : std::to_wstring(value);
+}
+
+static bool read_with_api(const wchar_t* path, std::vector<TableCells> &tables)
+{
+	MSIHANDLE hMsi = 0;
+	if (MsiOpenDatabaseW(path, MSIDBOPEN_READONLY, &hMsi) != ERROR_SUCCESS)
+		return false;
+
+	tables.clear();
+	for (size_t t = 0; t < sizeof(BenchTables) / sizeof(BenchTables[0]); t++)
+	{
+		tables.push_back(TableCells());
+
+		std::wstring strQuery = std::wstring(L"SELECT * FROM `") + BenchTables[t] + L"`";
+		MSIHANDLE hView = 0;
+		if (MsiDatabaseOpenViewW(hMsi, strQuery.c_str(), &hView) != ERROR_SUCCESS)
+			continue;  // Optional table is missing
+		MsiViewExecute(hView, 0);
+
+		// Column types are needed to know which getter to use
+		MSIHANDLE hTypes = 0;
+		MsiViewGetColumnInfo(hView, MSICOLINFO_TYPES, &hTypes);
+		UINT numCols = MsiRecordGetFieldCount(hTypes);
+		std::vector<wchar_t> colKinds(numCols);
+		for (UINT c = 0; c < numCols; c++)
+		{
+			wchar_t typeBuf[16] = {0};
+			DWORD typeSize = _countof(typeBuf);
+			MsiRecordGetStringW(hTypes, c + 1, typeBuf, &typeSize);
+			colKinds[c] = towlower(typeBuf[0]);
+		}
+		MsiCloseHandle(hTypes);
+
+		MSIHANDLE hRec = 0;
+		std::vector<wchar_t> buf(1024);
+		while (MsiViewFetch(hView, &hRec) == ERROR_SUCCESS)
+		{
+			std::vector<std::wstring> row(numCols);
+			for (UINT c = 0; c < numCols; c++)
+			{
+				if (colKinds[c] == 's' || colKinds[c] == 'l' || colKinds[c] == 'g')
+				{
+					DWORD size = (DWORD) buf.size();
+					UINT res = MsiRecordGetStringW(hRec, c + 1, buf.data(), &size);
+					if (res == ERROR_MORE_DATA)
+					{
+						buf.resize(size + 1);
+						size = (DWORD) buf.size();
+						res = MsiRecordGetStringW(hRec, c + 1, buf.data(), &size);
+					}
+					if (res == ERROR_SUCCESS)
+						row[c].assign(buf.data(), size);
+				}
+				else if (colKinds[c] == 'i' || colKinds[c] == 'j')
+				{
+					row[c] = int_cell(MsiRecordGetInteger(hRec, c + 1));
+				}
+			}
+			tables.back().push_back(row);
+			MsiCloseHandle(hRec);
+		}
+		MsiCloseHandle(hView);
+	}
+
+	MsiCloseHandle(hMsi);
+	return true;
+}
+
+static bool read_direct(const wchar_t* path, std::vector<TableCells> &tables)
+{
+	CMsiDatabaseReader reader;
+	if (!reader.Open(path))
+		return false;
+
+	tables.clear();
+	for (size_t t = 0; t < sizeof(BenchTables) / sizeof(BenchTables[0]); t++)
+	{
+		tables.push_back(TableCells());
+
+		CMsiTable table;
+		if (!reader.ReadTable(BenchTables[t], table))
+			continue;
+
+		for (size_t r = 0; r < table.GetRowCount(); r++)
+		{
+			std::vector<std::wstring> row(table.GetColumnCount());
+			for (size_t c = 0; c < table.GetColumnCount(); c++)
+			{
+				// Getter of the wrong kind returns empty value
+				const std::wstring &strVal = table.GetString(r, c);
+				row[c] = strVal.empty() ? int_cell(table.GetInteger(r, c)) : strVal;
+			}
+			tables.back().push_back(row);
+		}
+	}
+
+	return true;
+}
+
+static bool compare_tables(const std::vector<TableCells> &direct, const std::vector<TableCells> &api)
+{
+	bool fResult = true;
+	for (size_t t = 0; t < direct.size(); t++)
+	{
+		const TableCells &d = direct[t];
+		const TableCells &a = api[t];
+		if (d.size() != a.size())
+		{
+			wprintf(L"%s: %d rows via reader, %d rows via API\n", BenchTables[t], (int) d.size(), (int) a.size());
+			fResult = false;
+			continue;
+		}
+
+		for (size_t r = 0; r < d.size(); r++)
+		{
+			if (d[r] != a[r])
+			{
+				wprintf(L"%s: row %d differs (%s / %s)\n", BenchTables[t], (int) r, d[r].empty() ? L"" : d[r][0].c_str(), a[r].empty() ? L"" : a[r][0].c_str());
+				fResult = false;
+				break;
+			}
+		}
+	}
+	return fResult;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 2)
+	{
+		wprintf(L"Usage: %s <package.msi> [runs]\n", argv[0]);
+		return 1;
+	}
+
+	const wchar_t* path = argv[1];
+	int numRuns = (argc > 2) ? _wtoi(argv[2]) : 5;
+	if (numRuns < 1) numRuns = 1;
+
+	std::vector<TableCells> directTables, apiTables;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < numRuns; i++)
+	{
+		if (!read_direct(path, directTables))
+		{
+			wprintf(L"CMsiDatabaseReader can not open package\n");
+			return 1;
+		}
+	}
+	double directTime = seconds_since(start) / numRuns;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < numRuns; i++)
+	{
+		if (!read_with_api(path, apiTables))
+		{
+			wprintf(L"MsiOpenDatabase failed\n");
+			return 1;
+		}
+	}
+	double apiTime = seconds_since(start) / numRuns;
+
+	for (size_t t = 0; t < directTables.size(); t++)
+		wprintf(L"%-10s %d rows\n", BenchTables[t], (int) directTables[t].size());
+	wprintf(L"CMsiDatabaseReader: %.4f sec per run\n", directTime);
+	wprintf(L"MSI API:            %.4f sec per run\n", apiTime);
+
+	if (!compare_tables(directTables, apiTables))
+	{
+		wprintf(L"FAILED: results differ\n");
+		return 1;
+	}
+
+	wprintf(L"Results match\n");
+	return 0;
+}
@@ -43,6 +43,43 @@ static bool TryParseDateTime(const GooString* strDate, FILETIME *fTime)
 
 //////////////////////////////////////////////////////////////////////////
 
+// Walks all objects in xref (including ones packed in object streams) looking for file attachment
+// annotations or more embedded file streams than document level attachments refer to
+static bool HasPageAttachments(PDFDoc* doc, int numDocEmbeddedFiles)
+{
+	XRef* xref = doc->getXRef();
+	int numEmbeddedStreams = 0;
+
+	for (int i = 0; i < xref->getNumObjects(); i++)
+	{
+		XRefEntry* entry = xref->getEntry(i, false);
+		if (!entry || (entry->type == xrefEntryFree) || (entry->type == xrefEntryNone))
+			continue;
+
+		// Generation is ignored for compressed objects
+		Object obj = xref->fetch(i, (entry->type == xrefEntryCompressed) ? 0 : entry->gen);
+
+		Dict* dict = nullptr;
+		if (obj.isDict())
+			dict = obj.getDict();
+		else if (obj.isStream())
+			dict = obj.streamGetDict();
+		if (!dict) continue;
+
+		if (dict->lookupNF("Subtype").isName("FileAttachment"))
+			return true;
+
+		if (obj.isStream() && dict->is("EmbeddedFile"))
+		{
+			numEmbeddedStreams++;
+			if (numEmbeddedStreams > numDocEmbeddedFiles)
+				return true;
+		}
+	}
+
+	return false;
+}
+
 bool PdfInfo::LoadInfo( PDFDoc* doc, bool openAllFiles )
 {
 	Cleanup();
@@ -57,25 +94,7 @@ bool PdfInfo::LoadInfo( PDFDoc* doc, bool openAllFiles )
 		if (file->isOk())
 			m_vFiles.push_back(new PdfEmbeddedFile(file));
 	}
-
-	// Get page attachments
-	int numPages = cat->getNumPages();
-	for (int i = 0; i < numPages; i++)
-	{
-		Page* page = cat->getPage(i + 1);
-		Annots* annots = page->getAnnots();
-		if (!annots) break;
-
-		for (int j = 0; j < annots->getNumAnnots(); j++)
-		{
-			Annot* ant = annots->getAnnot(j);
-			if ((ant->getType() == Annot::typeFileAttachment) && ant->isOk())
-			{
-				FileSpec* spec = new FileSpec(static_cast<AnnotFileAttachment *>(ant)->getFile());
-				m_vFiles.push_back(new PdfEmbeddedFile(spec));
-			}
-		}
-	}
+	m_nAttachmentsPos = m_vFiles.size();
 
 	char scriptNameBuf[MAX_PATH];
 	for (int i = 0; i < cat->numJS(); i++)
@@ -95,16 +114,12 @@ bool PdfInfo::LoadInfo( PDFDoc* doc, bool openAllFiles )
 		}
 	}
 
-	// Generate info
-	if (openAllFiles || m_vFiles.size() > 0)
-	{
-		std::string metadata;
-		LoadMetaData(doc, metadata);
-		m_vFiles.insert(m_vFiles.begin(), new PdfMetadataFile(metadata));
-	}
+	// Page walk is postponed to PrepareFiles, here we only need to know if it will find anything
+	m_fPagesPending = HasPageAttachments(doc, cat->numEmbeddedFiles());
 
-	if (m_vFiles.size() > 0)
+	if (openAllFiles || m_fPagesPending || m_vFiles.size() > 0)
 	{
+		m_fMetadataPending = true;
 		docRef = doc;
 		return true;
 	}
@@ -112,10 +127,57 @@ bool PdfInfo::LoadInfo( PDFDoc* doc, bool openAllFiles )
 	return false;
 }
 
+void PdfInfo::LoadPendingInfo()
+{
+	if (!docRef) return;
+
+	if (m_fPagesPending)
+	{
+		std::vector<PdfPseudoFile*> vAttachments;
+		LoadPageAttachments(docRef, vAttachments);
+		m_vFiles.insert(m_vFiles.begin() + m_nAttachmentsPos, vAttachments.begin(), vAttachments.end());
+		m_fPagesPending = false;
+	}
+
+	if (m_fMetadataPending)
+	{
+		std::string metadata;
+		LoadMetaData(docRef, metadata);
+		m_vFiles.insert(m_vFiles.begin(), new PdfMetadataFile(metadata));
+		m_fMetadataPending = false;
+	}
+}
+
+void PdfInfo::LoadPageAttachments( PDFDoc *doc, std::vector<PdfPseudoFile*> &dest )
+{
+	Catalog* cat = doc->getCatalog();
+	
+	int numPages = cat->getNumPages();
+	for (int i = 0; i < numPages; i++)
+	{
+		Page* page = cat->getPage(i + 1);
+		Annots* annots = page ? page->getAnnots() : nullptr;
+		if (!annots) continue;
+
+		for (int j = 0; j < annots->getNumAnnots(); j++)
+		{
+			Annot* ant = annots->getAnnot(j);
+			if ((ant->getType() == Annot::typeFileAttachment) && ant->isOk())
+			{
+				FileSpec* spec = new FileSpec(static_cast<AnnotFileAttachment *>(ant)->getFile());
+				dest.push_back(new PdfEmbeddedFile(spec));
+			}
+		}
+	}
+}
+
 void PdfInfo::Cleanup()
 {
 	std::for_each(m_vFiles.begin(), m_vFiles.end(), [](PdfPseudoFile* f) { delete f; });
 	m_vFiles.clear();
+	m_fPagesPending = false;
+	m_fMetadataPending = false;
+	m_nAttachmentsPos = 0;
 	
 	if (docRef)
 	{
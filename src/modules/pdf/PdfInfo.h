@@ -78,9 +78,12 @@ public:
 
 struct PdfInfo
 {
-	PdfInfo() : docRef(nullptr) {}
+	PdfInfo() : docRef(nullptr), m_fPagesPending(false), m_fMetadataPending(false), m_nAttachmentsPos(0) {}
 
+	// Quick check used during storage open, heavy parts are left for PrepareFiles
 	bool LoadInfo(PDFDoc* doc, bool openAllFiles);
+	// Reads page attachments and document info if they were not loaded yet
+	void LoadPendingInfo();
 	void Cleanup();
 
 	int GetNumFiles() const { return (int) m_vFiles.size(); }
@@ -89,7 +92,12 @@ struct PdfInfo
 private:
 	PDFDoc* docRef;
 	std::vector<PdfPseudoFile*> m_vFiles;
+
+	bool m_fPagesPending;
+	bool m_fMetadataPending;
+	size_t m_nAttachmentsPos;
 	
+	void LoadPageAttachments(PDFDoc *doc, std::vector<PdfPseudoFile*> &dest);
 	void LoadMetaData(PDFDoc *doc, std::string &output);
 };
 
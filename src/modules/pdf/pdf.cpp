@@ -50,6 +50,10 @@ void MODULE_EXPORT CloseStorage(HANDLE storage)
 
 int MODULE_EXPORT PrepareFiles(HANDLE storage)
 {
+	PdfInfo* pData = (PdfInfo*) storage;
+	if (pData == nullptr) return FALSE;
+
+	pData->LoadPendingInfo();
 	return TRUE;
 }
 
@@ -0,0 +1,63 @@
+#ifndef NameIndex_h__
+#define NameIndex_h__
+
+#include <string>
+#include <unordered_set>
+#include <unordered_map>
+
+static inline std::wstring GetDefaultBaseName(int noNameCounter)
+{
+	wchar_t buf[50] = {0};
+	swprintf_s(buf, sizeof(buf) / sizeof(buf[0]), L"Message%05d", noNameCounter);
+	return buf;
+}
+
+static inline std::wstring GetDupTestFilename(const std::wstring &baseName, int dupCounter, int &noNameCounter)
+{
+	wchar_t testName[MAX_PATH] = {0};
+	if (dupCounter > 0)
+		swprintf_s(testName, MAX_PATH, L"%ls[%d].eml", baseName.c_str(), dupCounter);
+	else
+		swprintf_s(testName, MAX_PATH, L"%ls.eml", baseName.c_str());
+
+	// Some times swprintf_s can fail if baseName contains garbage
+	if (!*testName)
+		return GetDefaultBaseName(++noNameCounter) + L".eml";
+
+	return testName;
+}
+
+// Names already taken inside one folder, used to resolve duplicates during listing
+struct FolderNameIndex
+{
+	std::unordered_set<std::wstring> UsedNames;
+	std::unordered_map<std::wstring, int> NextDupCounter;
+
+	// Folder names are used as is
+	void AddFolderName(const std::wstring &name)
+	{
+		UsedNames.insert(name);
+	}
+
+	// Returns first free name from "<base>.eml", "<base>[1].eml", ... and marks it as used
+	std::wstring AddMessageName(const std::wstring &baseName, int &noNameCounter)
+	{
+		int &nextDupCounter = NextDupCounter[baseName];
+
+		// All lower counters for this base name are already taken.
+		// Set of used names is finite, so this loop always ends.
+		int dupCounter = nextDupCounter;
+		std::wstring strFileName = GetDupTestFilename(baseName, dupCounter, noNameCounter);
+		while (UsedNames.count(strFileName) > 0)
+		{
+			dupCounter++;
+			strFileName = GetDupTestFilename(baseName, dupCounter, noNameCounter);
+		}
+		nextDupCounter = dupCounter + 1;
+		UsedNames.insert(strFileName);
+
+		return strFileName;
+	}
+};
+
+#endif // NameIndex_h__
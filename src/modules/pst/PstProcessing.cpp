@@ -18,28 +18,6 @@ static void RenameInvalidPathChars(wstring& input)
 	}
 }
 
-static std::wstring GetDefaultBaseName(int noNameCounter)
-{
-	wchar_t buf[50] = {0};
-	swprintf_s(buf, sizeof(buf) / sizeof(buf[0]), L"Message%05d", noNameCounter);
-	return buf;
-}
-
-static wstring GetDupTestFilename(wstring &baseName, int dupCounter, int &noNameCounter)
-{
-	wchar_t testName[MAX_PATH] = {0};
-	if (dupCounter > 0)
-		swprintf_s(testName, MAX_PATH, L"%s[%d].eml", baseName.c_str(), dupCounter);
-	else
-		swprintf_s(testName, MAX_PATH, L"%s.eml", baseName.c_str());
-
-	// Some times swprintf_s can fail if baseName contains garbage
-	if (!*testName)
-		return GetDefaultBaseName(++noNameCounter) + L".eml";
-
-	return testName;
-}
-
 bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &parentPath, int &NoNameCounter)
 {
 	try {
@@ -61,6 +39,8 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 		else if (msgPropBag.prop_exists(PropMessageSenderEmailAddress))
 			emlSender = msgPropBag.read_prop<std::wstring>(PropMessageSenderEmailAddress);
 
+		std::shared_ptr<message> msgPtr = std::make_shared<message>(m);
+
 		// Create entry for message itself (file or folder depending on options)
 		{
 			wstring strBaseFileName;
@@ -76,37 +56,18 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 			}
 			RenameInvalidPathChars(strBaseFileName);
 
-			int dupCounter = 0;
-			wstring strFileName;
-			// To avoid any potential infinite loops lets limit dup counter
-			while (dupCounter < 10000)
-			{
-				bool dupFound = false;
-				strFileName = GetDupTestFilename(strBaseFileName, dupCounter, NoNameCounter);
-				for (auto it = fileInfoObj->Entries.cbegin(); it != fileInfoObj->Entries.cend(); it++)
-				{
-					const PstFileEntry& prevEntry = *it;
-					if ((prevEntry.Type == ETYPE_FOLDER || prevEntry.Type == ETYPE_EML) && (prevEntry.Name == strFileName) && (prevEntry.Folder == parentPath))
-					{
-						dupFound = true;
-						break;
-					}
-				}
-				if (!dupFound) break;
-				
-				dupCounter++;
-			}
+			wstring strFileName = fileInfoObj->NameIndex[parentPath].AddMessageName(strBaseFileName, NoNameCounter);
 
 			PstFileEntry fentry;
 			fentry.Type = fileInfoObj->ExpandEmlFile ? ETYPE_FOLDER : ETYPE_EML;
 			fentry.Name = strFileName;
 			fentry.Folder = parentPath;
-			fentry.msgRef = new message(m);
+			fentry.msgRef = msgPtr;
 			fentry.CreationTime = ftCreated;
 			fentry.LastModificationTime = ftModified;
 			fentry.Sender = emlSender;
 
-			fileInfoObj->Entries.push_back(fentry);
+			fileInfoObj->Entries.push_back(std::move(fentry));
 
 			emlDirPath = parentPath;
 			if (emlDirPath.length() > 0)
@@ -123,12 +84,12 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 				fentry.Type = ETYPE_MESSAGE_BODY;
 				fentry.Name = L"{Message}.txt";
 				fentry.Folder = emlDirPath;
-				fentry.msgRef = new message(m);
+				fentry.msgRef = msgPtr;
 				fentry.CreationTime = ftCreated;
 				fentry.LastModificationTime = ftModified;
 				fentry.Sender = emlSender;
 
-				fileInfoObj->Entries.push_back(fentry);
+				fileInfoObj->Entries.push_back(std::move(fentry));
 			}
 
 			if (m.has_html_body())
@@ -137,12 +98,12 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 				fentry.Type = ETYPE_MESSAGE_HTML;
 				fentry.Name = L"{Message}.html";
 				fentry.Folder = emlDirPath;
-				fentry.msgRef = new message(m);
+				fentry.msgRef = msgPtr;
 				fentry.CreationTime = ftCreated;
 				fentry.LastModificationTime = ftModified;
 				fentry.Sender = emlSender;
 
-				fileInfoObj->Entries.push_back(fentry);
+				fileInfoObj->Entries.push_back(std::move(fentry));
 			}
 
 			if (m.has_compressed_rtf_body())
@@ -151,12 +112,12 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 				fentry.Type = ETYPE_MESSAGE_RTF;
 				fentry.Name = L"{Message}.rtf";
 				fentry.Folder = emlDirPath;
-				fentry.msgRef = new message(m);
+				fentry.msgRef = msgPtr;
 				fentry.CreationTime = ftCreated;
 				fentry.LastModificationTime = ftModified;
 				fentry.Sender = emlSender;
 
-				fileInfoObj->Entries.push_back(fentry);
+				fileInfoObj->Entries.push_back(std::move(fentry));
 			}
 
 			// Fake file with mail headers
@@ -166,12 +127,12 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 				fentry.Type = ETYPE_HEADER;
 				fentry.Name = L"{Msg-Header}.txt";
 				fentry.Folder = emlDirPath;
-				fentry.msgRef = new message(m);
+				fentry.msgRef = msgPtr;
 				fentry.CreationTime = ftCreated;
 				fentry.LastModificationTime = ftModified;
 				fentry.Sender = emlSender;
 
-				fileInfoObj->Entries.push_back(fentry);
+				fileInfoObj->Entries.push_back(std::move(fentry));
 			}
 
 			// Fake file with list of message properties
@@ -182,9 +143,9 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 				fentry.Name = L"{Msg-Properties}.txt";
 				fentry.FullPath = strSubPath + fentry.Name;
 				fentry.Size = 0;
-				fentry.msgRef = new message(m);
+				fentry.msgRef = msgPtr;
 
-				fileInfoObj->Entries.push_back(fentry);
+				fileInfoObj->Entries.push_back(std::move(fentry));
 			}
 			*/
 
@@ -206,13 +167,13 @@ bool process_message(const message& m, PstFileInfo *fileInfoObj, const wstring &
 						fentry.Name = L"noname.dat";
 					}
 					fentry.Folder = emlDirPath;
-					fentry.msgRef = new message(m);
-					fentry.attachRef = new attachment(attach);
+					fentry.msgRef = msgPtr;
+					fentry.attachRef = std::make_shared<attachment>(attach);
 					fentry.CreationTime = ftCreated;
 					fentry.LastModificationTime = ftModified;
 					fentry.Sender = emlSender;
 
-					fileInfoObj->Entries.push_back(fentry);
+					fileInfoObj->Entries.push_back(std::move(fentry));
 				} // for
 		}
 
@@ -249,9 +210,16 @@ bool process_folder(const folder& f, PstFileInfo *fileInfoObj, const wstring &pa
 		entry.Name = strFolderName;
 		entry.Folder = parentPath;
 
-		fileInfoObj->Entries.push_back(entry);
+		fileInfoObj->NameIndex[parentPath].AddFolderName(strFolderName);
+		fileInfoObj->Entries.push_back(std::move(entry));
 	}
 
+	// Every message produces at least one entry, grow storage once per folder
+	std::vector<PstFileEntry> &vEntries = fileInfoObj->Entries;
+	size_t nRequired = vEntries.size() + nMCount + 1;
+	if (nRequired > vEntries.capacity())
+		vEntries.reserve((nRequired > vEntries.capacity() * 2) ? nRequired : vEntries.capacity() * 2);
+
 	int nNoNameCnt = 0;
 	for(auto iter = f.message_begin(); iter != f.message_end(); iter++)
 	{
@@ -270,6 +238,243 @@ bool process_folder(const folder& f, PstFileInfo *fileInfoObj, const wstring &pa
 	return true;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Parallel listing
+
+// Do not bother with threads for small mailboxes
+#define PARALLEL_LISTING_MIN_MESSAGES 1000
+
+// Contents of one folder, processed as single unit of work
+struct FolderTask
+{
+	node_id FolderId;
+	std::wstring Name;
+	std::wstring ParentPath;
+	std::wstring SubPath;
+
+	std::vector<PstFileEntry> Entries;
+};
+
+// Steps that touch name index of one path, in the order serial listing would do them
+struct FolderGroupEvent
+{
+	size_t TaskIndex;
+	bool IsNameReservation;
+};
+
+// All tasks which share one name index are processed by the same thread
+struct FolderTaskGroup
+{
+	std::vector<FolderGroupEvent> Events;
+};
+
+struct FolderTaskList
+{
+	std::vector<FolderTask> Tasks;
+	std::vector<FolderTaskGroup> Groups;
+	std::unordered_map<std::wstring, size_t> GroupIndex;
+	size_t TotalMessages;
+
+	FolderTaskList() : TotalMessages(0) {}
+
+	void AddEvent(const std::wstring &path, size_t taskIndex, bool isNameReservation)
+	{
+		auto it = GroupIndex.find(path);
+		if (it == GroupIndex.end())
+		{
+			it = GroupIndex.insert(std::make_pair(path, Groups.size())).first;
+			Groups.push_back(FolderTaskGroup());
+		}
+		FolderGroupEvent ev = { taskIndex, isNameReservation };
+		Groups[it->second].Events.push_back(ev);
+	}
+};
+
+// Walks folders in the same order as process_folder, without reading messages
+static void collect_folder_tasks(const folder& f, bool hideEmptyFolders, const wstring &parentPath, FolderTaskList &taskList)
+{
+	size_t nMCount = f.get_message_count();
+
+	if (hideEmptyFolders && (nMCount == 0) && (f.sub_folder_begin() == f.sub_folder_end()))
+		return;
+
+	FolderTask task;
+	task.FolderId = f.get_id();
+	task.Name = f.get_name();
+	task.ParentPath = parentPath;
+	task.SubPath = parentPath;
+
+	RenameInvalidPathChars(task.Name);
+
+	size_t nTaskIndex = taskList.Tasks.size();
+	if (task.Name.length() > 0)
+	{
+		if (task.SubPath.length() > 0)
+			task.SubPath.append(L"\\");
+		task.SubPath.append(task.Name);
+
+		taskList.AddEvent(parentPath, nTaskIndex, true);
+	}
+	taskList.AddEvent(task.SubPath, nTaskIndex, false);
+	taskList.TotalMessages += nMCount;
+
+	wstring strSubPath = task.SubPath;
+	taskList.Tasks.push_back(std::move(task));
+
+	for(auto iter = f.sub_folder_begin(); iter != f.sub_folder_end(); iter++)
+	{
+		collect_folder_tasks(*iter, hideEmptyFolders, strSubPath, taskList);
+	}
+}
+
+static void process_task_groups(PstFileInfo *fileInfoObj, FolderTaskList *taskList, std::atomic<size_t> *nextGroup, std::atomic<bool> *failed)
+{
+	try
+	{
+		pst localPst(fileInfoObj->FilePath);
+
+		PstFileInfo localInfo(NULL);
+		localInfo.ExpandEmlFile = fileInfoObj->ExpandEmlFile;
+
+		while (!*failed)
+		{
+			size_t nGroup = (*nextGroup)++;
+			if (nGroup >= taskList->Groups.size()) break;
+
+			localInfo.NameIndex.clear();
+
+			const FolderTaskGroup &group = taskList->Groups[nGroup];
+			for (auto evIter = group.Events.begin(); evIter != group.Events.end(); evIter++)
+			{
+				FolderTask &task = taskList->Tasks[evIter->TaskIndex];
+				if (evIter->IsNameReservation)
+				{
+					localInfo.NameIndex[task.ParentPath].AddFolderName(task.Name);
+					continue;
+				}
+
+				folder f = localPst.open_folder(task.FolderId);
+				localInfo.Entries.reserve(f.get_message_count());
+
+				int nNoNameCnt = 0;
+				for(auto iter = f.message_begin(); iter != f.message_end(); iter++)
+				{
+					if (!process_message(*iter, &localInfo, task.SubPath, nNoNameCnt))
+					{
+						*failed = true;
+						return;
+					}
+				}
+
+				task.Entries.swap(localInfo.Entries);
+			}
+		}
+	}
+	catch (...)
+	{
+		*failed = true;
+	}
+}
+
+// Entries made by worker point into its own copy of the database.
+// Reopen them through the main one, so worker file handle and block cache are freed.
+static void rebind_task_entries(std::vector<PstFileEntry> &entries, const pst *mainPst)
+{
+	std::shared_ptr<message> srcMsg;
+	std::shared_ptr<message> destMsg;
+
+	for (auto iter = entries.begin(); iter != entries.end(); iter++)
+	{
+		PstFileEntry &entry = *iter;
+		if (!entry.msgRef) continue;
+
+		// Entries of one message always follow each other
+		if (entry.msgRef != srcMsg)
+		{
+			srcMsg = entry.msgRef;
+			destMsg = std::make_shared<message>(mainPst->open_message(srcMsg->get_id()));
+		}
+
+		if (entry.attachRef)
+		{
+			node_id attachId = entry.attachRef->get_property_bag().get_node().get_id();
+			entry.attachRef.reset();
+			for (auto att_iter = destMsg->attachment_begin(); att_iter != destMsg->attachment_end(); att_iter++)
+			{
+				const attachment &attach = *att_iter;
+				if (attach.get_property_bag().get_node().get_id() == attachId)
+				{
+					entry.attachRef = std::make_shared<attachment>(attach);
+					break;
+				}
+			}
+		}
+		entry.msgRef = destMsg;
+	}
+}
+
+bool process_folder_parallel(const folder& root, PstFileInfo *fileInfoObj)
+{
+	FolderTaskList taskList;
+	collect_folder_tasks(root, fileInfoObj->HideEmptyFolders, L"", taskList);
+
+	size_t nThreads = fileInfoObj->ListingThreads;
+	if (nThreads > taskList.Groups.size())
+		nThreads = taskList.Groups.size();
+
+	if ((nThreads < 2) || (taskList.TotalMessages < PARALLEL_LISTING_MIN_MESSAGES))
+		return process_folder(root, fileInfoObj, L"");
+
+	std::atomic<size_t> nextGroup(0);
+	std::atomic<bool> failed(false);
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < nThreads; i++)
+		workers.push_back(std::thread(process_task_groups, fileInfoObj, &taskList, &nextGroup, &failed));
+	for (auto iter = workers.begin(); iter != workers.end(); iter++)
+		iter->join();
+
+	if (failed)
+		return false;
+
+	try
+	{
+		for (auto iter = taskList.Tasks.begin(); iter != taskList.Tasks.end(); iter++)
+			rebind_task_entries(iter->Entries, fileInfoObj->PstObject);
+	}
+	catch (...)
+	{
+		return false;
+	}
+
+	// Merge results in the folder walk order, so list is identical to serial one
+	size_t nTotalEntries = fileInfoObj->Entries.size();
+	for (auto iter = taskList.Tasks.begin(); iter != taskList.Tasks.end(); iter++)
+		nTotalEntries += iter->Entries.size() + 1;
+	fileInfoObj->Entries.reserve(nTotalEntries);
+
+	for (auto iter = taskList.Tasks.begin(); iter != taskList.Tasks.end(); iter++)
+	{
+		if (iter->Name.length() > 0)
+		{
+			PstFileEntry entry;
+			entry.Type = ETYPE_FOLDER;
+			entry.Name = iter->Name;
+			entry.Folder = iter->ParentPath;
+
+			fileInfoObj->Entries.push_back(std::move(entry));
+		}
+
+		for (auto entIter = iter->Entries.begin(); entIter != iter->Entries.end(); entIter++)
+			fileInfoObj->Entries.push_back(std::move(*entIter));
+		iter->Entries.clear();
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 static ExtractResult dump_stream(hnid_stream_device &input, HANDLE output)
 {
 	prop_stream nstream(input);
@@ -1,6 +1,8 @@
 #ifndef PstProcessing_h__
 #define PstProcessing_h__
 
+#include "NameIndex.h"
+
 using namespace pstsdk;
 
 const uint16_t UTF16_BOM = 0xFEFF;
@@ -34,36 +36,17 @@ struct PstFileEntry
 	FILETIME LastModificationTime;
 	std::wstring Sender;
 
-	message *msgRef;
-	attachment *attachRef;
+	// Parts of the same message share one pstsdk object
+	std::shared_ptr<message> msgRef;
+	std::shared_ptr<attachment> attachRef;
 
 	PstFileEntry()
 	{
 		Type = ETYPE_UNKNOWN;
-		msgRef = NULL;
-		attachRef = NULL;
 		memset(&CreationTime, 0, sizeof(CreationTime));
 		memset(&LastModificationTime, 0, sizeof(LastModificationTime));
 	}
 
-	PstFileEntry(const PstFileEntry &other)
-	{
-		Type = other.Type;
-		Name = other.Name;
-		Folder = other.Folder;
-		msgRef = other.msgRef ? new message(*other.msgRef) : NULL;
-		attachRef = other.attachRef ? new attachment(*other.attachRef) : NULL;
-		CreationTime = other.CreationTime;
-		LastModificationTime = other.LastModificationTime;
-		Sender = other.Sender;
-	}
-
-	~PstFileEntry()
-	{
-		if (msgRef) delete msgRef;
-		if (attachRef) delete attachRef;
-	}
-
 	std::wstring GetFullPath() const
 	{
 		if (Folder.size() > 0)
@@ -86,18 +69,25 @@ private:
 struct PstFileInfo
 {
 	pst* PstObject;
+	std::wstring FilePath;
 	std::vector<PstFileEntry> Entries;
+	std::unordered_map<std::wstring, FolderNameIndex> NameIndex;
 
 	bool HideEmptyFolders;
 	bool ExpandEmlFile;
+	int ListingThreads;
 
-	PstFileInfo(pst *obj) : PstObject(obj), HideEmptyFolders(false), ExpandEmlFile(true) {}
+	PstFileInfo(pst *obj) : PstObject(obj), HideEmptyFolders(false), ExpandEmlFile(true), ListingThreads(1) {}
 	~PstFileInfo() { Entries.clear(); delete PstObject; }
 };
 
-bool process_message(const message& m, PstFileInfo *fileInfoObj, const std::wstring &parentPath);
+bool process_message(const message& m, PstFileInfo *fileInfoObj, const std::wstring &parentPath, int &NoNameCounter);
 bool process_folder(const folder& f, PstFileInfo *fileInfoObj, const std::wstring &parentPath);
 
+// Builds same list as process_folder, but reads folders on several threads.
+// Each thread opens own copy of the database from fileInfoObj->FilePath.
+bool process_folder_parallel(const folder& root, PstFileInfo *fileInfoObj);
+
 std::wstring DumpMessageProperties(const PstFileEntry &entry);
 
 #endif // PstProcessing_h__
\ No newline at end of file
@@ -0,0 +1,659 @@
+// Standalone benchmark for duplicate message name resolution (FolderNameIndex).
+// Not part of the module build.
+//
+// Writes synthetic unicode PST with one folder full of messages that share few subjects,
+// lists it with pstsdk and picks file names with FolderNameIndex, the way pst module does it.
+// Same names are then picked with old algorithm (scan of all listed entries per candidate)
+// and both results are compared.
+//
+// Build with bundled pstsdk, for example:
+//   g++ -std=c++11 -O2 -I../../../depends dup_names_bench.cpp
+// Usage: dup_names_bench <work dir> [messages] [subjects] [skip old algorithm above N messages]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#ifndef _WIN32
+#define CP_ACP 0
+#define MAX_PATH 260
+#define swprintf_s swprintf
+#endif
+
+#include "pstsdk/pst.h"
+#include "../NameIndex.h"
+
+#ifndef _WIN32
+// Non-Windows part of pstsdk does not provide codepage conversion, subjects here are unicode anyway
+std::wstring pstsdk::string_to_wstring(const std::string& str, unsigned int)
+{
+	return std::wstring(str.begin(), str.end());
+}
+#endif
+
+using namespace pstsdk;
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Minimal PST writer, produces only structures that listing reads
+
+const prop_id PidTagDisplayName = 0x3001;
+const prop_id PidTagContentCount = 0x3602;
+const prop_id PidTagContentUnreadCount = 0x3603;
+const prop_id PidTagSubject = 0x0037;
+const prop_id PidTagLtpRowId = 0x67F2;
+const prop_id PidTagLtpRowVer = 0x67F3;
+
+const node_id nidInbox = make_nid(nid_type_folder, 0x400);
+const node_id nidRowMatrix = make_nid(nid_type_ltp, 0x1);
+
+static node_id message_nid(int index)
+{
+	return make_nid(nid_type_message, 0x10000 + index);
+}
+
+struct PropValue
+{
+	prop_id Id;
+	ushort Type;
+	pstsdk::ulong Value;                // Fixed size value
+	std::vector<byte> Data;     // Variable size value, stored in the heap
+};
+
+class PstWriter
+{
+public:
+	PstWriter() : m_data(disk::first_amap_page_location + disk::page_size, 0), m_nextBid(4), m_nextPid(1) {}
+
+	// Returns external block id
+	block_id AddBlock(const std::vector<byte> &data)
+	{
+		return AddBlock(data, false);
+	}
+
+	block_id AddBlock(const std::vector<byte> &data, bool isInternal)
+	{
+		block_id bid = m_nextBid + (isInternal ? disk::block_id_internal_bit : 0);
+		m_nextBid += 4;
+
+		Align(64);
+		ulonglong address = m_data.size();
+		size_t alignedSize = disk::align_disk<ulonglong>(data.size());
+		m_data.resize(address + alignedSize, 0);
+		memcpy(&m_data[address], data.data(), data.size());
+
+		disk::block_trailer<ulonglong>* bt = (disk::block_trailer<ulonglong>*) &m_data[address + alignedSize - sizeof(disk::block_trailer<ulonglong>)];
+		bt->cb = (ushort) data.size();
+		bt->signature = disk::compute_signature<ulonglong>(bid, address);
+		bt->crc = disk::compute_crc(data.data(), (pstsdk::ulong) data.size());
+		bt->bid = bid;
+
+		disk::bbt_leaf_entry<ulonglong> entry = {};
+		entry.ref.bid = bid;
+		entry.ref.ib = address;
+		entry.size = (ushort) data.size();
+		entry.ref_count = 2;
+		m_blocks.push_back(entry);
+
+		return bid;
+	}
+
+	// Data longer than one block is split and referenced by extended block
+	block_id AddData(const std::vector<byte> &data, size_t blockSize)
+	{
+		if (data.size() <= blockSize)
+			return AddBlock(data);
+
+		std::vector<block_id> children;
+		for (size_t pos = 0; pos < data.size(); pos += blockSize)
+		{
+			size_t partSize = std::min(blockSize, data.size() - pos);
+			children.push_back(AddBlock(std::vector<byte>(data.begin() + pos, data.begin() + pos + partSize)));
+		}
+
+		std::vector<byte> xblock(8 + children.size() * sizeof(block_id), 0);
+		disk::extended_block<ulonglong>* pxb = (disk::extended_block<ulonglong>*) &xblock[0];
+		pxb->block_type = disk::block_type_extended;
+		pxb->level = 1;
+		pxb->count = (ushort) children.size();
+		pxb->total_size = (pstsdk::ulong) data.size();
+		memcpy(pxb->bid, children.data(), children.size() * sizeof(block_id));
+
+		return AddBlock(xblock, true);
+	}
+
+	void AddNode(node_id nid, block_id dataBid, block_id subBid, node_id parentNid)
+	{
+		disk::nbt_leaf_entry<ulonglong> entry = {};
+		entry.nid = nid;
+		entry.data = dataBid;
+		entry.sub = subBid;
+		entry.parent_nid = parentNid;
+		m_nodes.push_back(entry);
+	}
+
+	bool Save(const char* path)
+	{
+		std::sort(m_nodes.begin(), m_nodes.end(), [](const disk::nbt_leaf_entry<ulonglong> &a, const disk::nbt_leaf_entry<ulonglong> &b) { return a.nid < b.nid; });
+		std::sort(m_blocks.begin(), m_blocks.end(), [](const disk::bbt_leaf_entry<ulonglong> &a, const disk::bbt_leaf_entry<ulonglong> &b) { return a.ref.bid < b.ref.bid; });
+
+		std::vector<disk::bt_entry<ulonglong> > nbtLeaves = WriteLeafPages<disk::nbt_leaf_page<ulonglong> >(m_nodes, disk::page_type_nbt, [](const disk::nbt_leaf_entry<ulonglong> &e) { return e.nid; });
+		disk::block_reference<ulonglong> nbtRoot = WriteUpperPages<disk::nbt_nonleaf_page<ulonglong> >(nbtLeaves, disk::page_type_nbt);
+
+		std::vector<disk::bt_entry<ulonglong> > bbtLeaves = WriteLeafPages<disk::bbt_leaf_page<ulonglong> >(m_blocks, disk::page_type_bbt, [](const disk::bbt_leaf_entry<ulonglong> &e) { return e.ref.bid; });
+		disk::block_reference<ulonglong> bbtRoot = WriteUpperPages<disk::bbt_nonleaf_page<ulonglong> >(bbtLeaves, disk::page_type_bbt);
+
+		disk::header<ulonglong> header;
+		memset(&header, 0, sizeof(header));
+		header.dwMagic = disk::hlmagic;
+		header.wMagicClient = disk::pst_magic;
+		header.wVer = disk::database_format_unicode;
+		header.wVerClient = disk::database_pst;
+		header.bPlatformCreate = 1;
+		header.bPlatformAccess = 1;
+		header.bidNextP = m_nextPid;
+		header.root_info.ibFileEof = m_data.size();
+		header.root_info.brefNBT = nbtRoot;
+		header.root_info.brefBBT = bbtRoot;
+		header.bSentinel = 0x80;
+		header.bCryptMethod = disk::crypt_method_none;
+		memcpy(&header.bidNextB, &m_nextBid, sizeof(header.bidNextB));
+		header.dwCRCPartial = disk::compute_crc(((byte*)&header) + disk::header_crc_locations<ulonglong>::partial_start, disk::header_crc_locations<ulonglong>::partial_length);
+		header.dwCRCFull = disk::compute_crc(((byte*)&header) + disk::header_crc_locations<ulonglong>::full_start, disk::header_crc_locations<ulonglong>::full_length);
+		memcpy(&m_data[0], &header, sizeof(header));
+
+		FILE* f = fopen(path, "wb");
+		if (!f) return false;
+		bool fResult = fwrite(m_data.data(), 1, m_data.size(), f) == m_data.size();
+		fclose(f);
+		return fResult;
+	}
+
+private:
+	std::vector<byte> m_data;
+	std::vector<disk::nbt_leaf_entry<ulonglong> > m_nodes;
+	std::vector<disk::bbt_leaf_entry<ulonglong> > m_blocks;
+	ulonglong m_nextBid;
+	ulonglong m_nextPid;
+
+	void Align(size_t alignment)
+	{
+		size_t rem = (m_data.size() - disk::first_amap_page_location) % alignment;
+		if (rem > 0) m_data.resize(m_data.size() + alignment - rem, 0);
+	}
+
+	template<typename PageType>
+	disk::block_reference<ulonglong> WritePage(const PageType &page)
+	{
+		Align(disk::page_size);
+		disk::block_reference<ulonglong> ref;
+		ref.bid = m_nextPid++;
+		ref.ib = m_data.size();
+
+		PageType copy = page;
+		copy.trailer.page_type_repeat = copy.trailer.page_type;
+		copy.trailer.bid = ref.bid;
+		copy.trailer.signature = disk::compute_signature<ulonglong>(ref.bid, ref.ib);
+		copy.trailer.crc = disk::compute_crc(&copy, disk::page<ulonglong>::page_data_size);
+
+		m_data.resize(m_data.size() + sizeof(copy));
+		memcpy(&m_data[(size_t) ref.ib], &copy, sizeof(copy));
+		return ref;
+	}
+
+	template<typename PageType, typename EntryType, typename KeyFunc>
+	std::vector<disk::bt_entry<ulonglong> > WriteLeafPages(const std::vector<EntryType> &entries, byte pageType, KeyFunc keyOf)
+	{
+		std::vector<disk::bt_entry<ulonglong> > result;
+		for (size_t start = 0; start < entries.size(); start += PageType::max_entries)
+		{
+			PageType page;
+			memset(&page, 0, sizeof(page));
+			page.num_entries = (byte) std::min(PageType::max_entries, entries.size() - start);
+			page.num_entries_max = (byte) PageType::max_entries;
+			page.entry_size = (byte) sizeof(EntryType);
+			page.level = 0;
+			page.trailer.page_type = pageType;
+			memcpy(page.entries, &entries[start], page.num_entries * sizeof(EntryType));
+
+			disk::bt_entry<ulonglong> ref;
+			ref.key = keyOf(entries[start]);
+			ref.ref = WritePage(page);
+			result.push_back(ref);
+		}
+		return result;
+	}
+
+	template<typename PageType>
+	disk::block_reference<ulonglong> WriteUpperPages(std::vector<disk::bt_entry<ulonglong> > level, byte pageType)
+	{
+		for (byte levelNum = 1; level.size() > 1; levelNum++)
+		{
+			std::vector<disk::bt_entry<ulonglong> > upper;
+			for (size_t start = 0; start < level.size(); start += PageType::max_entries)
+			{
+				PageType page;
+				memset(&page, 0, sizeof(page));
+				page.num_entries = (byte) std::min(PageType::max_entries, level.size() - start);
+				page.num_entries_max = (byte) PageType::max_entries;
+				page.entry_size = (byte) sizeof(disk::bt_entry<ulonglong>);
+				page.level = levelNum;
+				page.trailer.page_type = pageType;
+				memcpy(page.entries, &level[start], page.num_entries * sizeof(disk::bt_entry<ulonglong>));
+
+				disk::bt_entry<ulonglong> ref;
+				ref.key = level[start].key;
+				ref.ref = WritePage(page);
+				upper.push_back(ref);
+			}
+			level.swap(upper);
+		}
+		return level[0].ref;
+	}
+};
+
+// Heap-on-node with all allocations in one block
+static std::vector<byte> build_heap(byte clientSig, const std::vector<std::vector<byte> > &allocs)
+{
+	std::vector<byte> heap(sizeof(disk::heap_first_header), 0);
+	std::vector<ushort> offsets;
+	for (size_t i = 0; i < allocs.size(); i++)
+	{
+		offsets.push_back((ushort) heap.size());
+		heap.insert(heap.end(), allocs[i].begin(), allocs[i].end());
+		if (heap.size() % 2) heap.push_back(0);
+	}
+	offsets.push_back((ushort) heap.size());
+
+	disk::heap_first_header* pfh = (disk::heap_first_header*) &heap[0];
+	pfh->page_map_offset = (ushort) heap.size();
+	pfh->signature = disk::heap_signature;
+	pfh->client_signature = clientSig;
+	pfh->root_id = make_heap_id(0, 0);
+
+	ushort counts[2] = { (ushort) allocs.size(), 0 };
+	heap.insert(heap.end(), (byte*) counts, (byte*) counts + sizeof(counts));
+	heap.insert(heap.end(), (byte*) offsets.data(), (byte*) (offsets.data() + offsets.size()));
+	return heap;
+}
+
+template<typename T>
+static std::vector<byte> to_bytes(const T &value)
+{
+	return std::vector<byte>((const byte*) &value, (const byte*) &value + sizeof(value));
+}
+
+static std::vector<byte> utf16_bytes(const std::string &str)
+{
+	std::vector<byte> result;
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		result.push_back((byte) str[i]);
+		result.push_back(0);
+	}
+	return result;
+}
+
+static PropValue make_string_prop(prop_id id, const std::string &value)
+{
+	PropValue prop = { id, prop_type_wstring, 0, utf16_bytes(value) };
+	return prop;
+}
+
+static PropValue make_long_prop(prop_id id, pstsdk::ulong value)
+{
+	PropValue prop = { id, prop_type_long, value, std::vector<byte>() };
+	return prop;
+}
+
+// Property context: BTH header, BTH leaf with prop_entry values, variable size data
+static std::vector<byte> build_property_context(std::vector<PropValue> props)
+{
+	std::sort(props.begin(), props.end(), [](const PropValue &a, const PropValue &b) { return a.Id < b.Id; });
+
+	std::vector<std::vector<byte> > allocs(2);
+	for (size_t i = 0; i < props.size(); i++)
+	{
+		disk::bth_leaf_entry<ushort, disk::prop_entry> entry;
+		entry.key = props[i].Id;
+		entry.value.type = props[i].Type;
+		entry.value.id = props[i].Value;
+		if (props[i].Type == prop_type_wstring)
+		{
+			entry.value.id = make_heap_id(0, (pstsdk::ulong) allocs.size());
+			allocs.push_back(props[i].Data);
+		}
+		std::vector<byte> entryBytes = to_bytes(entry);
+		allocs[1].insert(allocs[1].end(), entryBytes.begin(), entryBytes.end());
+	}
+
+	disk::bth_header bth = { disk::heap_sig_bth, sizeof(ushort), sizeof(disk::prop_entry), 0, props.empty() ? 0 : make_heap_id(0, 1) };
+	allocs[0] = to_bytes(bth);
+	return build_heap(disk::heap_sig_pc, allocs);
+}
+
+// Table context with row id and row version columns.
+// Returns heap for node data, big row matrix goes to separate block referenced by subnode block.
+static std::vector<byte> build_table_context(PstWriter &writer, const std::vector<node_id> &rows, block_id &subBid)
+{
+	const ushort cbRow = 9;   // Row id, row version, 1 byte existence bitmap
+
+	std::vector<byte> matrix(rows.size() * cbRow, 0);
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		memcpy(&matrix[i * cbRow], &rows[i], sizeof(node_id));
+		matrix[i * cbRow + 8] = 0xC0;
+	}
+
+	std::vector<byte> tcHeader(sizeof(disk::tc_header) - sizeof(disk::column_description) + 2 * sizeof(disk::column_description), 0);
+	disk::tc_header* ptc = (disk::tc_header*) &tcHeader[0];
+	ptc->signature = disk::heap_sig_tc;
+	ptc->num_columns = 2;
+	ptc->size_offsets[disk::tc_offsets_four] = 8;
+	ptc->size_offsets[disk::tc_offsets_two] = 8;
+	ptc->size_offsets[disk::tc_offsets_one] = 8;
+	ptc->size_offsets[disk::tc_offsets_bitmap] = cbRow;
+	ptc->row_btree_id = make_heap_id(0, 1);
+
+	disk::column_description colRowId = { prop_type_long, PidTagLtpRowId, 0, 4, 0 };
+	disk::column_description colRowVer = { prop_type_long, PidTagLtpRowVer, 4, 4, 1 };
+	ptc->columns[0] = colRowId;
+	ptc->columns[1] = colRowVer;
+
+	std::vector<std::vector<byte> > allocs(2);
+
+	// Row index goes in the same heap when it fits, listing reads rows by position only
+	std::vector<byte> rowIndex;
+	if (rows.size() * 8 + matrix.size() < 3000)
+	{
+		for (size_t i = 0; i < rows.size(); i++)
+		{
+			disk::bth_leaf_entry<pstsdk::ulong, pstsdk::ulong> entry = { rows[i], (pstsdk::ulong) i };
+			std::vector<byte> entryBytes = to_bytes(entry);
+			rowIndex.insert(rowIndex.end(), entryBytes.begin(), entryBytes.end());
+		}
+	}
+	disk::bth_header bth = { disk::heap_sig_bth, sizeof(pstsdk::ulong), sizeof(pstsdk::ulong), 0, rowIndex.empty() ? 0 : make_heap_id(0, 2) };
+	allocs[1] = to_bytes(bth);
+	if (!rowIndex.empty())
+		allocs.push_back(rowIndex);
+
+	subBid = 0;
+	if (matrix.empty())
+	{
+		ptc->row_matrix_id = 0;
+	}
+	else if (rowIndex.size() > 0)
+	{
+		ptc->row_matrix_id = make_heap_id(0, (pstsdk::ulong) allocs.size());
+		allocs.push_back(matrix);
+	}
+	else
+	{
+		// Rows must not cross block boundary
+		size_t rowsPerBlock = disk::external_block<ulonglong>::max_size / cbRow;
+		block_id matrixBid = writer.AddData(matrix, rowsPerBlock * cbRow);
+
+		std::vector<byte> subBlock(sizeof(disk::sub_leaf_block<ulonglong>), 0);
+		disk::sub_leaf_block<ulonglong>* psb = (disk::sub_leaf_block<ulonglong>*) &subBlock[0];
+		psb->block_type = disk::block_type_sub;
+		psb->level = 0;
+		psb->count = 1;
+		psb->entry[0].nid = nidRowMatrix;
+		psb->entry[0].data = matrixBid;
+		psb->entry[0].sub = 0;
+		subBid = writer.AddBlock(subBlock, true);
+
+		ptc->row_matrix_id = nidRowMatrix;
+	}
+
+	allocs[0] = tcHeader;
+	return build_heap(disk::heap_sig_tc, allocs);
+}
+
+static void add_folder(PstWriter &writer, node_id nid, node_id parentNid, const std::string &name, const std::vector<node_id> &subFolders, const std::vector<node_id> &messages)
+{
+	std::vector<PropValue> props;
+	props.push_back(make_string_prop(PidTagDisplayName, name));
+	props.push_back(make_long_prop(PidTagContentCount, (pstsdk::ulong) messages.size()));
+	props.push_back(make_long_prop(PidTagContentUnreadCount, 0));
+	writer.AddNode(nid, writer.AddBlock(build_property_context(props)), 0, parentNid);
+
+	block_id subBid;
+	block_id hierarchyBid = writer.AddBlock(build_table_context(writer, subFolders, subBid));
+	writer.AddNode(make_nid(nid_type_hierarchy_table, get_nid_index(nid)), hierarchyBid, subBid, 0);
+
+	block_id contentsBid = writer.AddBlock(build_table_context(writer, messages, subBid));
+	writer.AddNode(make_nid(nid_type_contents_table, get_nid_index(nid)), contentsBid, subBid, 0);
+
+	block_id assocBid = writer.AddBlock(build_table_context(writer, std::vector<node_id>(), subBid));
+	writer.AddNode(make_nid(nid_type_associated_contents_table, get_nid_index(nid)), assocBid, subBid, 0);
+}
+
+static std::string subject_for(int index, int numSubjects)
+{
+	// Every 50th message has no subject at all
+	if (index % 50 == 49) return std::string();
+
+	char buf[64];
+	int subjIndex = index % numSubjects;
+	// Subject that looks like already resolved duplicate of another subject
+	if (subjIndex == 1)
+		return "Status report[2]";
+	snprintf(buf, sizeof(buf), "Status report%s%.0d", subjIndex ? " " : "", subjIndex);
+	return buf;
+}
+
+static bool create_pst(const char* path, int numMessages, int numSubjects)
+{
+	PstWriter writer;
+
+	std::vector<PropValue> storeProps;
+	storeProps.push_back(make_string_prop(PidTagDisplayName, "Synthetic store"));
+	writer.AddNode(nid_message_store, writer.AddBlock(build_property_context(storeProps)), 0, 0);
+
+	std::vector<node_id> subFolders(1, nidInbox);
+	add_folder(writer, nid_root_folder, nid_root_folder, "", subFolders, std::vector<node_id>());
+
+	// Messages with equal subject share one property context block
+	std::vector<block_id> subjectBlocks;
+	std::vector<std::string> subjectNames;
+	std::vector<node_id> messages;
+	for (int i = 0; i < numMessages; i++)
+	{
+		std::string subj = subject_for(i, numSubjects);
+		auto it = std::find(subjectNames.begin(), subjectNames.end(), subj);
+		block_id dataBid;
+		if (it == subjectNames.end())
+		{
+			std::vector<PropValue> props;
+			if (!subj.empty())
+				props.push_back(make_string_prop(PidTagSubject, subj));
+			dataBid = writer.AddBlock(build_property_context(props));
+			subjectNames.push_back(subj);
+			subjectBlocks.push_back(dataBid);
+		}
+		else
+		{
+			dataBid = subjectBlocks[it - subjectNames.begin()];
+		}
+
+		writer.AddNode(message_nid(i), dataBid, 0, nidInbox);
+		messages.push_back(message_nid(i));
+	}
+	add_folder(writer, nidInbox, nid_root_folder, "Inbox", std::vector<node_id>(), messages);
+
+	return writer.Save(path);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Listing
+
+struct ListedMessage
+{
+	std::wstring Folder;
+	std::wstring BaseName;  // Empty if message has no subject
+};
+
+static void collect_messages(const folder &f, const std::wstring &parentPath, std::vector<ListedMessage> &messages)
+{
+	std::wstring strSubPath(parentPath);
+	std::wstring strFolderName = f.get_name();
+	if (strFolderName.length() > 0)
+	{
+		if (strSubPath.length() > 0)
+			strSubPath.append(L"\\");
+		strSubPath.append(strFolderName);
+	}
+
+	for (auto iter = f.message_begin(); iter != f.message_end(); iter++)
+	{
+		ListedMessage lm;
+		lm.Folder = strSubPath;
+		if (iter->has_subject())
+		{
+			lm.BaseName = iter->get_subject();
+			if (lm.BaseName.length() > 200) lm.BaseName.erase(200);
+		}
+		messages.push_back(lm);
+	}
+
+	for (auto iter = f.sub_folder_begin(); iter != f.sub_folder_end(); iter++)
+		collect_messages(*iter, strSubPath, messages);
+}
+
+static std::vector<std::wstring> resolve_with_index(const std::vector<ListedMessage> &messages)
+{
+	std::unordered_map<std::wstring, FolderNameIndex> nameIndex;
+	std::vector<std::wstring> result;
+	result.reserve(messages.size());
+
+	int noNameCounter = 0;
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		const ListedMessage &lm = messages[i];
+		std::wstring baseName = lm.BaseName.empty() ? GetDefaultBaseName(++noNameCounter) : lm.BaseName;
+		result.push_back(nameIndex[lm.Folder].AddMessageName(baseName, noNameCounter));
+	}
+	return result;
+}
+
+// Algorithm used before FolderNameIndex: every candidate is checked against all listed entries
+static std::vector<std::wstring> resolve_with_scan(const std::vector<ListedMessage> &messages)
+{
+	std::vector<std::wstring> result;
+	std::vector<std::wstring> folders;
+	result.reserve(messages.size());
+
+	int noNameCounter = 0;
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		const ListedMessage &lm = messages[i];
+		std::wstring baseName = lm.BaseName.empty() ? GetDefaultBaseName(++noNameCounter) : lm.BaseName;
+
+		int dupCounter = 0;
+		std::wstring strFileName;
+		while (dupCounter < 10000)
+		{
+			bool dupFound = false;
+			strFileName = GetDupTestFilename(baseName, dupCounter, noNameCounter);
+			for (size_t j = 0; j < result.size(); j++)
+			{
+				if (result[j] == strFileName && folders[j] == lm.Folder)
+				{
+					dupFound = true;
+					break;
+				}
+			}
+			if (!dupFound) break;
+
+			dupCounter++;
+		}
+		result.push_back(strFileName);
+		folders.push_back(lm.Folder);
+	}
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <work dir> [messages] [subjects] [skip old algorithm above N messages]\n", argv[0]);
+		return 1;
+	}
+
+	std::string workDir = argv[1];
+	int numMessages = (argc > 2) ? atoi(argv[2]) : 20000;
+	int numSubjects = (argc > 3) ? atoi(argv[3]) : 4;
+	int maxScanMessages = (argc > 4) ? atoi(argv[4]) : 5000;
+	if (numSubjects < 2) numSubjects = 2;
+
+	std::string pstPath = workDir + "/dup_names.pst";
+	auto start = std::chrono::steady_clock::now();
+	if (!create_pst(pstPath.c_str(), numMessages, numSubjects))
+	{
+		printf("Can not create %s\n", pstPath.c_str());
+		return 1;
+	}
+	printf("Created PST with %d messages, %d subjects: %.3f sec\n", numMessages, numSubjects, seconds_since(start));
+
+	std::vector<ListedMessage> messages;
+	try
+	{
+		start = std::chrono::steady_clock::now();
+		pst store(std::wstring(pstPath.begin(), pstPath.end()));
+		collect_messages(store.open_root_folder(), L"", messages);
+		printf("Read %d messages with pstsdk: %.3f sec\n", (int) messages.size(), seconds_since(start));
+	}
+	catch (std::exception &e)
+	{
+		printf("Can not read PST: %s\n", e.what());
+		return 1;
+	}
+
+	if ((int) messages.size() != numMessages)
+	{
+		printf("FAILED: expected %d messages\n", numMessages);
+		return 1;
+	}
+
+	start = std::chrono::steady_clock::now();
+	std::vector<std::wstring> indexNames = resolve_with_index(messages);
+	printf("FolderNameIndex: %.3f sec\n", seconds_since(start));
+
+	std::unordered_set<std::wstring> uniqueNames(indexNames.begin(), indexNames.end());
+	if (uniqueNames.size() != indexNames.size())
+	{
+		printf("FAILED: duplicate names produced\n");
+		return 1;
+	}
+
+	if (numMessages > maxScanMessages)
+	{
+		printf("Old algorithm skipped for more than %d messages\n", maxScanMessages);
+		return 0;
+	}
+
+	start = std::chrono::steady_clock::now();
+	std::vector<std::wstring> scanNames = resolve_with_scan(messages);
+	printf("Old linear scan: %.3f sec\n", seconds_since(start));
+
+	if (scanNames != indexNames)
+	{
+		printf("FAILED: names differ from old algorithm\n");
+		return 1;
+	}
+
+	printf("Names match\n");
+	return 0;
+}
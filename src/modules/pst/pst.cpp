@@ -10,6 +10,10 @@ using namespace std;
 
 static bool optExpandEmlFile = true;
 static bool optHideEmptyFolders = false;
+static int optListingThreads = 1;
+
+// Upper limit for automatic thread count, listing is mostly limited by disk
+#define MAX_AUTO_LISTING_THREADS 4
 
 int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, StorageGeneralInfo* info)
 {
@@ -24,6 +28,14 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 		PstFileInfo *objInfo = new PstFileInfo(storeObj);
 		objInfo->HideEmptyFolders = optHideEmptyFolders;
 		objInfo->ExpandEmlFile = optExpandEmlFile;
+		objInfo->FilePath = strPath;
+		objInfo->ListingThreads = optListingThreads;
+		if (objInfo->ListingThreads <= 0)
+		{
+			objInfo->ListingThreads = (int) std::thread::hardware_concurrency();
+			if (objInfo->ListingThreads > MAX_AUTO_LISTING_THREADS)
+				objInfo->ListingThreads = MAX_AUTO_LISTING_THREADS;
+		}
 
 		*storage = objInfo;
 
@@ -58,7 +70,12 @@ int MODULE_EXPORT PrepareFiles(HANDLE storage)
 	if (!file) return FALSE;
 
 	folder pRoot = file->PstObject->open_root_folder();
-	return process_folder(pRoot, file, L"") ? TRUE : FALSE;
+	bool fResult = (file->ListingThreads > 1) ? process_folder_parallel(pRoot, file) : process_folder(pRoot, file, L"");
+
+	// Name index is only needed while building the list
+	file->NameIndex.clear();
+	
+	return fResult ? TRUE : FALSE;
 }
 
 int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo* item_info)
@@ -134,6 +151,7 @@ int MODULE_EXPORT LoadSubModule(ModuleLoadParameters* LoadParams)
 
 	OptionsList opts(LoadParams->Settings);
 	opts.GetValue(L"HideEmptyFolders", optHideEmptyFolders);
+	opts.GetValue(L"ListingThreads", optListingThreads);
 
 	return TRUE;
 }
@@ -18,5 +18,9 @@
 
 // Additional headers
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
 
 #include "pstsdk/pst.h"
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "StdAfx.h"
 #include "UdfIn.h"
 
+#include <winioctl.h>
+
 extern "C"
 {
   #include "CpuArch.h"
@@ -261,9 +263,9 @@ HRESULT CUdfArchive::ReadRaw(int volIndex, int partitionRef, UInt32 blockPos, UI
     return S_FALSE;
   const CLogVol &vol = LogVols[volIndex];
   const CPartition &partition = Partitions[vol.PartitionMaps[partitionRef].PartitionIndex];
-  if (!SeekStream(_file, ((UInt64)partition.Pos << SecLogSize) + (UInt64)blockPos * vol.BlockSize, FILE_BEGIN, NULL))
+  if (!_stream.Seek(((UInt64)partition.Pos << SecLogSize) + (UInt64)blockPos * vol.BlockSize, FILE_BEGIN, NULL))
 	  return S_FALSE;
-  return ReadStream_FALSE(_file, buf, len) ? S_OK : S_FALSE;
+  return _stream.Read(buf, len) ? S_OK : S_FALSE;
 }
 
 HRESULT CUdfArchive::Read(int volIndex, int partitionRef, UInt32 blockPos, UInt32 len, Byte *buf)
@@ -631,7 +633,7 @@ HRESULT CUdfArchive::Open2()
 {
   Clear();
 
-  UInt64 fileSize = StreamSize(_file);
+  UInt64 fileSize = _stream.GetSize();
 
   // Some UDFs contain additional 2 KB of zeros, so we also check 12, corrected to 11.
   const int kSecLogSizeMax = 12;
@@ -649,9 +651,9 @@ HRESULT CUdfArchive::Open2()
     Int32 bufSize = 1 << SecLogSize;
     if (bufSize > fileSize)
       return S_FALSE;
-    if (!SeekStream(_file, -bufSize, FILE_END, NULL))
+    if (!_stream.Seek(-bufSize, FILE_END, NULL))
 		return S_FALSE;
-    if (!ReadStream_FALSE(_file, buf, bufSize))
+    if (!_stream.Read(buf, bufSize))
 		return S_FALSE;
     CTag tag;
     if (tag.Parse(buf, bufSize) == S_OK)
@@ -667,9 +669,9 @@ HRESULT CUdfArchive::Open2()
 		SecLogSize = 11;
 		Int32 bufSize = 1 << SecLogSize;
 
-		if (!SeekStream(_file, 256 * bufSize, FILE_BEGIN, NULL))
+		if (!_stream.Seek(256 * bufSize, FILE_BEGIN, NULL))
 			return S_FALSE;
-		if (!ReadStream_FALSE(_file, buf, bufSize))
+		if (!_stream.Read(buf, bufSize))
 			return S_FALSE;
 
 		CTag tag;
@@ -686,9 +688,9 @@ HRESULT CUdfArchive::Open2()
   {
     size_t bufSize = 1 << SecLogSize;
     size_t pos = 0;
-    if (!SeekStream(_file, (UInt64)location << SecLogSize, FILE_BEGIN, NULL))
+    if (!_stream.Seek((UInt64)location << SecLogSize, FILE_BEGIN, NULL))
 		return S_FALSE;
-    if (!ReadStream_FALSE(_file, buf, bufSize))
+    if (!_stream.Read(buf, bufSize))
 		return S_FALSE;
     CTag tag;
     RINOK(tag.Parse(buf + pos, bufSize - pos));
@@ -816,7 +818,7 @@ HRESULT CUdfArchive::Open2()
 		  if (partMap.Type == 1)
 		  {
 			  const CPartition &partition = Partitions[partMap.PartitionIndex];
-			  CType1Partition *t1part = new CType1Partition(_file, partition, SecLogSize);
+			  CType1Partition *t1part = new CType1Partition(&_stream, partition, SecLogSize);
 			  vol.LogicPartitions.Add(t1part);
 		  }
 		  else if (partMap.Type == 2)
@@ -909,11 +911,22 @@ HRESULT CUdfArchive::Open2()
 
 bool CUdfArchive::Open(const wchar_t *path, CProgressVirt *progress)
 {
-  _progress = progress;
-  _file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-  if (_file == INVALID_HANDLE_VALUE)
+  if (!_stream.OpenFile(path))
 	  return false;
 
+  return Open3(progress);
+}
+
+bool CUdfArchive::Open(const StorageStreamCallbacks &stream, CProgressVirt *progress)
+{
+  _stream.OpenCallbacks(stream);
+  return Open3(progress);
+}
+
+bool CUdfArchive::Open3(CProgressVirt *progress)
+{
+  _progress = progress;
+
   HRESULT res;
   try
   {
@@ -931,8 +944,7 @@ bool CUdfArchive::Open(const wchar_t *path, CProgressVirt *progress)
 void CUdfArchive::Close()
 {
 	Clear();
-	if (_file != INVALID_HANDLE_VALUE)
-		CloseHandle(_file);
+	_stream.Close();
 }
 
 void CUdfArchive::Clear()
@@ -1026,9 +1038,58 @@ UString CUdfArchive::GetItemPath(int volIndex, int fsIndex, int refIndex,
   return name;
 }
 
+// Builds paths for all refs of the file set in one pass.
+// Refs are stored in pre-order, so parent path is always ready before its children.
+// Each path is appended to arena as zero-terminated string, refOffsets receives its position.
+void CUdfArchive::BuildPathTable(int volIndex, int fsIndex, bool showVolName, bool showFsName,
+    std::vector<wchar_t> &arena, CRecordVector<size_t> &refOffsets) const
+{
+  const CFileSet &fs = LogVols[volIndex].FileSets[fsIndex];
+
+  CRecordVector<size_t> refLengths;
+  refLengths.Reserve(fs.Refs.Size());
+  refOffsets.Clear();
+  refOffsets.Reserve(fs.Refs.Size());
+
+  for (int i = 0; i < fs.Refs.Size(); i++)
+  {
+    const CRef &ref = fs.Refs[i];
+    size_t offset = arena.size();
+    size_t length;
+
+    if (ref.Parent < 0)
+    {
+      UString prefix = GetItemPath(volIndex, fsIndex, i, showVolName, showFsName);
+      length = prefix.Length();
+      arena.insert(arena.end(), (const wchar_t*) prefix, (const wchar_t*) prefix + length);
+    }
+    else
+    {
+      UString name = GetSpecName(Files[ref.FileIndex].GetName());
+      size_t parentOffset = refOffsets[ref.Parent];
+      size_t parentLength = refLengths[ref.Parent];
+
+      length = parentLength + (parentLength > 0 ? 1 : 0) + name.Length();
+      // Resize first, parent path is copied from the same buffer
+      arena.resize(offset + length);
+      wchar_t* dest = &arena[offset];
+      if (parentLength > 0)
+      {
+        wmemcpy(dest, &arena[parentOffset], parentLength);
+        dest[parentLength] = WCHAR_PATH_SEPARATOR;
+        dest += parentLength + 1;
+      }
+      wmemcpy(dest, name, name.Length());
+    }
+    arena.push_back(0);
+
+    refOffsets.Add(offset);
+    refLengths.Add(length);
+  }
+}
+
 CUdfArchive::CUdfArchive()
 {
-	_file = INVALID_HANDLE_VALUE;
 }
 
 CUdfArchive::~CUdfArchive()
@@ -1077,55 +1138,7 @@ int CUdfArchive::DumpFileContent(const CFile& fileObj, const wchar_t* destPath,
 		}
 		else
 		{
-			size_t nBufSize = 64 * 1024;
-			char* buf = (char*) malloc(nBufSize);
-
-			DWORD dwBytesRead, dwBytesWritten;
-			for (int i = 0; i < itemObj.Extents.Size(); i++)
-			{
-				const CMyExtent& extent = itemObj.Extents[i];
-				const CPartition& part = Partitions[extent.PartitionRef];
-				const CLogVol& vol = LogVols[part.VolIndex];
-
-				UInt32 bytesLeft = extent.Len;
-				DWORD copySize;
-
-				LARGE_INTEGER movePos;
-				movePos.QuadPart = ((__int64)part.Pos << SecLogSize) + ((__int64)extent.Pos * vol.BlockSize);
-
-				SetFilePointer(_file, movePos.LowPart, &movePos.HighPart, FILE_BEGIN);
-				while (bytesLeft > 0)
-				{
-					copySize = (bytesLeft > nBufSize) ? (DWORD)nBufSize : bytesLeft;
-
-					if (!ReadFile(_file, buf , copySize, &dwBytesRead, NULL))
-					{
-						result = SER_ERROR_READ;
-						break;
-					}
-
-					if (!WriteFile(hFile, buf, dwBytesRead, &dwBytesWritten, NULL))
-					{
-						result = SER_ERROR_WRITE;
-						break;
-					}
-
-					bytesLeft -= copySize;
-
-					// Report extraction progress
-					if (itemObj.Size && epc && epc->FileProgress)
-					{
-						if (!epc->FileProgress(epc->signalContext, copySize))
-						{
-							result = SER_USERABORT;
-							break;
-						}
-					}
-				} //while
-
-				if (result != SER_SUCCESS) break;
-			}  //for
-			free(buf);
+			result = DumpExtents(itemObj, hFile, epc);
 		} // if inline
 
 		CloseHandle(hFile);
@@ -1137,6 +1150,164 @@ int CUdfArchive::DumpFileContent(const CFile& fileObj, const wchar_t* destPath,
 	return result;
 }
 
+// Continuous piece of file data, either stored in the image or unrecorded (reads as zeros)
+struct CDataRun
+{
+	UInt64 SrcPos;
+	UInt64 Len;
+	bool IsRecorded;
+};
+
+#define UDF_EXTRACT_BUFFER_SIZE (1024 * 1024)
+
+UInt64 CUdfArchive::GetItemDataOffset(const CItem &itemObj) const
+{
+	if (itemObj.IsInline)
+		return 0;
+
+	for (int i = 0; i < itemObj.Extents.Size(); i++)
+	{
+		const CMyExtent& extent = itemObj.Extents[i];
+		if (!extent.IsRecAndAlloc())
+			continue;
+
+		// Same position as DumpExtents reads from
+		const CPartition& part = Partitions[extent.PartitionRef];
+		const CLogVol& vol = LogVols[part.VolIndex];
+		return ((UInt64)part.Pos << SecLogSize) + ((UInt64)extent.Pos * vol.BlockSize);
+	}
+	return 0;
+}
+
+bool CUdfArchive::IsItemContiguous(const CItem &itemObj) const
+{
+	if (itemObj.IsInline || itemObj.Size == 0)
+		return false;
+
+	UInt64 sizeLeft = itemObj.Size;
+	UInt64 nextPos = 0;
+	for (int i = 0; i < itemObj.Extents.Size() && sizeLeft > 0; i++)
+	{
+		const CMyExtent& extent = itemObj.Extents[i];
+		if (!extent.IsRecAndAlloc())
+			return false;
+
+		const CPartition& part = Partitions[extent.PartitionRef];
+		const CLogVol& vol = LogVols[part.VolIndex];
+		UInt64 extentPos = ((UInt64)part.Pos << SecLogSize) + ((UInt64)extent.Pos * vol.BlockSize);
+		if (i > 0 && extentPos != nextPos)
+			return false;
+
+		UInt64 len = (extent.GetLen() < sizeLeft) ? extent.GetLen() : sizeLeft;
+		nextPos = extentPos + len;
+		sizeLeft -= len;
+	}
+	return (sizeLeft == 0);
+}
+
+int CUdfArchive::DumpExtents(const CItem &itemObj, HANDLE hOutFile, const ExtractProcessCallbacks* epc)
+{
+	// Merge extents which follow each other in the image into long runs
+	CRecordVector<CDataRun> runs;
+	UInt64 sizeLeft = itemObj.Size;
+	bool hasGaps = false;
+	for (int i = 0; i < itemObj.Extents.Size() && sizeLeft > 0; i++)
+	{
+		const CMyExtent& extent = itemObj.Extents[i];
+		const CPartition& part = Partitions[extent.PartitionRef];
+		const CLogVol& vol = LogVols[part.VolIndex];
+
+		CDataRun run;
+		run.SrcPos = ((UInt64)part.Pos << SecLogSize) + ((UInt64)extent.Pos * vol.BlockSize);
+		run.Len = (extent.GetLen() < sizeLeft) ? extent.GetLen() : sizeLeft;
+		run.IsRecorded = extent.IsRecAndAlloc();
+		sizeLeft -= run.Len;
+
+		if (!run.IsRecorded) hasGaps = true;
+
+		if (runs.Size() > 0)
+		{
+			CDataRun &prev = runs.Back();
+			if (prev.IsRecorded == run.IsRecorded && (!run.IsRecorded || prev.SrcPos + prev.Len == run.SrcPos))
+			{
+				prev.Len += run.Len;
+				continue;
+			}
+		}
+		runs.Add(run);
+	}
+
+	// Reserve space at once, unrecorded parts stay as holes in sparse file
+	if (hasGaps)
+	{
+		DWORD dwRet;
+		DeviceIoControl(hOutFile, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &dwRet, NULL);
+	}
+	if (itemObj.Size > 0)
+	{
+		if (!SeekStream(hOutFile, itemObj.Size, FILE_BEGIN, NULL) || !SetEndOfFile(hOutFile) || !SeekStream(hOutFile, 0, FILE_BEGIN, NULL))
+			return SER_ERROR_WRITE;
+	}
+
+	int result = SER_SUCCESS;
+	size_t nBufSize = UDF_EXTRACT_BUFFER_SIZE;
+	char* buf = (char*) malloc(nBufSize);
+
+	DWORD dwBytesWritten;
+	for (int i = 0; i < runs.Size() && result == SER_SUCCESS; i++)
+	{
+		const CDataRun &run = runs[i];
+
+		if (!run.IsRecorded)
+		{
+			if (!SeekStream(hOutFile, run.Len, FILE_CURRENT, NULL))
+				result = SER_ERROR_WRITE;
+			else if (epc && epc->FileProgress && !epc->FileProgress(epc->signalContext, run.Len))
+				result = SER_USERABORT;
+			continue;
+		}
+
+		if (!_stream.Seek(run.SrcPos, FILE_BEGIN, NULL))
+		{
+			result = SER_ERROR_READ;
+			break;
+		}
+
+		UInt64 bytesLeft = run.Len;
+		while (bytesLeft > 0)
+		{
+			DWORD copySize = (bytesLeft > nBufSize) ? (DWORD)nBufSize : (DWORD)bytesLeft;
+
+			if (!_stream.Read(buf, copySize))
+			{
+				result = SER_ERROR_READ;
+				break;
+			}
+
+			if (!WriteFile(hOutFile, buf, copySize, &dwBytesWritten, NULL))
+			{
+				result = SER_ERROR_WRITE;
+				break;
+			}
+
+			bytesLeft -= copySize;
+
+			// Report extraction progress
+			if (epc && epc->FileProgress)
+			{
+				if (!epc->FileProgress(epc->signalContext, copySize))
+				{
+					result = SER_USERABORT;
+					break;
+				}
+			}
+		} //while
+	} //for
+
+	free(buf);
+	return result;
+}
+
 FILETIME CUdfArchive::GetCreatedTime() const
 {
 	FILETIME res = {0};
@@ -1153,12 +1324,74 @@ FILETIME CUdfArchive::GetCreatedTime() const
 
 bool CType1Partition::ReadData( Byte* buf, size_t size )
 {
-	return ReadStream_FALSE(m_hFile, buf, size);
+	return m_pStream->Read(buf, size);
 }
 
 bool CType1Partition::Seek( UInt64 pos, int origin, UInt64 *currentPos )
 {
-	return SeekStream(m_hFile, m_nPartitionOffset + pos, origin, currentPos);
+	return m_pStream->Seek(m_nPartitionOffset + pos, origin, currentPos);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+bool CInStream::OpenFile( const wchar_t *path )
+{
+	m_hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	return (m_hFile != INVALID_HANDLE_VALUE);
+}
+
+void CInStream::Close()
+{
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hFile = INVALID_HANDLE_VALUE;
+	memset(&m_Callbacks, 0, sizeof(m_Callbacks));
+}
+
+bool CInStream::Read( void *data, size_t size )
+{
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		return ReadStream_FALSE(m_hFile, data, size);
+	if (!m_Callbacks.Read)
+		return false;
+
+	// Stream may return less data than requested, so read until buffer is full
+	Byte *dataPtr = (Byte *) data;
+	while (size > 0)
+	{
+		size_t bytesRead = 0;
+		if (!m_Callbacks.Read(m_Callbacks.Context, dataPtr, size, &bytesRead) || (bytesRead == 0))
+			return false;
+		dataPtr += bytesRead;
+		size -= bytesRead;
+	}
+	return true;
+}
+
+bool CInStream::Seek( Int64 moveDistance, int moveOrigin, UInt64 *currentPosition )
+{
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		return SeekStream(m_hFile, moveDistance, moveOrigin, currentPosition);
+	if (!m_Callbacks.Seek)
+		return false;
+
+	__int64 newPos = 0;
+	if (!m_Callbacks.Seek(m_Callbacks.Context, moveDistance, moveOrigin, &newPos))
+		return false;
+	if (currentPosition)
+		*currentPosition = newPos;
+	return true;
+}
+
+UInt64 CInStream::GetSize()
+{
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		return StreamSize(m_hFile);
+
+	UInt64 curPos = 0, endPos = 0;
+	if (!Seek(0, FILE_CURRENT, &curPos) || !Seek(0, FILE_END, &endPos) || !Seek(curPos, FILE_BEGIN, NULL))
+		return 0;
+	return endPos;
 }
 
 bool CMetadataPartition::ReadData( Byte* buf, size_t size )
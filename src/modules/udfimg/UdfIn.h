@@ -12,6 +12,27 @@
 
 #include "ModuleDef.h"
 
+#include <vector>
+
+// Image data source, either file on disk or stream provided by host
+
+class CInStream
+{
+	HANDLE m_hFile;
+	StorageStreamCallbacks m_Callbacks;
+
+public:
+	CInStream() : m_hFile(INVALID_HANDLE_VALUE) { memset(&m_Callbacks, 0, sizeof(m_Callbacks)); }
+
+	bool OpenFile(const wchar_t *path);
+	void OpenCallbacks(const StorageStreamCallbacks &callbacks) { m_Callbacks = callbacks; }
+	void Close();
+
+	bool Read(void *data, size_t size);
+	bool Seek(Int64 moveDistance, int moveOrigin, UInt64 *currentPosition);
+	UInt64 GetSize();
+};
+
 // ---------- ECMA Part 1 ----------
 
 // ECMA 1/7.2.12
@@ -369,11 +390,11 @@ public:
 class CType1Partition : public CLogicalPartition
 {
 private:
-	HANDLE m_hFile;
+	CInStream *m_pStream;
 	UInt64 m_nPartitionOffset;
 
 public:
-	CType1Partition(HANDLE hFile, const CPartition &physPart, int SecLogSize) : m_hFile(hFile)
+	CType1Partition(CInStream *stream, const CPartition &physPart, int SecLogSize) : m_pStream(stream)
 	{
 		Type = 1;
 		m_nPartitionOffset = (UInt64)physPart.Pos << SecLogSize;
@@ -428,7 +449,7 @@ struct CProgressVirt
 
 class CUdfArchive
 {
-  HANDLE _file;
+  CInStream _stream;
   CProgressVirt *_progress;
 
   HRESULT Read(int volIndex, int partitionRef, UInt32 blockPos, UInt32 len, Byte *buf);
@@ -439,6 +460,7 @@ class CUdfArchive
   HRESULT ReadItem(int volIndex, const CLongAllocDesc &lad, int numRecurseAllowed);
 
   HRESULT Open2();
+  bool Open3(CProgressVirt *progress);
   HRESULT FillRefs(CFileSet &fs, int fileIndex, int parent, int numRecurseAllowed);
 
   HRESULT ParseFileBuf(int volIndex, int partitionRef, const Byte *buf, size_t size, CItem &item);
@@ -459,6 +481,7 @@ public:
   ~CUdfArchive();
 	
   bool Open(const wchar_t *path, CProgressVirt *progress);
+  bool Open(const StorageStreamCallbacks &stream, CProgressVirt *progress);
   void Close();
   void Clear();
 
@@ -473,11 +496,18 @@ public:
   UString GetComment() const;
   UString GetItemPath(int volIndex, int fsIndex, int refIndex,
       bool showVolName, bool showFsName) const;
+  void BuildPathTable(int volIndex, int fsIndex, bool showVolName, bool showFsName,
+      std::vector<wchar_t> &arena, CRecordVector<size_t> &refOffsets) const;
 
   bool CheckItemExtents(int volIndex, const CItem &item) const;
 
   // Extension functions
   int DumpFileContent(const CFile& fileObj, const wchar_t* destPath, const ExtractProcessCallbacks* epc);
+  int DumpExtents(const CItem &itemObj, HANDLE hOutFile, const ExtractProcessCallbacks* epc);
+  // Image file offset of the first recorded extent, 0 if item has no data in image
+  UInt64 GetItemDataOffset(const CItem &itemObj) const;
+  // Item data is one recorded run in the image
+  bool IsItemContiguous(const CItem &itemObj) const;
   FILETIME GetCreatedTime() const;
 };
 
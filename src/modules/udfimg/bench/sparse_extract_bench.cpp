@@ -0,0 +1,445 @@
+// Standalone benchmark for UDF extraction of large sparse files.
+// Not part of the module build. Windows only, since CUdfArchive works with Win32 file handles.
+//
+// Creates sparse UDF image (default about 6 GB) with one file made of runs of adjacent
+// recorded extents separated by big allocated-but-not-recorded extents, like VM images on BD-R.
+// The file is extracted with per-extent 64 KB copy (what DumpFileContent did before)
+// and with CUdfArchive::DumpFileContent. Both outputs are checked against generated content.
+//
+// Build from Visual Studio command prompt, for example:
+//   cl /O2 /EHsc /I.. /I..\7zCommon /I..\..\..\common sparse_extract_bench.cpp
+// Usage: sparse_extract_bench <work dir> [groups] [gap MB] [skip old (0/1)]
+
+#include "stdafx.h"
+
+#include <stdio.h>
+#include <chrono>
+
+#include "../UdfIn.cpp"
+#include "../7zCommon/IntToString.cpp"
+#include "../7zCommon/MyMap.cpp"
+#include "../7zCommon/MyString.cpp"
+#include "../7zCommon/MyVector.cpp"
+#include "../7zCommon/StreamUtils.cpp"
+#include "../7zCommon/StringConvert.cpp"
+
+#define SECTOR_SIZE 2048
+#define VDS_START 257
+#define PARTITION_START 272
+#define FILE_DATA_BLOCK 16
+#define MAX_SHORT_ADS ((SECTOR_SIZE - 176) / 8)
+
+#define EXTENT_SIZE (1024 * 1024)
+#define EXTENTS_PER_GROUP 8
+#define LAST_EXTENT_SIZE (EXTENT_SIZE - 1000)
+
+static const wchar_t* TestFileName = L"sparse.bin";
+
+struct TestExtent
+{
+	UInt32 Pos;  // Block inside partition
+	UInt32 Len;
+	bool IsRecorded;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+static void put16(Byte* p, UInt16 v) { p[0] = (Byte) v; p[1] = (Byte) (v >> 8); }
+static void put32(Byte* p, UInt32 v) { put16(p, (UInt16) v); put16(p + 2, (UInt16) (v >> 16)); }
+static void put64(Byte* p, UInt64 v) { put32(p, (UInt32) v); put32(p + 4, (UInt32) (v >> 32)); }
+
+// Content of recorded data depends only on position inside the file
+static UInt64 pattern_word(UInt64 filePos)
+{
+	UInt64 z = (filePos >> 3) + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static void fill_pattern(Byte* buf, UInt64 filePos, size_t size)
+{
+	for (size_t i = 0; i < size; i += 8)
+	{
+		UInt64 w = pattern_word(filePos + i);
+		memcpy(buf + i, &w, (size - i < 8) ? size - i : 8);
+	}
+}
+
+// ECMA 3/7.2 descriptor tag, descriptor body must be filled already
+static void set_tag(Byte* p, UInt16 id, UInt32 location, size_t descSize)
+{
+	put16(p, id);
+	put16(p + 2, 2);
+	put16(p + 6, 1);
+	put16(p + 8, Crc16Calc(p + 16, descSize - 16));
+	put16(p + 10, (UInt16) (descSize - 16));
+	put32(p + 12, location);
+
+	Byte sum = 0;
+	for (int i = 0; i < 16; i++)
+		if (i != 4) sum += p[i];
+	p[4] = sum;
+}
+
+static void put_dstring(Byte* p, size_t fieldSize, const char* text)
+{
+	size_t len = strlen(text);
+	p[0] = 8;
+	memcpy(p + 1, text, len);
+	p[fieldSize - 1] = (Byte) (len + 1);
+}
+
+static bool write_at(HANDLE hFile, UInt64 pos, const void* data, DWORD size)
+{
+	DWORD dwWritten;
+	return SeekStream(hFile, pos, FILE_BEGIN, NULL) && WriteFile(hFile, data, size, &dwWritten, NULL) && (dwWritten == size);
+}
+
+static void build_extents(int numGroups, UInt32 gapSize, CRecordVector<TestExtent> &extents, UInt64 &fileSize, UInt32 &endBlock)
+{
+	UInt32 blockPos = FILE_DATA_BLOCK;
+	fileSize = 0;
+	for (int g = 0; g < numGroups; g++)
+	{
+		for (int i = 0; i < EXTENTS_PER_GROUP; i++)
+		{
+			TestExtent ext = { blockPos, EXTENT_SIZE, true };
+			extents.Add(ext);
+			blockPos += EXTENT_SIZE / SECTOR_SIZE;
+			fileSize += EXTENT_SIZE;
+		}
+
+		// Space is allocated in the image but never written
+		TestExtent gap = { blockPos, gapSize, false };
+		extents.Add(gap);
+		blockPos += gapSize / SECTOR_SIZE;
+		fileSize += gapSize;
+	}
+
+	// Last extent is not block aligned
+	TestExtent last = { blockPos, LAST_EXTENT_SIZE, true };
+	extents.Add(last);
+	blockPos += (LAST_EXTENT_SIZE + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	fileSize += LAST_EXTENT_SIZE;
+
+	endBlock = blockPos;
+}
+
+static bool create_image(const wchar_t* path, const CRecordVector<TestExtent> &extents, UInt64 fileSize, UInt32 partBlocks)
+{
+	HANDLE hFile = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD dwRet;
+	DeviceIoControl(hFile, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &dwRet, NULL);
+
+	UInt32 lastSector = PARTITION_START + partBlocks;
+	UInt64 imageSize = (UInt64) (lastSector + 1) * SECTOR_SIZE;
+	bool fOk = SeekStream(hFile, imageSize, FILE_BEGIN, NULL) && SetEndOfFile(hFile);
+
+	Byte sec[SECTOR_SIZE];
+
+	// Anchor volume descriptor pointers
+	UInt32 anchorPos[] = { 256, lastSector };
+	for (int i = 0; i < 2 && fOk; i++)
+	{
+		memset(sec, 0, sizeof(sec));
+		put32(sec + 16, 16 * SECTOR_SIZE);
+		put32(sec + 20, VDS_START);
+		set_tag(sec, DESC_TYPE_AnchorVolPtr, anchorPos[i], 512);
+		fOk = write_at(hFile, (UInt64) anchorPos[i] * SECTOR_SIZE, sec, SECTOR_SIZE);
+	}
+
+	// Partition descriptor
+	memset(sec, 0, sizeof(sec));
+	put16(sec + 22, 0);
+	put32(sec + 188, PARTITION_START);
+	put32(sec + 192, partBlocks);
+	set_tag(sec, DESC_TYPE_Partition, VDS_START, 512);
+	fOk = fOk && write_at(hFile, (UInt64) VDS_START * SECTOR_SIZE, sec, SECTOR_SIZE);
+
+	// Logical volume descriptor with one type 1 partition map
+	memset(sec, 0, sizeof(sec));
+	put_dstring(sec + 84, 128, "SPARSE_BENCH");
+	put32(sec + 212, SECTOR_SIZE);
+	memcpy(sec + 217, "*OSTA UDF Compliant", 19);
+	put32(sec + 248, SECTOR_SIZE);  // File set descriptor at block 0
+	put32(sec + 264, 6);
+	put32(sec + 268, 1);
+	sec[440] = 1;
+	sec[441] = 6;
+	put16(sec + 442, 1);
+	put16(sec + 444, 0);
+	set_tag(sec, DESC_TYPE_LogicalVol, VDS_START + 1, 446);
+	fOk = fOk && write_at(hFile, (UInt64) (VDS_START + 1) * SECTOR_SIZE, sec, SECTOR_SIZE);
+
+	memset(sec, 0, sizeof(sec));
+	set_tag(sec, DESC_TYPE_Terminating, VDS_START + 2, 512);
+	fOk = fOk && write_at(hFile, (UInt64) (VDS_START + 2) * SECTOR_SIZE, sec, SECTOR_SIZE);
+
+	UInt64 partPos = (UInt64) PARTITION_START * SECTOR_SIZE;
+
+	// Block 0: file set descriptor, root directory ICB is at block 1
+	memset(sec, 0, sizeof(sec));
+	put32(sec + 400, SECTOR_SIZE);
+	put32(sec + 404, 1);
+	set_tag(sec, DESC_TYPE_FileSet, 0, 512);
+	fOk = fOk && write_at(hFile, partPos, sec, SECTOR_SIZE);
+
+	// Block 2: root directory content, parent entry and the test file
+	memset(sec, 0, sizeof(sec));
+	size_t dirSize = 0;
+	{
+		Byte* fid = sec;
+		fid[18] = 0x0A;  // Directory, parent
+		put32(fid + 20, SECTOR_SIZE);
+		put32(fid + 24, 1);
+		set_tag(fid, DESC_TYPE_FileId, 2, 40);
+		dirSize += 40;
+
+		fid = sec + dirSize;
+		fid[19] = 1 + (Byte) wcslen(TestFileName);
+		put32(fid + 20, SECTOR_SIZE);
+		put32(fid + 24, 3);
+		fid[38] = 8;
+		for (size_t i = 0; TestFileName[i]; i++)
+			fid[39 + i] = (Byte) TestFileName[i];
+		size_t fidSize = (38 + fid[19] + 3) & ~3;
+		set_tag(fid, DESC_TYPE_FileId, 2, fidSize);
+		dirSize += fidSize;
+	}
+	fOk = fOk && write_at(hFile, partPos + 2 * SECTOR_SIZE, sec, SECTOR_SIZE);
+
+	// Block 1: root directory file entry
+	memset(sec, 0, sizeof(sec));
+	sec[16 + 11] = ICB_FILE_TYPE_DIR;
+	put64(sec + 56, dirSize);
+	put64(sec + 64, 1);
+	put32(sec + 172, 8);
+	put32(sec + 176, (UInt32) dirSize);
+	put32(sec + 180, 2);
+	set_tag(sec, DESC_TYPE_File, 1, 176 + 8);
+	fOk = fOk && write_at(hFile, partPos + SECTOR_SIZE, sec, SECTOR_SIZE);
+
+	// Block 3: test file entry with short allocation descriptors
+	memset(sec, 0, sizeof(sec));
+	sec[16 + 11] = ICB_FILE_TYPE_FILE;
+	put64(sec + 56, fileSize);
+	UInt64 recordedBlocks = 0;
+	for (int i = 0; i < extents.Size(); i++)
+	{
+		const TestExtent &ext = extents[i];
+		put32(sec + 176 + i * 8, ext.Len | (ext.IsRecorded ? 0 : (1u << 30)));
+		put32(sec + 180 + i * 8, ext.Pos);
+		if (ext.IsRecorded)
+			recordedBlocks += (ext.Len + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	}
+	put64(sec + 64, recordedBlocks);
+	put32(sec + 172, extents.Size() * 8);
+	set_tag(sec, DESC_TYPE_File, 3, 176 + extents.Size() * 8);
+	fOk = fOk && write_at(hFile, partPos + 3 * SECTOR_SIZE, sec, SECTOR_SIZE);
+
+	// File data, gaps are left as holes
+	Byte* dataBuf = (Byte*) malloc(EXTENT_SIZE);
+	UInt64 filePos = 0;
+	for (int i = 0; i < extents.Size() && fOk; i++)
+	{
+		const TestExtent &ext = extents[i];
+		if (ext.IsRecorded)
+		{
+			fill_pattern(dataBuf, filePos, ext.Len);
+			fOk = write_at(hFile, partPos + (UInt64) ext.Pos * SECTOR_SIZE, dataBuf, ext.Len);
+		}
+		filePos += ext.Len;
+	}
+	free(dataBuf);
+
+	CloseHandle(hFile);
+	return fOk;
+}
+
+// Extraction loop as it was before extent runs were introduced
+static int dump_per_extent(CUdfArchive &arc, const wchar_t* imagePath, const CItem &itemObj, const wchar_t* destPath)
+{
+	HANDLE hFile = CreateFileW(destPath, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return SER_ERROR_WRITE;
+
+	HANDLE hImage = CreateFileW(imagePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	int result = SER_SUCCESS;
+	size_t nBufSize = 64 * 1024;
+	char* buf = (char*) malloc(nBufSize);
+
+	DWORD dwBytesRead, dwBytesWritten;
+	for (int i = 0; i < itemObj.Extents.Size() && result == SER_SUCCESS; i++)
+	{
+		const CMyExtent& extent = itemObj.Extents[i];
+		const CPartition& part = arc.Partitions[extent.PartitionRef];
+		const CLogVol& vol = arc.LogVols[part.VolIndex];
+
+		UInt32 bytesLeft = extent.GetLen();
+		SeekStream(hImage, ((UInt64)part.Pos << arc.SecLogSize) + ((UInt64)extent.Pos * vol.BlockSize), FILE_BEGIN, NULL);
+		while (bytesLeft > 0)
+		{
+			DWORD copySize = (bytesLeft > nBufSize) ? (DWORD)nBufSize : bytesLeft;
+			if (!ReadFile(hImage, buf, copySize, &dwBytesRead, NULL))
+			{
+				result = SER_ERROR_READ;
+				break;
+			}
+			if (!WriteFile(hFile, buf, dwBytesRead, &dwBytesWritten, NULL))
+			{
+				result = SER_ERROR_WRITE;
+				break;
+			}
+			bytesLeft -= copySize;
+		}
+	}
+
+	free(buf);
+	CloseHandle(hImage);
+	CloseHandle(hFile);
+	return result;
+}
+
+static UInt64 g_nProgressBytes = 0;
+
+static int CALLBACK count_progress(HANDLE, __int64 bytes)
+{
+	g_nProgressBytes += bytes;
+	return TRUE;
+}
+
+static bool verify_output(const wchar_t* path, const CRecordVector<TestExtent> &extents, UInt64 fileSize)
+{
+	HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool fOk = (StreamSize(hFile) == fileSize);
+	Byte* actual = (Byte*) malloc(EXTENT_SIZE);
+	Byte* expected = (Byte*) malloc(EXTENT_SIZE);
+
+	UInt64 filePos = 0;
+	for (int i = 0; i < extents.Size() && fOk; i++)
+	{
+		const TestExtent &ext = extents[i];
+		for (UInt32 done = 0; done < ext.Len && fOk; )
+		{
+			DWORD chunk = (ext.Len - done > EXTENT_SIZE) ? EXTENT_SIZE : ext.Len - done;
+			if (ext.IsRecorded)
+				fill_pattern(expected, filePos + done, chunk);
+			else
+				memset(expected, 0, chunk);
+
+			fOk = ReadStream_FALSE(hFile, actual, chunk) && (memcmp(actual, expected, chunk) == 0);
+			done += chunk;
+		}
+		filePos += ext.Len;
+	}
+
+	free(expected);
+	free(actual);
+	CloseHandle(hFile);
+	return fOk;
+}
+
+static double allocated_mb(const wchar_t* path)
+{
+	DWORD sizeHigh = 0;
+	DWORD sizeLow = GetCompressedFileSizeW(path, &sizeHigh);
+	return (sizeLow + ((UInt64) sizeHigh << 32)) / (1024.0 * 1024.0);
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 2)
+	{
+		wprintf(L"Usage: %ls <work dir> [groups] [gap MB] [skip old (0/1)]\n", argv[0]);
+		return 1;
+	}
+
+	std::wstring workDir = argv[1];
+	int numGroups = (argc > 2) ? _wtoi(argv[2]) : 24;
+	int gapMB = (argc > 3) ? _wtoi(argv[3]) : 256;
+	bool skipOld = (argc > 4) && (_wtoi(argv[4]) != 0);
+
+	if (numGroups < 1 || numGroups * (EXTENTS_PER_GROUP + 1) + 1 > MAX_SHORT_ADS || gapMB < 1 || gapMB > 1023)
+	{
+		wprintf(L"Invalid parameters, at most %d groups and 1023 MB gaps are possible\n", (MAX_SHORT_ADS - 1) / (EXTENTS_PER_GROUP + 1));
+		return 1;
+	}
+
+	std::wstring imagePath = workDir + L"\\sparse_bench.udf";
+	std::wstring oldOutPath = workDir + L"\\sparse_old.bin";
+	std::wstring newOutPath = workDir + L"\\sparse_new.bin";
+
+	CRecordVector<TestExtent> extents;
+	UInt64 fileSize;
+	UInt32 partBlocks;
+	build_extents(numGroups, (UInt32) gapMB * 1024 * 1024, extents, fileSize, partBlocks);
+
+	auto start = std::chrono::steady_clock::now();
+	if (!create_image(imagePath.c_str(), extents, fileSize, partBlocks))
+	{
+		wprintf(L"Can not create test image\n");
+		return 1;
+	}
+	wprintf(L"Image: %.0f MB logical, %.0f MB allocated, created in %.2f sec\n",
+		(double) (PARTITION_START + partBlocks + 1) * SECTOR_SIZE / (1024 * 1024), allocated_mb(imagePath.c_str()), seconds_since(start));
+	wprintf(L"File: %.0f MB in %d extents\n", fileSize / (1024.0 * 1024.0), extents.Size());
+
+	CUdfArchive arc;
+	if (!arc.Open(imagePath.c_str(), NULL))
+	{
+		wprintf(L"CUdfArchive can not open image\n");
+		return 1;
+	}
+
+	int fileIndex = -1;
+	for (int i = 0; i < arc.Files.Size(); i++)
+		if (arc.Files[i].ItemIndex >= 0 && wcscmp(arc.Files[i].GetName(), TestFileName) == 0)
+			fileIndex = i;
+	if (fileIndex < 0)
+	{
+		wprintf(L"Test file not found in image\n");
+		return 1;
+	}
+	const CFile &fileObj = arc.Files[fileIndex];
+	const CItem &itemObj = arc.Items[fileObj.ItemIndex];
+
+	int exitCode = 0;
+	if (!skipOld)
+	{
+		start = std::chrono::steady_clock::now();
+		int res = dump_per_extent(arc, imagePath.c_str(), itemObj, oldOutPath.c_str());
+		double oldTime = seconds_since(start);
+
+		bool fMatch = (res == SER_SUCCESS) && verify_output(oldOutPath.c_str(), extents, fileSize);
+		wprintf(L"Per extent copy: %.2f sec, %.0f MB allocated, %ls\n", oldTime, allocated_mb(oldOutPath.c_str()), fMatch ? L"content OK" : L"content MISMATCH");
+		if (!fMatch) exitCode = 1;
+		DeleteFileW(oldOutPath.c_str());
+	}
+
+	ExtractProcessCallbacks epc = { NULL, count_progress };
+	start = std::chrono::steady_clock::now();
+	int res = arc.DumpFileContent(fileObj, newOutPath.c_str(), &epc);
+	double newTime = seconds_since(start);
+
+	bool fMatch = (res == SER_SUCCESS) && verify_output(newOutPath.c_str(), extents, fileSize) && (g_nProgressBytes == fileSize);
+	wprintf(L"DumpFileContent: %.2f sec, %.0f MB allocated, %ls\n", newTime, allocated_mb(newOutPath.c_str()), fMatch ? L"content OK" : L"content MISMATCH");
+	if (!fMatch) exitCode = 1;
+	DeleteFileW(newOutPath.c_str());
+
+	arc.Close();
+	DeleteFileW(imagePath.c_str());
+
+	return exitCode;
+}
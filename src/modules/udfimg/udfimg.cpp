@@ -10,12 +10,14 @@ struct CRef2
 	int Vol;
 	int Fs;
 	int Ref;
+	size_t PathOffset;
 };
 
 struct UdfStorage
 {
 	CUdfArchive arc;
 	CRecordVector<CRef2> refs2;
+	std::vector<wchar_t> pathArena;
 };
 
 void CopyArcParam(wchar_t* dest, UString src)
@@ -34,7 +36,8 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 {
 	UdfStorage *storageRec = new UdfStorage;
 
-	if (storageRec->arc.Open(params.FilePath, NULL))
+	bool openRes = params.Stream ? storageRec->arc.Open(*params.Stream, NULL) : storageRec->arc.Open(params.FilePath, NULL);
+	if (openRes)
 	{
 		*storage = storageRec;
 
@@ -54,6 +57,7 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 					ref2.Vol = volIndex;
 					ref2.Fs = fsIndex;
 					ref2.Ref = i;
+					ref2.PathOffset = 0;
 					storageRec->refs2.Add(ref2);
 				}
 			}
@@ -85,6 +89,35 @@ void MODULE_EXPORT CloseStorage(HANDLE storage)
 
 int MODULE_EXPORT PrepareFiles(HANDLE storage)
 {
+	UdfStorage *storageRec = (UdfStorage*) storage;
+	if (!storageRec) return FALSE;
+
+	if (!storageRec->pathArena.empty())
+		return TRUE;
+
+	// Build paths for all items at once, refs2 goes in the same order as volumes and file sets
+	bool showVolName = (storageRec->arc.LogVols.Size() > 1);
+	CRecordVector<size_t> refOffsets;
+	int refs2Pos = 0;
+	for (int volIndex = 0; volIndex < storageRec->arc.LogVols.Size(); volIndex++)
+	{
+		const CLogVol &vol = storageRec->arc.LogVols[volIndex];
+		bool showFileSetName = (vol.FileSets.Size() > 1);
+		for (int fsIndex = 0; fsIndex < vol.FileSets.Size(); fsIndex++)
+		{
+			storageRec->arc.BuildPathTable(volIndex, fsIndex, showVolName, showFileSetName, storageRec->pathArena, refOffsets);
+
+			while (refs2Pos < storageRec->refs2.Size())
+			{
+				CRef2 &ref2 = storageRec->refs2[refs2Pos];
+				if ((ref2.Vol != volIndex) || (ref2.Fs != fsIndex)) break;
+				
+				ref2.PathOffset = refOffsets[ref2.Ref];
+				refs2Pos++;
+			}
+		}
+	}
+	
 	return TRUE;
 }
 
@@ -102,19 +135,27 @@ int MODULE_EXPORT GetStorageItem(HANDLE storage, int item_index, StorageItemInfo
 	const CFile &file = storageRec->arc.Files[ref.FileIndex];
 	CItem &item = storageRec->arc.Items[file.ItemIndex];
 
-	UString fname = file.GetName();
-
 	memset(item_info, 0, sizeof(StorageItemInfo));
 	if (item.IsDir())
 		item_info->Attributes = FILE_ATTRIBUTE_DIRECTORY;
 	else
 		item_info->Attributes = file.IsHidden ? FILE_ATTRIBUTE_HIDDEN : FILE_ATTRIBUTE_ARCHIVE;
 	item_info->Size = item.Size;
+	item_info->DataPosition = storageRec->arc.GetItemDataOffset(item);
+	if (storageRec->arc.IsItemContiguous(item))
+		item_info->DataFlags = ITEM_DATA_CONTIGUOUS;
 	item.MTime.GetFileTime(item_info->ModificationTime);
 	item.CreateTime.GetFileTime(item_info->CreationTime);
 
-	UString fullPath = storageRec->arc.GetItemPath(ref2.Vol, ref2.Fs, ref2.Ref, storageRec->arc.LogVols.Size() > 1, vol.FileSets.Size() > 1);
-	wcscpy_s(item_info->Path, STRBUF_SIZE(item_info->Path), fullPath);
+	if (!storageRec->pathArena.empty())
+	{
+		wcscpy_s(item_info->Path, STRBUF_SIZE(item_info->Path), &storageRec->pathArena[ref2.PathOffset]);
+	}
+	else
+	{
+		UString fullPath = storageRec->arc.GetItemPath(ref2.Vol, ref2.Fs, ref2.Ref, storageRec->arc.LogVols.Size() > 1, vol.FileSets.Size() > 1);
+		wcscpy_s(item_info->Path, STRBUF_SIZE(item_info->Path), fullPath);
+	}
 	
 	return GET_ITEM_OK;
 }
@@ -152,6 +193,7 @@ int MODULE_EXPORT LoadSubModule(ModuleLoadParameters* LoadParams)
 	LoadParams->ModuleId = MODULE_GUID;
 	LoadParams->ModuleVersion = MAKEMODULEVERSION(1, 0);
 	LoadParams->ApiVersion = ACTUAL_API_VERSION;
+	LoadParams->Capabilities = MODULE_CAP_OPEN_STREAM;
 	LoadParams->ApiFuncs.OpenStorage = OpenStorage;
 	LoadParams->ApiFuncs.CloseStorage = CloseStorage;
 	LoadParams->ApiFuncs.GetItem = GetStorageItem;
@@ -0,0 +1,775 @@
+#include "stdafx.h"
+#include "VirtualDiskImage.h"
+
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+
+// Mapped window is moved over the file, so big images do not need address space of their size
+#define IMAGE_VIEW_SIZE (64 * 1024 * 1024)
+
+#define SECTOR_SIZE 512
+
+#define VHD_TYPE_FIXED 2
+#define VHD_TYPE_DYNAMIC 3
+#define VHD_UNUSED_BLOCK 0xFFFFFFFF
+
+#define VHDX_HEADER1_OFFSET (64 * 1024)
+#define VHDX_HEADER2_OFFSET (128 * 1024)
+#define VHDX_HEADER_SIZE (4 * 1024)
+#define VHDX_REGION_TABLE_OFFSET (192 * 1024)
+#define VHDX_REGION_TABLE_SIZE (64 * 1024)
+#define VHDX_BLOCK_FULLY_PRESENT 6
+#define VHDX_FLAG_HAS_PARENT 2
+
+#define VMDK_MAGIC 0x564D444B  // "KDMV"
+#define VMDK_FLAG_COMPRESSED (1 << 16)
+#define VMDK_GD_AT_END 0xFFFFFFFFFFFFFFFFULL
+#define VMDK_GRAIN_ZEROED 1
+#define VMDK_MAX_CACHED_TABLES 4096
+
+static const uint8_t VHD_COOKIE[] = { 'c', 'o', 'n', 'e', 'c', 't', 'i', 'x' };
+static const uint8_t VHD_DYNAMIC_COOKIE[] = { 'c', 'x', 's', 'p', 'a', 'r', 's', 'e' };
+static const uint8_t VHDX_SIGNATURE[] = { 'v', 'h', 'd', 'x', 'f', 'i', 'l', 'e' };
+static const uint8_t VHDX_HEADER_SIGNATURE[] = { 'h', 'e', 'a', 'd' };
+static const uint8_t VHDX_REGION_SIGNATURE[] = { 'r', 'e', 'g', 'i' };
+static const uint8_t VHDX_METADATA_SIGNATURE[] = { 'm', 'e', 't', 'a', 'd', 'a', 't', 'a' };
+
+static const GUID VHDX_BAT_GUID = { 0x2DC27766, 0xF623, 0x4200, { 0x9D, 0x64, 0x11, 0x5E, 0x9B, 0xFD, 0x4A, 0x08 } };
+static const GUID VHDX_METADATA_GUID = { 0x8B7CA206, 0x4790, 0x4B9A, { 0xB8, 0xFE, 0x57, 0x5F, 0x05, 0x0F, 0x88, 0x6E } };
+static const GUID VHDX_FILE_PARAMS_GUID = { 0xCAA16737, 0xFA36, 0x4D43, { 0xB3, 0xB6, 0x33, 0xF0, 0xAA, 0x44, 0xE7, 0x6B } };
+static const GUID VHDX_DISK_SIZE_GUID = { 0x2FA54224, 0xCD1B, 0x4876, { 0xB2, 0x11, 0x5D, 0xBE, 0xD8, 0x3B, 0xF4, 0xB8 } };
+static const GUID VHDX_SECTOR_SIZE_GUID = { 0x8141BF1D, 0xA96F, 0x4709, { 0xBA, 0x47, 0xF2, 0x33, 0xA8, 0xFA, 0xAB, 0x5F } };
+
+#pragma pack(push, 1)
+
+// VHD structures are big-endian
+struct VhdFooter
+{
+	uint8_t Cookie[8];
+	uint32_t Features;
+	uint32_t FormatVersion;
+	uint64_t DataOffset;
+	uint32_t TimeStamp;
+	uint8_t CreatorApplication[4];
+	uint32_t CreatorVersion;
+	uint32_t CreatorHostOS;
+	uint64_t OriginalSize;
+	uint64_t CurrentSize;
+	uint32_t DiskGeometry;
+	uint32_t DiskType;
+	uint32_t Checksum;
+	uint8_t UniqueId[16];
+	uint8_t SavedState;
+	uint8_t Reserved[427];
+};
+
+struct VhdDynamicHeader
+{
+	uint8_t Cookie[8];
+	uint64_t DataOffset;
+	uint64_t TableOffset;
+	uint32_t HeaderVersion;
+	uint32_t MaxTableEntries;
+	uint32_t BlockSize;
+	uint32_t Checksum;
+	uint8_t ParentUniqueId[16];
+	uint32_t ParentTimeStamp;
+	uint32_t Reserved1;
+	uint8_t ParentUnicodeName[512];
+	uint8_t ParentLocators[8 * 24];
+	uint8_t Reserved2[256];
+};
+
+struct VhdxHeader
+{
+	uint8_t Signature[4];
+	uint32_t Checksum;
+	uint64_t SequenceNumber;
+	GUID FileWriteGuid;
+	GUID DataWriteGuid;
+	GUID LogGuid;
+	uint16_t LogVersion;
+	uint16_t Version;
+	uint32_t LogLength;
+	uint64_t LogOffset;
+};
+
+struct VhdxRegionTableHeader
+{
+	uint8_t Signature[4];
+	uint32_t Checksum;
+	uint32_t EntryCount;
+	uint32_t Reserved;
+};
+
+struct VhdxRegionTableEntry
+{
+	GUID Guid;
+	uint64_t FileOffset;
+	uint32_t Length;
+	uint32_t Required;
+};
+
+struct VhdxMetadataTableHeader
+{
+	uint8_t Signature[8];
+	uint16_t Reserved;
+	uint16_t EntryCount;
+	uint32_t Reserved2[5];
+};
+
+struct VhdxMetadataTableEntry
+{
+	GUID ItemId;
+	uint32_t Offset;
+	uint32_t Length;
+	uint32_t Flags;
+	uint32_t Reserved;
+};
+
+struct VmdkSparseHeader
+{
+	uint32_t MagicNumber;
+	uint32_t Version;
+	uint32_t Flags;
+	uint64_t Capacity;
+	uint64_t GrainSize;
+	uint64_t DescriptorOffset;
+	uint64_t DescriptorSize;
+	uint32_t NumGTEsPerGT;
+	uint64_t RgdOffset;
+	uint64_t GdOffset;
+	uint64_t OverHead;
+	uint8_t UncleanShutdown;
+	char SingleEndLineChar;
+	char NonEndLineChar;
+	char DoubleEndLineChar1;
+	char DoubleEndLineChar2;
+	uint16_t CompressAlgorithm;
+	uint8_t Pad[433];
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(VhdFooter) == 512, "Invalid VHD footer size");
+static_assert(sizeof(VhdDynamicHeader) == 1024, "Invalid VHD dynamic header size");
+static_assert(sizeof(VmdkSparseHeader) == 512, "Invalid VMDK header size");
+
+static uint32_t be32(uint32_t val) { return _byteswap_ulong(val); }
+static uint64_t be64(uint64_t val) { return _byteswap_uint64(val); }
+
+static bool isPowerOfTwo(uint64_t val)
+{
+	return (val != 0) && ((val & (val - 1)) == 0);
+}
+
+// CRC-32C (Castagnoli), used for VHDX header and region table checksums
+static uint32_t crc32c(const uint8_t* data, size_t size)
+{
+	static uint32_t table[256] = {0};
+	if (table[1] == 0)
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t crc = i;
+			for (int j = 0; j < 8; j++)
+				crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : (crc >> 1);
+			table[i] = crc;
+		}
+	}
+
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+// Checksum field must be zero during calculation
+static bool checkVhdxCrc(std::vector<uint8_t> &data, size_t checksumPos)
+{
+	uint32_t storedCrc;
+	memcpy(&storedCrc, &data[checksumPos], sizeof(storedCrc));
+	memset(&data[checksumPos], 0, sizeof(storedCrc));
+
+	bool fResult = (crc32c(data.data(), data.size()) == storedCrc);
+	memcpy(&data[checksumPos], &storedCrc, sizeof(storedCrc));
+	return fResult;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CMappedImageFile::CMappedImageFile()
+	: m_hFile(INVALID_HANDLE_VALUE), m_hMapping(NULL), m_nFileSize(0), m_nGranularity(0),
+	m_pView(nullptr), m_nViewStart(0), m_nViewSize(0)
+{
+}
+
+CMappedImageFile::~CMappedImageFile()
+{
+	Close();
+}
+
+bool CMappedImageFile::Open(const wchar_t* path)
+{
+	Close();
+
+	m_hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx(m_hFile, &liSize) || (liSize.QuadPart < SECTOR_SIZE))
+	{
+		Close();
+		return false;
+	}
+	m_nFileSize = liSize.QuadPart;
+
+	m_hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_hMapping)
+	{
+		Close();
+		return false;
+	}
+
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	m_nGranularity = sysInfo.dwAllocationGranularity;
+
+	return true;
+}
+
+void CMappedImageFile::Close()
+{
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = nullptr;
+	}
+	if (m_hMapping)
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = NULL;
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+		m_hFile = INVALID_HANDLE_VALUE;
+	}
+	m_nFileSize = 0;
+	m_nViewStart = 0;
+	m_nViewSize = 0;
+}
+
+bool CMappedImageFile::mapView(uint64_t offset)
+{
+	if (m_pView)
+	{
+		UnmapViewOfFile(m_pView);
+		m_pView = nullptr;
+	}
+
+	uint64_t viewStart = offset - (offset % m_nGranularity);
+	size_t viewSize = (size_t) std::min<uint64_t>(IMAGE_VIEW_SIZE, m_nFileSize - viewStart);
+
+	m_pView = (const uint8_t*) MapViewOfFile(m_hMapping, FILE_MAP_READ, (DWORD) (viewStart >> 32), (DWORD) viewStart, viewSize);
+	if (!m_pView)
+		return false;
+
+	m_nViewStart = viewStart;
+	m_nViewSize = viewSize;
+	return true;
+}
+
+bool CMappedImageFile::Read(uint64_t offset, void* buf, size_t size)
+{
+	if (!m_hMapping || (offset > m_nFileSize) || (size > m_nFileSize - offset))
+		return false;
+
+	uint8_t* dest = (uint8_t*) buf;
+	while (size > 0)
+	{
+		if (!m_pView || (offset < m_nViewStart) || (offset >= m_nViewStart + m_nViewSize))
+		{
+			if (!mapView(offset))
+				return false;
+		}
+
+		size_t viewPos = (size_t) (offset - m_nViewStart);
+		size_t copySize = std::min(size, m_nViewSize - viewPos);
+		memcpy(dest, m_pView + viewPos, copySize);
+
+		dest += copySize;
+		offset += copySize;
+		size -= copySize;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+bool CVirtualDiskImage::Read(uint64_t offset, void* buf, size_t size)
+{
+	if ((offset > m_nDiskSize) || (size > m_nDiskSize - offset))
+		return false;
+
+	uint8_t* dest = (uint8_t*) buf;
+	while (size > 0)
+	{
+		uint64_t blockIndex = offset / m_nBlockSize;
+		uint32_t blockOffset = (uint32_t) (offset % m_nBlockSize);
+		uint32_t partSize = (uint32_t) std::min<uint64_t>(size, m_nBlockSize - blockOffset);
+
+		if (!readBlock(blockIndex, blockOffset, dest, partSize))
+			return false;
+
+		dest += partSize;
+		offset += partSize;
+		size -= partSize;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static bool readVhdFooter(CMappedImageFile &file, VhdFooter &footer)
+{
+	// Dynamic disks keep footer copy at the start, it is used if the last one is damaged
+	uint64_t footerPos[] = { file.GetSize() - sizeof(VhdFooter), 0 };
+	for (int i = 0; i < 2; i++)
+	{
+		if (!file.Read(footerPos[i], &footer, sizeof(footer))
+			|| (memcmp(footer.Cookie, VHD_COOKIE, sizeof(VHD_COOKIE)) != 0))
+			continue;
+
+		uint32_t checksum = 0;
+		const uint8_t* footerBytes = (const uint8_t*) &footer;
+		for (size_t n = 0; n < sizeof(footer); n++)
+		{
+			if (n < offsetof(VhdFooter, Checksum) || n >= offsetof(VhdFooter, Checksum) + sizeof(footer.Checksum))
+				checksum += footerBytes[n];
+		}
+
+		if (~checksum == be32(footer.Checksum))
+			return true;
+	}
+
+	return false;
+}
+
+// Whole disk is stored as is, followed by footer
+class CFixedVhdImage : public CVirtualDiskImage
+{
+protected:
+	virtual bool readBlock(uint64_t blockIndex, uint32_t blockOffset, uint8_t* buf, uint32_t size)
+	{
+		return m_File.Read(blockIndex * m_nBlockSize + blockOffset, buf, size);
+	}
+
+public:
+	virtual bool Open(const wchar_t* path)
+	{
+		VhdFooter footer;
+		if (!m_File.Open(path) || !readVhdFooter(m_File, footer) || (be32(footer.DiskType) != VHD_TYPE_FIXED))
+			return false;
+
+		m_nDiskSize = be64(footer.CurrentSize);
+		m_nBlockSize = 1024 * 1024;  // Only used to split long reads
+
+		return (m_nDiskSize > 0) && (m_nDiskSize <= m_File.GetSize() - sizeof(VhdFooter));
+	}
+
+	virtual const wchar_t* GetFormatName() const { return L"Microsoft Virtual Hard Disk"; }
+};
+
+// Each allocated block starts with sector bitmap, clear bits mean zero sectors
+class CDynamicVhdImage : public CVirtualDiskImage
+{
+private:
+	std::vector<uint32_t> m_vBat;  // Sector of block start, already in host byte order
+	uint32_t m_nBitmapSize;
+	std::vector<uint8_t> m_vBitmap;
+	uint64_t m_nBitmapBlock;
+
+	bool loadBitmap(uint64_t blockIndex)
+	{
+		if (m_nBitmapBlock == blockIndex)
+			return true;
+
+		m_nBitmapBlock = UINT64_MAX;
+		if (!m_File.Read((uint64_t) m_vBat[(size_t) blockIndex] * SECTOR_SIZE, m_vBitmap.data(), m_vBitmap.size()))
+			return false;
+
+		m_nBitmapBlock = blockIndex;
+		return true;
+	}
+
+	bool isSectorPresent(uint32_t sectorIndex) const
+	{
+		return (m_vBitmap[sectorIndex / 8] & (0x80 >> (sectorIndex % 8))) != 0;
+	}
+
+protected:
+	virtual bool readBlock(uint64_t blockIndex, uint32_t blockOffset, uint8_t* buf, uint32_t size)
+	{
+		if (m_vBat[(size_t) blockIndex] == VHD_UNUSED_BLOCK)
+		{
+			memset(buf, 0, size);
+			return true;
+		}
+
+		if (!loadBitmap(blockIndex))
+			return false;
+
+		uint64_t blockDataPos = (uint64_t) m_vBat[(size_t) blockIndex] * SECTOR_SIZE + m_nBitmapSize;
+
+		// Copy runs of sectors with the same bitmap state at once
+		while (size > 0)
+		{
+			uint32_t sectorIndex = blockOffset / SECTOR_SIZE;
+			bool fPresent = isSectorPresent(sectorIndex);
+
+			uint32_t runSize = std::min(size, (sectorIndex + 1) * SECTOR_SIZE - blockOffset);
+			while ((runSize < size) && (isSectorPresent(++sectorIndex) == fPresent))
+				runSize = std::min(size, runSize + SECTOR_SIZE);
+
+			if (fPresent)
+			{
+				if (!m_File.Read(blockDataPos + blockOffset, buf, runSize))
+					return false;
+			}
+			else
+			{
+				memset(buf, 0, runSize);
+			}
+
+			buf += runSize;
+			blockOffset += runSize;
+			size -= runSize;
+		}
+
+		return true;
+	}
+
+public:
+	CDynamicVhdImage() : m_nBitmapSize(0), m_nBitmapBlock(UINT64_MAX) {}
+
+	virtual bool Open(const wchar_t* path)
+	{
+		VhdFooter footer;
+		if (!m_File.Open(path) || !readVhdFooter(m_File, footer) || (be32(footer.DiskType) != VHD_TYPE_DYNAMIC))
+			return false;
+
+		VhdDynamicHeader header;
+		if (!m_File.Read(be64(footer.DataOffset), &header, sizeof(header))
+			|| (memcmp(header.Cookie, VHD_DYNAMIC_COOKIE, sizeof(VHD_DYNAMIC_COOKIE)) != 0))
+			return false;
+
+		m_nDiskSize = be64(footer.CurrentSize);
+		m_nBlockSize = be32(header.BlockSize);
+		if ((m_nDiskSize == 0) || (m_nBlockSize < SECTOR_SIZE) || !isPowerOfTwo(m_nBlockSize))
+			return false;
+
+		uint64_t numBlocks = (m_nDiskSize + m_nBlockSize - 1) / m_nBlockSize;
+		uint32_t maxTableEntries = be32(header.MaxTableEntries);
+		if ((maxTableEntries < numBlocks) || ((uint64_t) maxTableEntries * sizeof(uint32_t) > m_File.GetSize()))
+			return false;
+
+		m_vBat.resize((size_t) numBlocks);
+		if (!m_File.Read(be64(header.TableOffset), m_vBat.data(), m_vBat.size() * sizeof(uint32_t)))
+			return false;
+		for (size_t i = 0; i < m_vBat.size(); i++)
+			m_vBat[i] = be32(m_vBat[i]);
+
+		uint32_t bitmapBytes = m_nBlockSize / SECTOR_SIZE / 8;
+		m_nBitmapSize = ((bitmapBytes + SECTOR_SIZE - 1) / SECTOR_SIZE) * SECTOR_SIZE;
+		m_vBitmap.resize(std::max<uint32_t>(bitmapBytes, 1));
+
+		return true;
+	}
+
+	virtual const wchar_t* GetFormatName() const { return L"Microsoft Virtual Hard Disk"; }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+class CVhdxImage : public CVirtualDiskImage
+{
+private:
+	std::vector<uint64_t> m_vBat;
+	uint64_t m_nChunkRatio;
+
+	bool readHeader(VhdxHeader &header)
+	{
+		uint64_t bestSequence = 0;
+		bool fFound = false;
+
+		uint64_t headerPos[] = { VHDX_HEADER1_OFFSET, VHDX_HEADER2_OFFSET };
+		for (int i = 0; i < 2; i++)
+		{
+			std::vector<uint8_t> buf(VHDX_HEADER_SIZE);
+			if (!m_File.Read(headerPos[i], buf.data(), buf.size())
+				|| (memcmp(buf.data(), VHDX_HEADER_SIGNATURE, sizeof(VHDX_HEADER_SIGNATURE)) != 0)
+				|| !checkVhdxCrc(buf, offsetof(VhdxHeader, Checksum)))
+				continue;
+
+			// Header with greater sequence number is the current one
+			const VhdxHeader* hdr = (const VhdxHeader*) buf.data();
+			if (!fFound || (hdr->SequenceNumber > bestSequence))
+			{
+				header = *hdr;
+				bestSequence = hdr->SequenceNumber;
+				fFound = true;
+			}
+		}
+
+		return fFound;
+	}
+
+	bool findRegion(const GUID &regionId, uint64_t &offset, uint32_t &length)
+	{
+		std::vector<uint8_t> buf(VHDX_REGION_TABLE_SIZE);
+		for (int i = 0; i < 2; i++)
+		{
+			if (!m_File.Read(VHDX_REGION_TABLE_OFFSET + i * VHDX_REGION_TABLE_SIZE, buf.data(), buf.size())
+				|| (memcmp(buf.data(), VHDX_REGION_SIGNATURE, sizeof(VHDX_REGION_SIGNATURE)) != 0)
+				|| !checkVhdxCrc(buf, offsetof(VhdxRegionTableHeader, Checksum)))
+				continue;
+
+			const VhdxRegionTableHeader* hdr = (const VhdxRegionTableHeader*) buf.data();
+			size_t maxEntries = (buf.size() - sizeof(VhdxRegionTableHeader)) / sizeof(VhdxRegionTableEntry);
+			const VhdxRegionTableEntry* entries = (const VhdxRegionTableEntry*) (buf.data() + sizeof(VhdxRegionTableHeader));
+
+			for (size_t n = 0; n < std::min<size_t>(hdr->EntryCount, maxEntries); n++)
+			{
+				if (memcmp(&entries[n].Guid, &regionId, sizeof(GUID)) == 0)
+				{
+					offset = entries[n].FileOffset;
+					length = entries[n].Length;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		return false;
+	}
+
+	bool readMetadataItem(const std::vector<uint8_t> &metadata, const GUID &itemId, void* value, size_t valueSize)
+	{
+		const VhdxMetadataTableHeader* hdr = (const VhdxMetadataTableHeader*) metadata.data();
+		const VhdxMetadataTableEntry* entries = (const VhdxMetadataTableEntry*) (metadata.data() + sizeof(VhdxMetadataTableHeader));
+		size_t maxEntries = (std::min<size_t>(metadata.size(), 64 * 1024) - sizeof(VhdxMetadataTableHeader)) / sizeof(VhdxMetadataTableEntry);
+
+		for (size_t n = 0; n < std::min<size_t>(hdr->EntryCount, maxEntries); n++)
+		{
+			const VhdxMetadataTableEntry &entry = entries[n];
+			if (memcmp(&entry.ItemId, &itemId, sizeof(GUID)) != 0)
+				continue;
+
+			if ((entry.Length < valueSize) || (entry.Offset > metadata.size()) || (valueSize > metadata.size() - entry.Offset))
+				return false;
+
+			memcpy(value, &metadata[entry.Offset], valueSize);
+			return true;
+		}
+
+		return false;
+	}
+
+protected:
+	virtual bool readBlock(uint64_t blockIndex, uint32_t blockOffset, uint8_t* buf, uint32_t size)
+	{
+		// Sector bitmap entry follows every chunk of payload entries
+		uint64_t batEntry = m_vBat[(size_t) (blockIndex + blockIndex / m_nChunkRatio)];
+		if ((batEntry & 7) != VHDX_BLOCK_FULLY_PRESENT)
+		{
+			memset(buf, 0, size);
+			return true;
+		}
+
+		uint64_t blockPos = (batEntry >> 20) * 1024 * 1024;
+		return m_File.Read(blockPos + blockOffset, buf, size);
+	}
+
+public:
+	CVhdxImage() : m_nChunkRatio(0) {}
+
+	virtual bool Open(const wchar_t* path)
+	{
+		uint8_t signature[sizeof(VHDX_SIGNATURE)];
+		if (!m_File.Open(path) || !m_File.Read(0, signature, sizeof(signature))
+			|| (memcmp(signature, VHDX_SIGNATURE, sizeof(VHDX_SIGNATURE)) != 0))
+			return false;
+
+		// Pending log has to be replayed before data can be trusted, DiscUtils handles that
+		VhdxHeader header;
+		static const GUID nullGuid = { 0 };
+		if (!readHeader(header) || (header.Version != 1) || (memcmp(&header.LogGuid, &nullGuid, sizeof(GUID)) != 0))
+			return false;
+
+		uint64_t metaOffset, batOffset;
+		uint32_t metaLength, batLength;
+		if (!findRegion(VHDX_METADATA_GUID, metaOffset, metaLength) || !findRegion(VHDX_BAT_GUID, batOffset, batLength)
+			|| (metaLength < sizeof(VhdxMetadataTableHeader)) || (metaLength > m_File.GetSize()))
+			return false;
+
+		std::vector<uint8_t> metadata(metaLength);
+		if (!m_File.Read(metaOffset, metadata.data(), metadata.size())
+			|| (memcmp(metadata.data(), VHDX_METADATA_SIGNATURE, sizeof(VHDX_METADATA_SIGNATURE)) != 0))
+			return false;
+
+		uint32_t fileParams[2];
+		uint32_t logicalSectorSize;
+		if (!readMetadataItem(metadata, VHDX_FILE_PARAMS_GUID, fileParams, sizeof(fileParams))
+			|| !readMetadataItem(metadata, VHDX_DISK_SIZE_GUID, &m_nDiskSize, sizeof(m_nDiskSize))
+			|| !readMetadataItem(metadata, VHDX_SECTOR_SIZE_GUID, &logicalSectorSize, sizeof(logicalSectorSize)))
+			return false;
+
+		// Differencing disks need parent
+		m_nBlockSize = fileParams[0];
+		if ((fileParams[1] & VHDX_FLAG_HAS_PARENT) || (m_nDiskSize == 0) || !isPowerOfTwo(m_nBlockSize)
+			|| (logicalSectorSize != 512 && logicalSectorSize != 4096))
+			return false;
+
+		m_nChunkRatio = ((uint64_t) 1 << 23) * logicalSectorSize / m_nBlockSize;
+		if (m_nChunkRatio == 0)
+			return false;
+
+		uint64_t numBlocks = (m_nDiskSize + m_nBlockSize - 1) / m_nBlockSize;
+		uint64_t numEntries = numBlocks + (numBlocks - 1) / m_nChunkRatio;
+		if (numEntries * sizeof(uint64_t) > batLength)
+			return false;
+
+		m_vBat.resize((size_t) numEntries);
+		return m_File.Read(batOffset, m_vBat.data(), m_vBat.size() * sizeof(uint64_t));
+	}
+
+	virtual const wchar_t* GetFormatName() const { return L"Hyper-V virtual hard disk"; }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Monolithic sparse extent, grain tables are loaded on first access
+class CSparseVmdkImage : public CVirtualDiskImage
+{
+private:
+	std::vector<uint32_t> m_vGrainDir;
+	std::map<uint32_t, std::vector<uint32_t>> m_mGrainTables;
+	uint32_t m_nGrainsPerTable;
+
+	const std::vector<uint32_t>* getGrainTable(uint32_t tableIndex)
+	{
+		auto cit = m_mGrainTables.find(tableIndex);
+		if (cit != m_mGrainTables.end())
+			return &cit->second;
+
+		// Keep memory bounded for huge disks
+		if (m_mGrainTables.size() >= VMDK_MAX_CACHED_TABLES)
+			m_mGrainTables.clear();
+
+		std::vector<uint32_t> &table = m_mGrainTables[tableIndex];
+		table.resize(m_nGrainsPerTable);
+		if (!m_File.Read((uint64_t) m_vGrainDir[tableIndex] * SECTOR_SIZE, table.data(), table.size() * sizeof(uint32_t)))
+		{
+			m_mGrainTables.erase(tableIndex);
+			return nullptr;
+		}
+
+		return &table;
+	}
+
+protected:
+	virtual bool readBlock(uint64_t blockIndex, uint32_t blockOffset, uint8_t* buf, uint32_t size)
+	{
+		uint32_t tableIndex = (uint32_t) (blockIndex / m_nGrainsPerTable);
+		uint32_t grainSector = 0;
+
+		if (m_vGrainDir[tableIndex] != 0)
+		{
+			const std::vector<uint32_t>* table = getGrainTable(tableIndex);
+			if (!table)
+				return false;
+			grainSector = (*table)[(size_t) (blockIndex % m_nGrainsPerTable)];
+		}
+
+		if (grainSector <= VMDK_GRAIN_ZEROED)
+		{
+			memset(buf, 0, size);
+			return true;
+		}
+
+		return m_File.Read((uint64_t) grainSector * SECTOR_SIZE + blockOffset, buf, size);
+	}
+
+public:
+	CSparseVmdkImage() : m_nGrainsPerTable(0) {}
+
+	virtual bool Open(const wchar_t* path)
+	{
+		VmdkSparseHeader header;
+		if (!m_File.Open(path) || !m_File.Read(0, &header, sizeof(header)) || (header.MagicNumber != VMDK_MAGIC))
+			return false;
+
+		// Stream optimized images have compressed grains and directory at the end
+		if ((header.Flags & VMDK_FLAG_COMPRESSED) || (header.GdOffset == VMDK_GD_AT_END) || (header.GdOffset == 0)
+			|| (header.GrainSize < 1) || (header.GrainSize > 2048) || (header.NumGTEsPerGT == 0) || (header.NumGTEsPerGT > 4096)
+			|| (header.Capacity == 0))
+			return false;
+
+		// Extents of split images and child disks have to be assembled by DiscUtils
+		if ((header.DescriptorOffset == 0) || (header.DescriptorSize == 0) || (header.DescriptorSize > 2048))
+			return false;
+
+		std::string descText((size_t) header.DescriptorSize * SECTOR_SIZE, '\0');
+		if (!m_File.Read(header.DescriptorOffset * SECTOR_SIZE, &descText[0], descText.size()))
+			return false;
+		descText.resize(strlen(descText.c_str()));
+
+		size_t parentPos = descText.find("parentCID=");
+		if ((descText.find("createType=\"monolithicSparse\"") == std::string::npos)
+			|| ((parentPos != std::string::npos) && (descText.compare(parentPos, 18, "parentCID=ffffffff") != 0)))
+			return false;
+
+		m_nDiskSize = header.Capacity * SECTOR_SIZE;
+		m_nBlockSize = (uint32_t) header.GrainSize * SECTOR_SIZE;
+		m_nGrainsPerTable = header.NumGTEsPerGT;
+
+		uint64_t numGrains = header.Capacity / header.GrainSize + ((header.Capacity % header.GrainSize) ? 1 : 0);
+		uint64_t numTables = (numGrains + m_nGrainsPerTable - 1) / m_nGrainsPerTable;
+		if (numTables * sizeof(uint32_t) > m_File.GetSize())
+			return false;
+
+		m_vGrainDir.resize((size_t) numTables);
+		return m_File.Read(header.GdOffset * SECTOR_SIZE, m_vGrainDir.data(), m_vGrainDir.size() * sizeof(uint32_t));
+	}
+
+	virtual const wchar_t* GetFormatName() const { return L"VMWare Virtual Hard Disk"; }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+static CVirtualDiskImage* tryOpenImage(const wchar_t* path)
+{
+	CVirtualDiskImage* image = new T();
+	if (image->Open(path))
+		return image;
+
+	delete image;
+	return NULL;
+}
+
+CVirtualDiskImage* OpenNativeDiskImage(const wchar_t* path)
+{
+	CVirtualDiskImage* image = tryOpenImage<CVhdxImage>(path);
+	if (!image) image = tryOpenImage<CSparseVmdkImage>(path);
+	if (!image) image = tryOpenImage<CDynamicVhdImage>(path);
+	if (!image) image = tryOpenImage<CFixedVhdImage>(path);
+
+	return image;
+}
@@ -0,0 +1,62 @@
+#ifndef VirtualDiskImage_h__
+#define VirtualDiskImage_h__
+
+#include <stdint.h>
+
+// Read-only access to image file through sliding memory mapped view
+class CMappedImageFile
+{
+private:
+	HANDLE m_hFile;
+	HANDLE m_hMapping;
+	uint64_t m_nFileSize;
+	DWORD m_nGranularity;
+
+	const uint8_t* m_pView;
+	uint64_t m_nViewStart;
+	size_t m_nViewSize;
+
+	bool mapView(uint64_t offset);
+
+public:
+	CMappedImageFile();
+	~CMappedImageFile();
+
+	bool Open(const wchar_t* path);
+	void Close();
+
+	uint64_t GetSize() const { return m_nFileSize; }
+	bool Read(uint64_t offset, void* buf, size_t size);
+};
+
+// Guest data of virtual disk image, which is stored in fixed size blocks.
+// Block tables are loaded (or cached) in memory, data is copied from mapped file.
+// Object is not thread safe.
+class CVirtualDiskImage
+{
+protected:
+	CMappedImageFile m_File;
+	uint64_t m_nDiskSize;
+	uint32_t m_nBlockSize;
+
+	// Size never crosses block boundary
+	virtual bool readBlock(uint64_t blockIndex, uint32_t blockOffset, uint8_t* buf, uint32_t size) = 0;
+
+public:
+	CVirtualDiskImage() : m_nDiskSize(0), m_nBlockSize(0) {}
+	virtual ~CVirtualDiskImage() {}
+
+	virtual bool Open(const wchar_t* path) = 0;
+	virtual const wchar_t* GetFormatName() const = 0;
+
+	uint64_t GetDiskSize() const { return m_nDiskSize; }
+
+	// Unallocated areas are read as zeros
+	bool Read(uint64_t offset, void* buf, size_t size);
+};
+
+// Fixed and dynamic VHD, VHDX and monolithic sparse VMDK are supported.
+// Returns NULL for anything else (including differencing and compressed images).
+CVirtualDiskImage* OpenNativeDiskImage(const wchar_t* path);
+
+#endif // VirtualDiskImage_h__
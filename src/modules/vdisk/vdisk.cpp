@@ -6,6 +6,7 @@
 #include <msclr/marshal.h>
 #include "ModuleDef.h"
 #include "modulecrt/OptionsParser.h"
+#include "VirtualDiskImage.h"
 
 using namespace System;
 using namespace System::Collections::Generic;
@@ -16,6 +17,8 @@ using namespace DiscUtils;
 static int optDefaultCodepage = CP_OEMCP;
 static bool optDisplayErrorPopups = true;
 
+#define EXTRACT_BUFFER_SIZE (1024*1024)
+
 static void InitDiscUtils()
 {
 	Setup::SetupHelper::RegisterAssembly(Assembly::GetExecutingAssembly());
@@ -71,6 +74,100 @@ public:
 	}
 };
 
+ref class NativeImageReadException : IO::IOException
+{
+public:
+	NativeImageReadException() : IO::IOException("Virtual disk image read error") {}
+};
+
+// Natively parsed image is given to DiscUtils as raw disk data
+ref class NativeImageStream : IO::Stream
+{
+private:
+	CVirtualDiskImage* m_pImage;
+	Int64 m_nPosition;
+
+public:
+	NativeImageStream(CVirtualDiskImage* image)
+		: m_pImage(image), m_nPosition(0)
+	{
+		//
+	}
+
+	~NativeImageStream()
+	{
+		this->!NativeImageStream();
+	}
+
+	!NativeImageStream()
+	{
+		delete m_pImage;
+		m_pImage = NULL;
+	}
+
+	property bool CanRead { virtual bool get() override { return m_pImage != NULL; } }
+	property bool CanSeek { virtual bool get() override { return m_pImage != NULL; } }
+	property bool CanWrite { virtual bool get() override { return false; } }
+
+	property Int64 Length
+	{
+		virtual Int64 get() override
+		{
+			if (m_pImage == NULL) throw gcnew ObjectDisposedException("NativeImageStream");
+			return (Int64) m_pImage->GetDiskSize();
+		}
+	}
+
+	property Int64 Position
+	{
+		virtual Int64 get() override { return m_nPosition; }
+		virtual void set(Int64 value) override
+		{
+			if (value < 0) throw gcnew ArgumentOutOfRangeException("value");
+			m_nPosition = value;
+		}
+	}
+
+	virtual Int64 Seek(Int64 offset, IO::SeekOrigin origin) override
+	{
+		switch (origin)
+		{
+		case IO::SeekOrigin::Current:
+			offset += m_nPosition;
+			break;
+		case IO::SeekOrigin::End:
+			offset += Length;
+			break;
+		}
+
+		Position = offset;
+		return m_nPosition;
+	}
+
+	virtual int Read(array<Byte>^ buffer, int offset, int count) override
+	{
+		if (m_pImage == NULL) throw gcnew ObjectDisposedException("NativeImageStream");
+		if (buffer == nullptr) throw gcnew ArgumentNullException("buffer");
+		if (offset < 0 || count < 0 || offset > buffer->Length - count) throw gcnew ArgumentOutOfRangeException("count");
+
+		Int64 diskSize = (Int64) m_pImage->GetDiskSize();
+		if (count == 0 || m_nPosition >= diskSize)
+			return 0;
+
+		int readSize = (int) Math::Min((Int64) count, diskSize - m_nPosition);
+		pin_ptr<Byte> pDest = &buffer[offset];
+		if (!m_pImage->Read(m_nPosition, pDest, readSize))
+			throw gcnew NativeImageReadException();
+
+		m_nPosition += readSize;
+		return readSize;
+	}
+
+	virtual void Flush() override {}
+	virtual void SetLength(Int64) override { throw gcnew NotSupportedException(); }
+	virtual void Write(array<Byte>^, int, int) override { throw gcnew NotSupportedException(); }
+};
+
 struct VDisk
 {
 	gcroot<VirtualDisk^> pVdiskObj;
@@ -226,9 +323,21 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 {
 	String ^strPath = gcnew String(params.FilePath);
 	VirtualDisk ^vdisk;
+	const wchar_t* nativeFormatName = NULL;
 	try
 	{
-		vdisk = VirtualDisk::OpenDisk(strPath, IO::FileAccess::Read);
+		// Block tables of common formats are read natively, DiscUtils only parses volumes.
+		// Everything else (differencing disks, other formats) is opened by DiscUtils itself.
+		CVirtualDiskImage* nativeImage = OpenNativeDiskImage(params.FilePath);
+		if (nativeImage != NULL)
+		{
+			nativeFormatName = nativeImage->GetFormatName();
+			vdisk = gcnew Raw::Disk(gcnew NativeImageStream(nativeImage), Streams::Ownership::Dispose);
+		}
+		else
+		{
+			vdisk = VirtualDisk::OpenDisk(strPath, IO::FileAccess::Read);
+		}
 	}
 	catch (Exception^)
 	{
@@ -265,7 +374,7 @@ int MODULE_EXPORT OpenStorage(StorageOpenParams params, HANDLE *storage, Storage
 			*storage = vdObj;
 
 			memset(info, 0, sizeof(StorageGeneralInfo));
-			wcscpy_s(info->Format, STORAGE_FORMAT_NAME_MAX_LEN, GetDiskType(vdisk));
+			wcscpy_s(info->Format, STORAGE_FORMAT_NAME_MAX_LEN, nativeFormatName ? nativeFormatName : GetDiskType(vdisk));
 			wcscpy_s(info->Comment, STORAGE_PARAM_MAX_LEN, L"-");
 			wcscpy_s(info->Compression, STORAGE_PARAM_MAX_LEN, L"None");
 
@@ -403,7 +512,8 @@ int MODULE_EXPORT ExtractItem(HANDLE storage, ExtractOperationParams params)
 
 		try
 		{
-			int copyBufSize = 32 * 1024;
+			// Small files do not need whole buffer, large ones are copied in fewer managed calls
+			int copyBufSize = (int) Math::Min(dfi->Length, (Int64) EXTRACT_BUFFER_SIZE);
 			array<Byte> ^copyBuf = gcnew array<Byte>(copyBufSize);
 
 			Int64 bytesLeft = dfi->Length;
@@ -437,7 +547,7 @@ int MODULE_EXPORT ExtractItem(HANDLE storage, ExtractOperationParams params)
 	}
 	catch (Exception^ ex)
 	{
-		if (String::Compare(ex->Source, "DiscUtils", true) == 0)
+		if (String::Compare(ex->Source, "DiscUtils", true) == 0 || dynamic_cast<NativeImageReadException^>(ex) != nullptr)
 			result = SER_ERROR_READ;
 		else
 			result = SER_ERROR_WRITE;
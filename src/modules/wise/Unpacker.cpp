@@ -160,6 +160,165 @@ bool inflateData(HANDLE inFile, IAbstractWriter* writer, InflatedDataInfo &info)
 	return false;
 }
 
+bool inflateData(CBufferedReader &reader, IAbstractWriter* writer, InflatedDataInfo &info)
+{
+	int ret;
+	unsigned int have;
+	unsigned char buf_out[BSIZE];
+
+	z_stream strm = {0};
+	ret = inflateInit2(&strm, -15);
+	if (ret != Z_OK) return false;
+
+	info.crc = crc32(0L, Z_NULL, 0);
+	info.packedSize = 0;
+	info.unpackedSize = 0;
+
+	/* decompress until deflate stream ends or end of file */
+	do
+	{
+		size_t available = 0;
+		const unsigned char* buf_in = reader.Peek(available);
+		if (!buf_in)
+		{
+			ret = Z_ERRNO;
+			break;
+		}
+
+		strm.next_in = (Bytef*) buf_in;
+		strm.avail_in = (uInt) available;
+		do
+		{
+			strm.avail_out = BSIZE;
+			strm.next_out = buf_out;
+
+			ret = inflate(&strm, Z_NO_FLUSH);
+			if (ret == Z_NEED_DICT)
+				ret = Z_DATA_ERROR;
+			if (ret < 0) break;
+
+			have = BSIZE - strm.avail_out;
+			if (have == 0) break;
+
+			if (writer != NULL && !writer->SaveData(buf_out, have))
+			{
+				ret = Z_ERRNO;
+				break;
+			}
+			info.crc = crc32(info.crc, buf_out, have);
+			info.unpackedSize += have;
+
+		} while (strm.avail_out == 0 && ret != Z_STREAM_END);
+
+		// Consumed input stays behind, so on stream end reader points right after packed data
+		size_t consumed = available - strm.avail_in;
+		reader.Skip(consumed);
+		info.packedSize += (unsigned int) consumed;
+
+	} while (ret != Z_STREAM_END && (ret >= 0 || ret == Z_BUF_ERROR));
+
+	inflateEnd(&strm);
+
+	return (ret == Z_STREAM_END);
+}
+
+bool inflateData(CBufferedReader &reader, char* &memBuf, size_t &memBufSize, InflatedDataInfo &info)
+{
+	MemoryWriter writer;
+	bool rval = inflateData(reader, &writer, info);
+
+	memBufSize = writer.GetDataSize();
+	if (memBufSize > 0)
+	{
+		memBuf = (char *) malloc(memBufSize);
+		memcpy(memBuf, writer.GetData(), memBufSize);
+	}
+
+	return rval;
+}
+
+bool inflateData(CBufferedReader &reader, InflatedDataInfo &info)
+{
+	return inflateData(reader, NULL, info);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CBufferedReader::CBufferedReader( HANDLE hFile, size_t bufSize )
+	: m_hFile(hFile), m_nBufSize(bufSize), m_nDataSize(0), m_nDataPos(0), m_nBufStart(0)
+{
+	m_pBuf = (unsigned char*) malloc(bufSize);
+}
+
+CBufferedReader::~CBufferedReader()
+{
+	free(m_pBuf);
+}
+
+void CBufferedReader::SetPos( int64_t pos )
+{
+	if ((pos >= m_nBufStart) && (pos <= m_nBufStart + (int64_t) m_nDataSize))
+	{
+		m_nDataPos = (size_t) (pos - m_nBufStart);
+	}
+	else
+	{
+		m_nBufStart = pos;
+		m_nDataSize = 0;
+		m_nDataPos = 0;
+	}
+}
+
+const unsigned char* CBufferedReader::Peek( size_t &available )
+{
+	available = 0;
+	if (!m_pBuf) return NULL;
+
+	if (m_nDataPos >= m_nDataSize)
+	{
+		// File pointer may be moved by others, so always seek before read
+		LARGE_INTEGER nReadPos;
+		nReadPos.QuadPart = GetPos();
+
+		DWORD dwRead = 0;
+		if (!SetFilePointerEx(m_hFile, nReadPos, NULL, FILE_BEGIN)
+			|| !ReadFile(m_hFile, m_pBuf, (DWORD) m_nBufSize, &dwRead, NULL) || (dwRead == 0))
+			return NULL;
+
+		m_nBufStart = nReadPos.QuadPart;
+		m_nDataSize = dwRead;
+		m_nDataPos = 0;
+	}
+
+	available = m_nDataSize - m_nDataPos;
+	return m_pBuf + m_nDataPos;
+}
+
+bool CBufferedReader::Read( void* buf, size_t size )
+{
+	int64_t startPos = GetPos();
+	unsigned char* bufPtr = (unsigned char*) buf;
+	while (size > 0)
+	{
+		size_t available;
+		const unsigned char* data = Peek(available);
+		if (!data)
+		{
+			SetPos(startPos);
+			return false;
+		}
+
+		size_t copySize = min(size, available);
+		memcpy(bufPtr, data, copySize);
+		Skip(copySize);
+		bufPtr += copySize;
+		size -= copySize;
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 bool inflateData(HANDLE inFile, char* &memBuf, size_t &memBufSize, InflatedDataInfo &info)
 {
 	MemoryWriter* writer = new MemoryWriter();
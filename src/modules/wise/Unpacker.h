@@ -8,7 +8,36 @@ struct InflatedDataInfo
 	unsigned long crc;
 };
 
+// Forward reader with large buffer, lets file list be built in one sequential pass.
+// Short seeks inside the buffer do not touch the file.
+class CBufferedReader
+{
+private:
+	HANDLE m_hFile;
+	unsigned char* m_pBuf;
+	size_t m_nBufSize;
+	size_t m_nDataSize;
+	size_t m_nDataPos;
+	int64_t m_nBufStart;
+
+public:
+	CBufferedReader(HANDLE hFile, size_t bufSize);
+	~CBufferedReader();
+
+	int64_t GetPos() const { return m_nBufStart + (int64_t) m_nDataPos; }
+	void SetPos(int64_t pos);
+
+	// Returns pointer to next portion of data, refills buffer when needed
+	const unsigned char* Peek(size_t &available);
+	void Skip(size_t size) { m_nDataPos += size; }
+	bool Read(void* buf, size_t size);
+};
+
 bool inflateData(HANDLE inFile, char* &memBuf, size_t &memBufSize, InflatedDataInfo &info);
 bool inflateData(HANDLE inFile, const wchar_t* outFileName, InflatedDataInfo &info);
 
+// Reader is positioned right after packed data on success
+bool inflateData(CBufferedReader &reader, char* &memBuf, size_t &memBufSize, InflatedDataInfo &info);
+bool inflateData(CBufferedReader &reader, InflatedDataInfo &info);
+
 #endif // Unpacker_h__
\ No newline at end of file
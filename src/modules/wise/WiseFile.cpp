@@ -3,6 +3,10 @@
 #include "Unpacker.h"
 
 #define ZIP_FILE_HEADER 0x04034b50
+#define ZIP_CENTRAL_DIR_HEADER 0x02014b50
+#define ZIP_FLAG_DATA_DESCRIPTOR 0x08
+
+#define READ_BUFFER_SIZE (1024 * 1024)
 
 static bool IsScriptBuffer(const char* buf)
 {
@@ -18,6 +22,7 @@ static bool IsScriptBuffer(const char* buf)
 CWiseFile::CWiseFile()
 {
 	m_hSourceFile = INVALID_HANDLE_VALUE;
+	m_pReader = NULL;
 	m_nFilesStartPos = 0;
 	m_fIsPkZip = false;
 	m_pScriptBuf = NULL;
@@ -28,6 +33,8 @@ CWiseFile::CWiseFile()
 
 CWiseFile::~CWiseFile()
 {
+	if (m_pReader != NULL)
+		delete m_pReader;
 	if (m_hSourceFile != INVALID_HANDLE_VALUE)
 		CloseHandle(m_hSourceFile);
 	if (m_pScriptBuf != NULL)
@@ -51,6 +58,7 @@ bool CWiseFile::Open( const wchar_t* filePath )
 		{
 			m_nFilesStartPos = fIsPkzip ? nApproxOffset : nRealOffset;
 			m_fIsPkZip = fIsPkzip;
+			m_pReader = new CBufferedReader(m_hSourceFile, READ_BUFFER_SIZE);
 			return true;
 		}
 	}
@@ -77,58 +85,78 @@ bool CWiseFile::GetFileInfo( int index, WiseFileRec* infoBuf, bool &noMoreItems
 		if (i > 0)
 			nFilePos = (int) m_vFileList[i-1].EndOffset + 1;
 
-		if (SetFilePointer(m_hSourceFile, nFilePos, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER)
-			return false;
+		m_pReader->SetPos(nFilePos);
 
-		DWORD dwRead;
-		unsigned long newcrc;
+		unsigned long newcrc = 0;
+		bool fSizeFromHeader = false;
+		InflatedDataInfo inflateInfo;
+
+		int eFileType = (i < SFT_Other) ? i + m_nFileTypeOffset : SFT_Other;
+		char *scriptBuf = NULL;
+		size_t scriptSize = 0;
 
 		if (m_fIsPkZip)
 		{
-			char buf1[14], buf2[8];
+			char buf1[14];
+			uint32_t packedSize, unpackedSize;
 			unsigned short len1, len2;
 
-			if (!ReadFile(m_hSourceFile, buf1, sizeof(buf1), &dwRead, NULL)
-				|| !ReadFile(m_hSourceFile, &newcrc, sizeof(newcrc), &dwRead, NULL)
-				|| !ReadFile(m_hSourceFile, buf2, sizeof(buf2), &dwRead, NULL)
-				|| !ReadFile(m_hSourceFile, &len1, sizeof(len1), &dwRead, NULL)
-				|| !ReadFile(m_hSourceFile, &len2, sizeof(len2), &dwRead, NULL))
+			if (!m_pReader->Read(buf1, sizeof(buf1))
+				|| !m_pReader->Read(&newcrc, sizeof(newcrc))
+				|| !m_pReader->Read(&packedSize, sizeof(packedSize))
+				|| !m_pReader->Read(&unpackedSize, sizeof(unpackedSize))
+				|| !m_pReader->Read(&len1, sizeof(len1))
+				|| !m_pReader->Read(&len2, sizeof(len2)))
 			{
 				fResult = false;
 				break;
 			}
 
-			if (len1 + len2 > 0)
-				SetFilePointer(m_hSourceFile, len1 + len2, NULL, FILE_CURRENT);
-		}
+			int64_t nDataPos = m_pReader->GetPos() + len1 + len2;
 
-		int eFileType = (i < SFT_Other) ? i + m_nFileTypeOffset : SFT_Other;
-		char *scriptBuf = NULL;
-		size_t scriptSize = 0;
+			// Sizes from local header let us skip inflating regular files,
+			// trust them only if next header starts right after packed data
+			unsigned short nZipFlags = *(unsigned short*)(buf1 + 6);
+			if ((eFileType > SFT_Script) && !(nZipFlags & ZIP_FLAG_DATA_DESCRIPTOR) && (packedSize > 0))
+			{
+				uint32_t nextSig = 0;
+				m_pReader->SetPos(nDataPos + packedSize);
+				if (m_pReader->Read(&nextSig, sizeof(nextSig)) && (nextSig == ZIP_FILE_HEADER || nextSig == ZIP_CENTRAL_DIR_HEADER))
+				{
+					inflateInfo.packedSize = packedSize;
+					inflateInfo.unpackedSize = unpackedSize;
+					inflateInfo.crc = newcrc;
+					fSizeFromHeader = true;
+				}
+			}
 
-		InflatedDataInfo inflateInfo;
-		bool inflRes;
-		if (eFileType <= SFT_Script)
-			inflRes = inflateData(m_hSourceFile, scriptBuf, scriptSize, inflateInfo);
-		else
-			inflRes = inflateData(m_hSourceFile, NULL, inflateInfo);
+			m_pReader->SetPos(fSizeFromHeader ? nDataPos + packedSize : nDataPos);
+		}
+
+		bool inflRes = fSizeFromHeader;
+		if (!fSizeFromHeader)
+		{
+			if (eFileType <= SFT_Script)
+				inflRes = inflateData(*m_pReader, scriptBuf, scriptSize, inflateInfo);
+			else
+				inflRes = inflateData(*m_pReader, inflateInfo);
+		}
 		
 		if (inflRes)
 		{
 			int attempt = 0;
 
-			if (!m_fIsPkZip)
-				ReadFile(m_hSourceFile, &newcrc, sizeof(newcrc), &dwRead, NULL);
-
-			while ((inflateInfo.crc != newcrc) && (attempt < 8) && (dwRead == sizeof(newcrc)))
+			// In plain Wise archive CRC follows packed data, sometimes with few bytes of padding
+			bool fCrcRead = !m_fIsPkZip && m_pReader->Read(&newcrc, sizeof(newcrc));
+			while (fCrcRead && (inflateInfo.crc != newcrc) && (attempt < 8))
 			{
-				SetFilePointer(m_hSourceFile, -3, NULL, FILE_CURRENT);
-				ReadFile(m_hSourceFile, &newcrc, sizeof(newcrc), &dwRead, NULL);
+				m_pReader->SetPos(m_pReader->GetPos() - 3);
+				fCrcRead = m_pReader->Read(&newcrc, sizeof(newcrc));
 				inflateInfo.packedSize += 1;  // 4 (already read crc) - 3 (back-shift)
 				attempt++;
 			}
 			if (attempt >= 8)
-				SetFilePointer(m_hSourceFile, - ((int) attempt), NULL, FILE_CURRENT);
+				m_pReader->SetPos(m_pReader->GetPos() - attempt);
 						
 			// If we have valid file entry, add it to list
 			if (inflateInfo.crc == newcrc)
@@ -143,7 +171,7 @@ bool CWiseFile::GetFileInfo( int index, WiseFileRec* infoBuf, bool &noMoreItems
 				infoBuf->UnpackedSize = inflateInfo.unpackedSize;
 				infoBuf->StartOffset = nFilePos;
 				infoBuf->CRC32 = inflateInfo.crc;
-				infoBuf->EndOffset = SetFilePointer(m_hSourceFile, 0, NULL, FILE_CURRENT) - 1;
+				infoBuf->EndOffset = m_pReader->GetPos() - 1;
 				
 				switch(eFileType)
 				{
@@ -366,7 +394,7 @@ bool CWiseFile::ExtractFile( int index, const wchar_t* destPath )
 	}
 
 	bool rval = inflateData(m_hSourceFile, destPath, inflateInfo);
-	return rval;
+	return rval && (inflateInfo.crc == fileInfo.CRC32);
 }
 
 // Suspected file opcode structure
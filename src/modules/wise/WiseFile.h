@@ -3,10 +3,13 @@
 
 #include "BaseWiseFile.h"
 
+class CBufferedReader;
+
 class CWiseFile : public CBaseWiseFile
 {
 private:
 	HANDLE m_hSourceFile;
+	CBufferedReader* m_pReader;
 	int m_nFilesStartPos;
 	std::vector<WiseFileRec> m_vFileList;
 	bool m_fIsPkZip;
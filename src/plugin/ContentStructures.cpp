@@ -29,6 +29,9 @@ void ContentTreeNode::Init( int item_index, StorageItemInfo* item_info )
 {
 	parent = NULL;
 	StorageIndex = item_index;
+	DataVolume = item_info->DataVolume;
+	DataPosition = item_info->DataPosition;
+	DataFlags = item_info->DataFlags;
 	m_strName = ExtractFileName(item_info->Path);
 	m_nSize = item_info->Size;
 	m_nPackedSize = item_info->PackedSize;
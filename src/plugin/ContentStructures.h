@@ -27,6 +27,9 @@ private:
 
 public:
 	int StorageIndex;
+	int DataVolume;
+	__int64 DataPosition;
+	DWORD DataFlags;
 	FILETIME LastModificationTime;
 	FILETIME CreationTime;
 	
@@ -9,6 +9,7 @@ ExternalModule::ExternalModule(const std::wstring& Name, const std::wstring& Lib
 	m_hModuleHandle = NULL;
 	
 	m_nModuleVersion = 0;
+	m_nCapabilities = 0;
 	m_ModuleId = GUID_NULL;
 	memset(&ModuleFunctions, 0, sizeof(ModuleFunctions));
 	ShortCut = '\0';
@@ -58,6 +59,7 @@ bool ExternalModule::Load(const wchar_t* basePath, const wchar_t* moduleSettings
 						ModuleFunctions = loadParams.ApiFuncs;
 						m_ModuleId = loadParams.ModuleId;
 						m_nModuleVersion = loadParams.ModuleVersion;
+						m_nCapabilities = loadParams.Capabilities;
 					}
 				}
 				else
@@ -104,6 +106,7 @@ void ExternalModule::Unload()
 	m_pUnloadModule = nullptr;
 	m_hModuleHandle = NULL;
 	m_nModuleVersion = 0;
+	m_nCapabilities = 0;
 	
 	m_ModuleId = GUID_NULL;
 	memset(&ModuleFunctions, 0, sizeof(ModuleFunctions));
@@ -37,6 +37,7 @@ struct ExternalModule
 
 	const wchar_t* Name() const { return m_sModuleName.c_str(); }
 	const wchar_t* LibraryFile() const { return m_sLibraryFile.c_str(); }
+	bool HasCapability(DWORD cap) const { return (m_nCapabilities & cap) != 0; }
 
 private:
 	std::wstring m_sModuleName;
@@ -49,6 +50,7 @@ private:
 	
 	GUID m_ModuleId;
 	DWORD m_nModuleVersion;
+	DWORD m_nCapabilities;
 
 	ExtensionsFilter m_pExtensionFilter;
 
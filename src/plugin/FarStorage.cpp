@@ -20,6 +20,13 @@ StorageObject::StorageObject( ModulesController *modules, PasswordQueryCallbackF
 
 	m_fnPassCallback = PassCallback;
 
+	m_wszDataFile = NULL;
+	m_nDataOffset = 0;
+	m_nDataSize = 0;
+	m_hDataFile = INVALID_HANDLE_VALUE;
+	m_nStreamPos = 0;
+	memset(&m_StreamCallbacks, 0, sizeof(m_StreamCallbacks));
+
 	memset(&GeneralInfo, 0, sizeof(GeneralInfo));
 }
 
@@ -37,17 +44,63 @@ bool StorageObject::Open( const wchar_t* path, const void* data, size_t dataSize
 {
 	Close();
 	
-	int moduleIndex = 0;
-	HANDLE storagePtr = NULL;
-	char passBuf[100] = {0};
-
 	OpenStorageFileInParams srcParams = {0};
 	srcParams.path = path;
 	srcParams.applyExtFilters = applyExtFilters;
 	srcParams.openWithModule = openWithModule;
 	srcParams.dataBuffer = data;
 	srcParams.dataSize = dataSize;
-	
+
+	return OpenInternal(srcParams);
+}
+
+bool StorageObject::CanOpenNested( const ContentTreeNode* item )
+{
+	return item && !item->IsDir() && (item->DataFlags & ITEM_DATA_CONTIGUOUS)
+		&& item->DataVolume == 0 && item->DataPosition > 0 && item->GetSize() > 0;
+}
+
+bool StorageObject::OpenNested( const StorageObject* parent, const ContentTreeNode* item, bool applyExtFilters )
+{
+	Close();
+
+	if (!CanOpenNested(item)) return false;
+
+	m_hDataFile = CreateFile(parent->DataFilePath(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_hDataFile == INVALID_HANDLE_VALUE) return false;
+
+	m_wszDataFile = _wcsdup(parent->DataFilePath());
+	m_nDataOffset = parent->m_nDataOffset + item->DataPosition;
+	m_nDataSize = item->GetSize();
+	m_nStreamPos = 0;
+
+	m_StreamCallbacks.Context = this;
+	m_StreamCallbacks.Read = StreamRead;
+	m_StreamCallbacks.Seek = StreamSeek;
+
+	// Virtual path keeps item name, so extension filters and panel title work as for real file
+	std::wstring strPath = parent->StoragePath();
+	strPath.append(L"\\").append(item->GetPath());
+
+	OpenStorageFileInParams srcParams = {0};
+	srcParams.path = strPath.c_str();
+	srcParams.applyExtFilters = applyExtFilters;
+	srcParams.openWithModule = -1;
+	srcParams.stream = &m_StreamCallbacks;
+
+	if (OpenInternal(srcParams))
+		return true;
+
+	Close();
+	return false;
+}
+
+bool StorageObject::OpenInternal( OpenStorageFileInParams &srcParams )
+{
+	int moduleIndex = 0;
+	HANDLE storagePtr = NULL;
+	char passBuf[100] = {0};
+
 	int retVal = m_pModules->OpenStorageFile(srcParams, &moduleIndex, &storagePtr, &GeneralInfo);
 	
 	// If some module requested password, then try to request it from user and try to open file again
@@ -89,6 +142,19 @@ void StorageObject::Close()
 		free(m_wszStoragePath);
 		m_wszStoragePath = NULL;
 	}
+	if (m_hDataFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hDataFile);
+		m_hDataFile = INVALID_HANDLE_VALUE;
+	}
+	if (m_wszDataFile)
+	{
+		free(m_wszDataFile);
+		m_wszDataFile = NULL;
+	}
+	m_nDataOffset = 0;
+	m_nDataSize = 0;
+	m_nStreamPos = 0;
 
 	if (m_pRootDir)
 	{
@@ -111,7 +177,7 @@ void StorageObject::Close()
 	m_vItems.clear();
 }
 
-ListReadResult StorageObject::ReadFileList()
+ListReadResult StorageObject::ReadFileList(ListProgressCallbackFunc progressCallback, void* progressContext)
 {
 	bool fListOK = true;
 
@@ -166,7 +232,8 @@ ListReadResult StorageObject::ReadFileList()
 		}
 
 		// Check for user abort
-		if (CheckEsc())
+		bool fContinue = progressCallback ? progressCallback(progressContext, item_index + 1) : !CheckEsc();
+		if (!fContinue)
 		{
 			return ListReadResult::Aborted;
 		}
@@ -194,6 +261,56 @@ ListReadResult StorageObject::ReadFileList()
 	return ListReadResult::ItemError;
 }
 
+BOOL CALLBACK StorageObject::StreamRead( HANDLE context, void* buffer, size_t size, size_t* bytesRead )
+{
+	StorageObject* storage = (StorageObject*) context;
+	if (bytesRead) *bytesRead = 0;
+
+	__int64 nLeft = storage->m_nDataSize - storage->m_nStreamPos;
+	if (nLeft <= 0 || size == 0) return TRUE;
+	if ((__int64) size > nLeft) size = (size_t) nLeft;
+
+	LARGE_INTEGER liPos;
+	liPos.QuadPart = storage->m_nDataOffset + storage->m_nStreamPos;
+	if (!SetFilePointerEx(storage->m_hDataFile, liPos, NULL, FILE_BEGIN))
+		return FALSE;
+
+	// ReadFile takes DWORD size, so large requests are split
+	size_t nDone = 0;
+	while (nDone < size)
+	{
+		DWORD nChunk = (DWORD) min(size - nDone, (size_t) 0x10000000);
+		DWORD nRead = 0;
+		if (!ReadFile(storage->m_hDataFile, (char*) buffer + nDone, nChunk, &nRead, NULL))
+			return FALSE;
+		if (nRead == 0) break;
+		nDone += nRead;
+	}
+
+	storage->m_nStreamPos += nDone;
+	if (bytesRead) *bytesRead = nDone;
+	return TRUE;
+}
+
+BOOL CALLBACK StorageObject::StreamSeek( HANDLE context, __int64 distance, int origin, __int64* newPosition )
+{
+	StorageObject* storage = (StorageObject*) context;
+
+	__int64 nBase;
+	switch (origin)
+	{
+		case FILE_BEGIN: nBase = 0; break;
+		case FILE_CURRENT: nBase = storage->m_nStreamPos; break;
+		case FILE_END: nBase = storage->m_nDataSize; break;
+		default: return FALSE;
+	}
+	if (nBase + distance < 0) return FALSE;
+
+	storage->m_nStreamPos = nBase + distance;
+	if (newPosition) *newPosition = storage->m_nStreamPos;
+	return TRUE;
+}
+
 int StorageObject::Extract( ExtractOperationParams &params )
 {
 	const ExternalModule* module = m_pModules->GetModule(m_nModuleIndex);
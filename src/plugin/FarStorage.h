@@ -5,6 +5,9 @@
 #include "ContentStructures.h"
 
 typedef bool(*PasswordQueryCallbackFunc)(char*, size_t);
+// Called for every listed item with number of items read so far, returns false to abort listing.
+// Called on the thread which runs ReadFileList.
+typedef bool(*ListProgressCallbackFunc)(void*, int);
 
 enum class ListReadResult
 {
@@ -39,6 +42,19 @@ private:
 
 	PasswordQueryCallbackFunc m_fnPassCallback;
 
+	// Nested storages are read from raw range of the parent file through stream
+	wchar_t *m_wszDataFile;
+	__int64 m_nDataOffset;
+	__int64 m_nDataSize;
+	HANDLE m_hDataFile;
+	__int64 m_nStreamPos;
+	StorageStreamCallbacks m_StreamCallbacks;
+
+	bool OpenInternal(OpenStorageFileInParams &srcParams);
+
+	static BOOL CALLBACK StreamRead(HANDLE context, void* buffer, size_t size, size_t* bytesRead);
+	static BOOL CALLBACK StreamSeek(HANDLE context, __int64 distance, int origin, __int64* newPosition);
+
 public:
 	StorageGeneralInfo GeneralInfo;
 	
@@ -47,7 +63,9 @@ public:
 
 	bool Open(const wchar_t* path, bool applyExtFilters, int openWithModule);
 	bool Open(const wchar_t* path, const void* data, size_t dataSize, bool applyExtFilters, int openWithModule);
-	ListReadResult ReadFileList();
+	// Opens item of the parent storage as storage without extraction
+	bool OpenNested(const StorageObject* parent, const ContentTreeNode* item, bool applyExtFilters);
+	ListReadResult ReadFileList(ListProgressCallbackFunc progressCallback = nullptr, void* progressContext = nullptr);
 	void Close();
 
 	int Extract(ExtractOperationParams &params);
@@ -57,10 +75,15 @@ public:
 	const wchar_t* GetModuleName() const { return (m_nModuleIndex >= 0) ? m_pModules->GetModule(m_nModuleIndex)->Name() : NULL; }
 	int GetModuleIndex() const { return m_nModuleIndex; }
 	const wchar_t* StoragePath() const { return m_wszStoragePath; }
+	// Real file on disk, which contains storage data (differs from StoragePath for nested storages)
+	const wchar_t* DataFilePath() const { return m_wszDataFile ? m_wszDataFile : m_wszStoragePath; }
+	bool IsNested() const { return m_wszDataFile != NULL; }
 	__int64 TotalSize() const { return m_nTotalSize; }
 	__int64 TotalPackedSize() const { return m_nTotalPackedSize; }
 	int NumFiles() const { return m_nNumFiles; }
 	int NumDirectories() const { return m_nNumDirectories; }
+
+	static bool CanOpenNested(const ContentTreeNode* item);
 };
 
 #endif // FarStorage_h__
\ No newline at end of file
@@ -24,6 +24,107 @@ std::wstring GetFinalExtractionPath(const StorageObject* storage, const ContentT
 	return strResult;
 }
 
+static std::wstring UpperCasePath(const std::wstring &path)
+{
+	std::wstring strResult(path);
+	if (!strResult.empty())
+		CharUpperBuffW(&strResult[0], (DWORD) strResult.length());
+	return strResult;
+}
+
+ExtractDirCache::ExtractDirCache(const std::wstring &rootPath)
+{
+	std::wstring strRoot(rootPath);
+	IncludeTrailingPathDelim(strRoot);
+	strRoot = GetDirectoryName(strRoot, false);
+
+	if (!strRoot.empty())
+	{
+		DirEntry &entry = m_mDirs[UpperCasePath(strRoot)];
+		entry.Path = strRoot;
+		entry.IsCreated = true;
+	}
+}
+
+void ExtractDirCache::AddDir(const std::wstring &dirPath)
+{
+	// Add all missing parents as well, stop on the first known one
+	std::wstring strPath(dirPath);
+	while (!strPath.empty())
+	{
+		DirEntry &entry = m_mDirs[UpperCasePath(strPath)];
+		if (!entry.Path.empty()) break;
+		entry.Path = strPath;
+
+		std::wstring strParent = GetDirectoryName(strPath, false);
+		if (strParent.length() >= strPath.length()) break;
+		strPath = strParent;
+	}
+}
+
+bool ExtractDirCache::EnsureDir(const std::wstring &dirPath)
+{
+	DirEntry* entry = FindDir(dirPath);
+	if (!entry) return false;
+	if (entry->IsCreated) return true;
+
+	// Parents are planned too, so they are created first and only one level is left here
+	std::wstring strParent = GetDirectoryName(entry->Path, false);
+	if ((strParent.length() < entry->Path.length()) && FindDir(strParent) && !EnsureDir(strParent))
+		return false;
+
+	bool fCreated = !IsDiskRoot(entry->Path.c_str()) && CreateDirectoryW(entry->Path.c_str(), NULL);
+	if (!fCreated)
+	{
+		DWORD dwAttr = GetFileAttributesW(entry->Path.c_str());
+		if ((dwAttr == INVALID_FILE_ATTRIBUTES) || !(dwAttr & FILE_ATTRIBUTE_DIRECTORY))
+			return false;
+	}
+
+	entry->IsNew = fCreated;
+	entry->IsCreated = true;
+	return true;
+}
+
+ExtractDirCache::DirEntry* ExtractDirCache::FindDir(const std::wstring &dirPath)
+{
+	auto it = m_mDirs.find(UpperCasePath(dirPath));
+	return (it != m_mDirs.end()) ? &it->second : nullptr;
+}
+
+bool ExtractDirCache::MayFileExist(const std::wstring &filePath)
+{
+	DirEntry* entry = FindDir(GetDirectoryName(filePath, false));
+	if (!entry) return true;
+
+	// Read directory content once instead of checking every file
+	if (!entry->IsNew && !entry->IsListed)
+	{
+		std::wstring strMask = GetDirectoryName(filePath, true) + L"*";
+
+		WIN32_FIND_DATAW fdata;
+		HANDLE hFind = FindFirstFileW(strMask.c_str(), &fdata);
+		if (hFind != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				entry->FileNames.insert(UpperCasePath(fdata.cFileName));
+			} while (FindNextFileW(hFind, &fdata));
+			FindClose(hFind);
+		}
+		entry->IsListed = true;
+	}
+
+	return entry->FileNames.count(UpperCasePath(ExtractFileName(filePath.c_str()))) > 0;
+}
+
+void ExtractDirCache::AddFile(const std::wstring &filePath)
+{
+	DirEntry* entry = FindDir(GetDirectoryName(filePath, false));
+	if (entry)
+		entry->FileNames.insert(UpperCasePath(ExtractFileName(filePath.c_str())));
+}
+
 // Returns total number of items added
 int CollectFileList(ContentTreeNode* node, ContentNodeList &targetlist, __int64 &totalSize, bool recursive)
 {
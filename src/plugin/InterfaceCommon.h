@@ -9,6 +9,7 @@
 
 const size_t cntProgressDialogWidth = 65;
 const int cntProgressRedrawTimeout = 100; // ms
+const int cntEscCheckTimeout = 50; // ms
 
 enum KeepPathValues
 {
@@ -36,6 +37,7 @@ struct ProgressContext
 
 	bool bDisplayOnScreen;
 	DWORD nLastDisplayTime;
+	DWORD nLastEscCheckTime;
 
 	DWORD nStartTime;
 	bool bAbortRequested;
@@ -51,6 +53,7 @@ struct ProgressContext
 		nCurrentProgress = -1;
 		bDisplayOnScreen = true;
 		nLastDisplayTime = 0;
+		nLastEscCheckTime = 0;
 
 		nStartTime = GetTickCount();
 		bAbortRequested = false;
@@ -74,6 +77,38 @@ struct ExtractSelectedParams
 	}
 };
 
+// Target directories for batch extraction. The whole tree (including intermediate
+// directories) is planned before extraction starts. Directories are created parents-first,
+// but only right before the first item that goes into them.
+class ExtractDirCache
+{
+private:
+	struct DirEntry
+	{
+		std::wstring Path;	// Original case, map key is upper-cased for lookup
+		bool IsCreated;
+		bool IsNew;			// Created during this extraction, so only holds our files
+		bool IsListed;
+		std::set<std::wstring> FileNames;
+
+		DirEntry() : IsCreated(false), IsNew(false), IsListed(false) {}
+	};
+
+	std::map<std::wstring, DirEntry> m_mDirs;
+
+	DirEntry* FindDir(const std::wstring &dirPath);
+
+public:
+	// Root directory should already exist
+	ExtractDirCache(const std::wstring &rootPath);
+
+	void AddDir(const std::wstring &dirPath);
+	bool EnsureDir(const std::wstring &dirPath);
+
+	bool MayFileExist(const std::wstring &filePath);
+	void AddFile(const std::wstring &filePath);
+};
+
 enum InfoLines
 {
 	IL_FORMAT = 1,
@@ -155,6 +155,7 @@ int ModulesController::OpenStorageFile(OpenStorageFileInParams srcParams, int *m
 	openParams.Password = srcParams.password;
 	openParams.Data = srcParams.dataBuffer;
 	openParams.DataSize = srcParams.dataSize;
+	openParams.Stream = srcParams.stream;
 	
 	*moduleIndex = -1;
 	for (size_t i = 0; i < m_vModules.size(); i++)
@@ -162,9 +163,14 @@ int ModulesController::OpenStorageFile(OpenStorageFileInParams srcParams, int *m
 		if (srcParams.openWithModule == -1 || srcParams.openWithModule == i)
 		{
 			const ExternalModule* modulePtr = m_vModules[i];
+			if (srcParams.stream && !modulePtr->HasCapability(MODULE_CAP_OPEN_STREAM))
+				continue;
+
 			if (!srcParams.applyExtFilters || modulePtr->DoesPathMatchFilter(srcParams.path))
 			{
 				int openRes;
+				// Modules do not have to fill optional fields
+				memset(sinfo, 0, sizeof(StorageGeneralInfo));
 				__try
 				{
 					openRes = modulePtr->ModuleFunctions.OpenStorage(openParams, storage, sinfo);
@@ -12,6 +12,7 @@ struct OpenStorageFileInParams
 	int openWithModule;  // set -1 to poll all modules
 	const void* dataBuffer;
 	size_t dataSize;
+	const StorageStreamCallbacks* stream;  // optional, only stream capable modules are polled
 };
 
 struct FailedModuleInfo 
@@ -318,28 +318,140 @@ static void ShowAttributes(const ContentTreeNode* node)
 
 //-----------------------------------  Content functions ----------------------------------------
 
+// Storage opened by AnalyseW, kept for OpenW to avoid parsing the file twice
+struct AnalysedStorage
+{
+	std::wstring Path;
+	DWORD SizeLow;
+	DWORD SizeHigh;
+	FILETIME LastWriteTime;
+	StorageObject* Storage;
+};
+
+static AnalysedStorage g_AnalysedStorage = {L"", 0, 0, {0}, nullptr};
+
+static void ReleaseAnalysedStorage()
+{
+	if (g_AnalysedStorage.Storage)
+	{
+		delete g_AnalysedStorage.Storage;
+		g_AnalysedStorage.Storage = nullptr;
+	}
+	g_AnalysedStorage.Path.clear();
+}
+
+static void KeepAnalysedStorage(const wchar_t* Name, StorageObject* storage)
+{
+	ReleaseAnalysedStorage();
+
+	WIN32_FIND_DATAW fd;
+	if (!FileExists(Name, &fd))
+	{
+		delete storage;
+		return;
+	}
+
+	g_AnalysedStorage.Path = Name;
+	g_AnalysedStorage.SizeLow = fd.nFileSizeLow;
+	g_AnalysedStorage.SizeHigh = fd.nFileSizeHigh;
+	g_AnalysedStorage.LastWriteTime = fd.ftLastWriteTime;
+	g_AnalysedStorage.Storage = storage;
+}
+
+// Returns storage from analysis if it was opened from the same unchanged file with the same module
+static StorageObject* TakeAnalysedStorage(const std::wstring& Name, int moduleIndex)
+{
+	StorageObject* storage = g_AnalysedStorage.Storage;
+	if (!storage) return nullptr;
+
+	WIN32_FIND_DATAW fd;
+	bool fMatch = (_wcsicmp(g_AnalysedStorage.Path.c_str(), Name.c_str()) == 0)
+		&& (storage->GetModuleIndex() == moduleIndex)
+		&& FileExists(Name, &fd)
+		&& (fd.nFileSizeLow == g_AnalysedStorage.SizeLow) && (fd.nFileSizeHigh == g_AnalysedStorage.SizeHigh)
+		&& (CompareFileTime(&fd.ftLastWriteTime, &g_AnalysedStorage.LastWriteTime) == 0);
+
+	if (!fMatch)
+	{
+		ReleaseAnalysedStorage();
+		return nullptr;
+	}
+
+	g_AnalysedStorage.Storage = nullptr;
+	g_AnalysedStorage.Path.clear();
+	return storage;
+}
+
 static int AnalizeStorage(const wchar_t* Name, bool applyExtFilters, void* startBuffer, size_t startBufferSize)
 {
 	StorageObject *storage = new StorageObject(&g_pController, StoragePasswordQuery);
 	
-	bool openOk = storage->Open(Name, startBuffer, startBufferSize, applyExtFilters, -1);
-	int retVal = openOk ? storage->GetModuleIndex() : -1;
+	if (!storage->Open(Name, startBuffer, startBufferSize, applyExtFilters, -1))
+	{
+		delete storage;
+		return -1;
+	}
 
-	delete storage;
+	int retVal = storage->GetModuleIndex();
+	KeepAnalysedStorage(Name, storage);
+	
 	return retVal;
 }
 
-static StorageObject* OpenStorage(const std::wstring& Name, bool applyExtFilters, int moduleIndex)
+// Listing runs on a worker thread, the calling thread only shows progress and polls Esc.
+// Module is never called by both threads, the storage is not touched until the worker is finished.
+struct ListReadContext
 {
-	if (Name.empty()) return nullptr;
-	
-	StorageObject *storage = new StorageObject(&g_pController, StoragePasswordQuery);
-	if (!storage->Open(Name.c_str(), applyExtFilters, moduleIndex))
+	StorageObject* storage;
+	ListReadResult result;
+	volatile LONG numItems;
+	volatile LONG abortRequested;
+};
+
+// Called by the worker for every item
+static bool ListReadProgress(void* context, int numItems)
+{
+	ListReadContext* lrc = (ListReadContext*) context;
+	InterlockedExchange(&lrc->numItems, numItems);
+	return (lrc->abortRequested == 0);
+}
+
+static DWORD WINAPI ListReadThreadProc(LPVOID lpParameter)
+{
+	ListReadContext* lrc = (ListReadContext*) lpParameter;
+	lrc->result = lrc->storage->ReadFileList(ListReadProgress, lrc);
+	return 0;
+}
+
+// Shows number of items read so far, and how many are expected if module told it on open
+static void ShowListReadProgress(const wchar_t* strDialogText, const wchar_t* strTitleText, int numItems, int numExpected)
+{
+	wchar_t wszItemsText[32] = {0};
+	wchar_t wszTitleText[128] = {0};
+
+	if (numExpected > 0)
 	{
-		delete storage;
-		return nullptr;
+		swprintf_s(wszItemsText, ARRAY_SIZE(wszItemsText), L"%d / %d", numItems, numExpected);
+		swprintf_s(wszTitleText, ARRAY_SIZE(wszTitleText), L"{%d%%} %s", (int) (min(numItems, numExpected) * 100LL / numExpected), strTitleText);
+
+		ProgressValue pv;
+		pv.StructSize = sizeof(ProgressValue);
+		pv.Completed = min(numItems, numExpected);
+		pv.Total = numExpected;
+		FarSInfo.AdvControl(&OBSERVER_GUID, ACTL_SETPROGRESSVALUE, 0, &pv);
 	}
+	else
+	{
+		swprintf_s(wszItemsText, ARRAY_SIZE(wszItemsText), L"%d", numItems);
+		swprintf_s(wszTitleText, ARRAY_SIZE(wszTitleText), L"%s (%d)", strTitleText, numItems);
+	}
+
+	DisplayMessage(false, false, GetLocMsg(MSG_PLUGIN_NAME), strDialogText, wszItemsText);
+	SetConsoleTitle(wszTitleText);
+}
 
+static StorageObject* ReadStorageContent(StorageObject* storage)
+{
 	wchar_t wszDialogText[100] = {0};
 	wchar_t wszConTitleText[100] = {0};
 
@@ -350,10 +462,42 @@ static StorageObject* OpenStorage(const std::wstring& Name, bool applyExtFilters
 	DisplayMessage(false, false, GetLocMsg(MSG_PLUGIN_NAME), wszDialogText, NULL);
 	SaveConsoleTitle ct(wszConTitleText);
 
-	FarSInfo.AdvControl(&OBSERVER_GUID, ACTL_SETPROGRESSSTATE, TBPS_INDETERMINATE, NULL);
+	int numExpected = storage->GeneralInfo.NumFiles;
+	FarSInfo.AdvControl(&OBSERVER_GUID, ACTL_SETPROGRESSSTATE, (numExpected > 0) ? TBPS_NORMAL : TBPS_INDETERMINATE, NULL);
+
+	ListReadContext lrc = {storage, ListReadResult::Aborted, 0, 0};
+
+	HANDLE hThread = CreateThread(NULL, 0, ListReadThreadProc, &lrc, 0, NULL);
+	if (hThread != NULL)
+	{
+		DWORD nLastDisplayTime = GetTickCount();
+		int numShownItems = 0;
+
+		// Esc stops listing after current item, module can not be interrupted inside PrepareFiles
+		while (WaitForSingleObject(hThread, cntEscCheckTimeout) == WAIT_TIMEOUT)
+		{
+			if (lrc.abortRequested == 0 && CheckEsc())
+				InterlockedExchange(&lrc.abortRequested, 1);
+
+			DWORD currentTime = GetTickCount();
+			int numItems = lrc.numItems;
+			if (numItems != numShownItems && currentTime - nLastDisplayTime >= cntProgressRedrawTimeout)
+			{
+				nLastDisplayTime = currentTime;
+				numShownItems = numItems;
+				ShowListReadProgress(wszDialogText, wszConTitleText, numItems, numExpected);
+			}
+		}
+		CloseHandle(hThread);
+	}
+	else
+	{
+		// No thread, list here and only poll Esc
+		lrc.result = storage->ReadFileList();
+	}
 
 	StorageObject* hResult = nullptr;
-	ListReadResult listRet = storage->ReadFileList();
+	ListReadResult listRet = lrc.result;
 	if (listRet == ListReadResult::Ok)
 	{
 		hResult = storage;
@@ -371,11 +515,101 @@ static StorageObject* OpenStorage(const std::wstring& Name, bool applyExtFilters
 	return hResult;
 }
 
-static void CloseStorage(HANDLE hStorage)
+static StorageObject* OpenStorage(const std::wstring& Name, bool applyExtFilters, int moduleIndex)
+{
+	if (Name.empty()) return nullptr;
+	
+	StorageObject *storage = new StorageObject(&g_pController, StoragePasswordQuery);
+	if (!storage->Open(Name.c_str(), applyExtFilters, moduleIndex))
+	{
+		delete storage;
+		return nullptr;
+	}
+
+	return ReadStorageContent(storage);
+}
+
+static void CloseStorage(StorageObject* storage)
 {
-	StorageObject *sobj = reinterpret_cast<StorageObject*>(hStorage);
-	sobj->Close();
-	delete sobj;
+	storage->Close();
+	delete storage;
+}
+
+// Panel handle, keeps chain of storages opened one inside another.
+// Last storage is the one displayed on panel.
+struct ObserverPanel
+{
+	struct Level
+	{
+		StorageObject* Storage;
+		std::wstring DirPrefix;  // Path of the nested storage inside the outer ones
+	};
+	std::vector<Level> Levels;
+
+	StorageObject* Storage() const { return Levels.back().Storage; }
+	const std::wstring& DirPrefix() const { return Levels.back().DirPrefix; }
+	bool IsNested() const { return Levels.size() > 1; }
+
+	void Push(StorageObject* storage, const std::wstring& prefix)
+	{
+		Level lv = {storage, prefix};
+		Levels.push_back(lv);
+	}
+	void Pop()
+	{
+		CloseStorage(Levels.back().Storage);
+		Levels.pop_back();
+	}
+};
+
+static ObserverPanel* CreatePanel(StorageObject* storage)
+{
+	ObserverPanel* panel = new ObserverPanel();
+	panel->Push(storage, L"");
+	return panel;
+}
+
+static void ClosePanel(HANDLE hPanel)
+{
+	ObserverPanel* panel = static_cast<ObserverPanel*>(hPanel);
+	while (!panel->Levels.empty())
+		panel->Pop();
+	delete panel;
+}
+
+static StorageObject* GetPanelStorage(HANDLE hPanel)
+{
+	return static_cast<ObserverPanel*>(hPanel)->Storage();
+}
+
+// Opens item of the current storage as nested storage directly from parent file data.
+// Returns false if item can not be opened this way, so FAR falls back to extraction into temp folder.
+static bool OpenNestedStorage(ObserverPanel* panel, const std::wstring& itemName)
+{
+	StorageObject* parent = panel->Storage();
+	const ContentTreeNode* item = parent->CurrentDir()->GetChildByName(itemName.c_str());
+	if (!StorageObject::CanOpenNested(item) || optIgnoreFilter.DoesPathMatch(itemName.c_str()))
+		return false;
+
+	StorageObject *storage = new StorageObject(&g_pController, StoragePasswordQuery);
+	if (!storage->OpenNested(parent, item, optUseExtensionFilters != 0))
+	{
+		delete storage;
+		return false;
+	}
+
+	// Listing errors are reported by ReadStorageContent, so do not try to open item again
+	storage = ReadStorageContent(storage);
+	if (storage)
+	{
+		panel->Push(storage, panel->DirPrefix() + L"\\" + item->GetPath());
+
+		PanelRedrawInfo pri = {sizeof(PanelRedrawInfo), 0, 0};
+		FarSInfo.PanelControl(PANEL_ACTIVE, FCTL_UPDATEPANEL, 0, nullptr);
+		FarSInfo.PanelControl(PANEL_ACTIVE, FCTL_REDRAWPANEL, 0, &pri);
+	}
+
+	return true;
 }
 
 static bool GetCurrentPanelItemName(HANDLE hPanel, std::wstring& nameStr, bool canBeDir)
@@ -431,13 +665,24 @@ static bool GetSelectedPanelFilePath(std::wstring& nameStr)
 
 //-----------------------------------  Callback functions ----------------------------------------
 
+// Polling console input is expensive, so do it only once in a while
+static bool CheckEscThrottled(ProgressContext* pc)
+{
+	DWORD currentTime = GetTickCount();
+	if (currentTime - pc->nLastEscCheckTime < cntEscCheckTimeout)
+		return false;
+
+	pc->nLastEscCheckTime = currentTime;
+	return CheckEsc();
+}
+
 static int CALLBACK ExtractProgress(HANDLE context, __int64 ProcessedBytes)
 {
 	ProgressContext* pc = (ProgressContext*) context;
 	pc->nProcessedFileBytes += ProcessedBytes;
 
 	// Check for ESC pressed
-	if (CheckEsc())
+	if (CheckEscThrottled(pc))
 	{
 		// Some modules can support progress indicator but not user abort feature
 		// In this case Esc key will be intercepted by progress callback and never processed
@@ -631,19 +876,19 @@ static void AskRename(std::wstring &filePath)
 	}
 }
 
-static int ExtractStorageItem(StorageObject* storage, const ContentTreeNode* item, std::wstring &destPath, bool showMessages, FileOverwriteOptions &doOverwrite, bool &skipOnError, ProgressContext *pctx)
+static int ExtractStorageItem(StorageObject* storage, const ContentTreeNode* item, std::wstring &destPath, bool checkExisting, bool showMessages, FileOverwriteOptions &doOverwrite, bool &skipOnError, ProgressContext *pctx)
 {
 	if (!item || !storage || item->IsDir())
 		return SER_ERROR_READ;
 
 	// Check for ESC pressed
-	if (CheckEsc())	return SER_USERABORT;
+	if (CheckEscThrottled(pctx)) return SER_USERABORT;
 
 	// Ask about overwrite if needed
 	WIN32_FIND_DATAW fdExistingFile = {0};
-	bool fAlreadyExists;
+	bool fAlreadyExists = false;
 
-	while ((fAlreadyExists = FileExists(destPath, &fdExistingFile)))
+	while (checkExisting && (fAlreadyExists = FileExists(destPath, &fdExistingFile)))
 	{
 		if (doOverwrite == OverwriteAsk)
 		{
@@ -676,22 +921,6 @@ static int ExtractStorageItem(StorageObject* storage, const ContentTreeNode* ite
 		}
 	}
 
-	// Create directory if needed
-	if (!fAlreadyExists)
-	{
-		auto strTargetDir = GetDirectoryName(destPath, false);
-		if (!strTargetDir.empty())
-		{
-			if (!ForceDirectoryExist(strTargetDir))
-			{
-				if (showMessages)
-					DisplayMessage(true, true, MSG_EXTRACT_ERROR, MSG_EXTRACT_DIR_CREATE_ERROR, strTargetDir.c_str());
-
-				return SER_ERROR_WRITE;
-			}
-		}
-	}
-
 	// Remove read-only attribute from target file if present
 	if (fAlreadyExists && (fdExistingFile.dwFileAttributes & FILE_ATTRIBUTE_READONLY))
 	{
@@ -766,8 +995,13 @@ static int ExtractStorageItem(StorageObject* storage, const ContentTreeNode* ite
 	return ret;
 }
 
+// Extract items in order of their data in storage, if module reports it
 static bool ItemSortPred(ContentTreeNode* item1, ContentTreeNode* item2)
 {
+	if (item1->DataVolume != item2->DataVolume)
+		return (item1->DataVolume < item2->DataVolume);
+	if (item1->DataPosition != item2->DataPosition)
+		return (item1->DataPosition < item2->DataPosition);
 	return (item1->StorageIndex < item2->StorageIndex);
 }
 
@@ -790,6 +1024,20 @@ int BatchExtract(StorageObject* info, ContentNodeList &items, __int64 totalExtra
 		return 0;
 	}
 
+	// Build all target paths and directory tree once before extraction
+	std::vector<std::wstring> vTargetPaths;
+	vTargetPaths.reserve(items.size());
+
+	ExtractDirCache dirCache(extParams.strDestPath);
+	for (auto cit = items.begin(); cit != items.end(); ++cit)
+	{
+		ContentTreeNode* nextItem = *cit;
+		auto strFullTargetPath = GetFinalExtractionPath(info, nextItem, extParams.strDestPath.c_str(), extParams.nPathProcessing);
+
+		dirCache.AddDir(nextItem->IsDir() ? strFullTargetPath : GetDirectoryName(strFullTargetPath, false));
+		vTargetPaths.push_back(strFullTargetPath);
+	}
+
 	int nExtractResult = SER_SUCCESS;
 	bool skipOnError = false;
 
@@ -819,29 +1067,39 @@ int BatchExtract(StorageObject* info, ContentNodeList &items, __int64 totalExtra
 		GetConsoleTitle(wszSaveTitle, ARRAY_SIZE(wszSaveTitle));
 	}
 
+	DWORD nLastTitleTime = 0;
+
 	// Extract all files one by one
-	for (auto cit = items.begin(); cit != items.end(); ++cit)
+	for (size_t i = 0; i < items.size(); ++i)
 	{
-		if (extParams.bShowProgress)
+		DWORD currentTime = GetTickCount();
+		if (extParams.bShowProgress && (currentTime - nLastTitleTime > cntProgressRedrawTimeout))
 		{
+			nLastTitleTime = currentTime;
 			swprintf_s(wszCurTitle, ARRAY_SIZE(wszCurTitle), L"Extracting Files (%d / %d)", pctx.nCurrentFileNumber, pctx.nTotalFiles);
 			SetConsoleTitle(wszCurTitle);
 		}
 		
-		ContentTreeNode* nextItem = *cit;
-		auto strFullTargetPath = GetFinalExtractionPath(info, nextItem, extParams.strDestPath.c_str(), extParams.nPathProcessing);
-		
-		if (nextItem->IsDir())
-		{
-			if (!ForceDirectoryExist(strFullTargetPath))
-				return 0;
-		}
-		else
+		ContentTreeNode* nextItem = items[i];
+		std::wstring &strFullTargetPath = vTargetPaths[i];
+
+		// Directory is created right before its first item, so abort does not leave empty tree behind
+		std::wstring strTargetDir = nextItem->IsDir() ? strFullTargetPath : GetDirectoryName(strFullTargetPath, false);
+		if (!strTargetDir.empty() && !dirCache.EnsureDir(strTargetDir))
 		{
-			nExtractResult = ExtractStorageItem(info, nextItem, strFullTargetPath, !extParams.bSilent, doOverwrite, skipOnError, &pctx);
+			if (!extParams.bSilent)
+				DisplayMessage(true, true, MSG_EXTRACT_ERROR, MSG_EXTRACT_DIR_CREATE_ERROR, strTargetDir.c_str());
+			nExtractResult = SER_ERROR_WRITE;
+			break;
 		}
+		if (nextItem->IsDir()) continue;
 
+		bool fMayExist = dirCache.MayFileExist(strFullTargetPath);
+		
+		nExtractResult = ExtractStorageItem(info, nextItem, strFullTargetPath, fMayExist, !extParams.bSilent, doOverwrite, skipOnError, &pctx);
 		if (nExtractResult != SER_SUCCESS) break;
+
+		dirCache.AddFile(strFullTargetPath);
 	}
 
 	FarSInfo.RestoreScreen(hScreen);
@@ -952,6 +1210,7 @@ void WINAPI GetPluginInfoW(struct PluginInfo *Info)
 
 void WINAPI ExitFARW(const ExitInfo* Info)
 {
+	ReleaseAnalysedStorage();
 	g_pController.Cleanup();
 }
 
@@ -982,7 +1241,7 @@ intptr_t WINAPI ConfigureW(const ConfigureInfo* Info)
 void WINAPI ClosePanelW(const struct ClosePanelInfo* info)
 {
 	if (info->hPanel != NULL)
-		CloseStorage(info->hPanel);
+		ClosePanel(info->hPanel);
 }
 
 HANDLE WINAPI AnalyseW(const AnalyseInfo* AInfo)
@@ -1005,7 +1264,8 @@ HANDLE WINAPI AnalyseW(const AnalyseInfo* AInfo)
 
 void WINAPI CloseAnalyseW(const CloseAnalyseInfo* info)
 {
-	// Nothing here
+	// If OpenW did not take the storage, then file was opened by some other plugin
+	ReleaseAnalysedStorage();
 }
 
 HANDLE WINAPI OpenW(const struct OpenInfo *OInfo)
@@ -1075,26 +1335,37 @@ HANDLE WINAPI OpenW(const struct OpenInfo *OInfo)
 	if (strFullSourcePath.empty() || !FileExists(strFullSourcePath, nullptr))
 		return 0;
 
-	StorageObject* hOpenResult = OpenStorage(strFullSourcePath, false, nOpenModuleIndex);
+	StorageObject* hOpenResult = nullptr;
+	StorageObject* analysedStorage = (OInfo->OpenFrom == OPEN_ANALYSE) ? TakeAnalysedStorage(strFullSourcePath, nOpenModuleIndex) : nullptr;
+	if (analysedStorage)
+		hOpenResult = ReadStorageContent(analysedStorage);
+	else
+		hOpenResult = OpenStorage(strFullSourcePath, false, nOpenModuleIndex);
+
+	if (!hOpenResult)
+		return nullptr;
 
-	if ( hOpenResult && !strSubPath.empty() )
+	ObserverPanel* hPanel = CreatePanel(hOpenResult);
+	if (!strSubPath.empty())
 	{
 		SetDirectoryInfo sdi = {0};
 		sdi.StructSize = sizeof(SetDirectoryInfo);
-		sdi.hPanel = hOpenResult;
+		sdi.hPanel = hPanel;
 		sdi.Dir = strSubPath.c_str();
 		sdi.OpMode = OPM_SILENT;
 
 		SetDirectoryW(&sdi);
 	}
 
-	return hOpenResult;
+	return hPanel;
 }
 
 intptr_t WINAPI GetFindDataW(GetFindDataInfo* fdInfo)
 {
-	StorageObject* info = static_cast<StorageObject*>(fdInfo->hPanel);
-	if (!info || !info->CurrentDir()) return FALSE;
+	if (!fdInfo->hPanel) return FALSE;
+	
+	StorageObject* info = GetPanelStorage(fdInfo->hPanel);
+	if (!info->CurrentDir()) return FALSE;
 
 	size_t nTotalItems = info->CurrentDir()->GetChildCount();
 	fdInfo->ItemsNumber = nTotalItems;
@@ -1152,18 +1423,34 @@ intptr_t WINAPI SetDirectoryW(const SetDirectoryInfo* sdInfo)
 	if (sdInfo->hPanel == NULL || sdInfo->hPanel == INVALID_HANDLE_VALUE)
 		return FALSE;
 
-	StorageObject* info = static_cast<StorageObject*>(sdInfo->hPanel);
+	ObserverPanel* panel = static_cast<ObserverPanel*>(sdInfo->hPanel);
 	if (!sdInfo->Dir || !sdInfo->Dir[0]) return TRUE;
 
-	return info->ChangeCurrentDir(sdInfo->Dir) ? 1 : 0;
+	// Leave nested storage when going up from its root
+	if (panel->IsNested() && wcscmp(sdInfo->Dir, L"..") == 0 && panel->Storage()->CurrentDir()->parent == NULL)
+	{
+		panel->Pop();
+		return TRUE;
+	}
+
+	// Absolute path is always resolved inside the outermost storage
+	if (sdInfo->Dir[0] == '\\' || sdInfo->Dir[0] == '/')
+	{
+		while (panel->IsNested())
+			panel->Pop();
+	}
+
+	return panel->Storage()->ChangeCurrentDir(sdInfo->Dir) ? 1 : 0;
 }
 
 void WINAPI GetOpenPanelInfoW(OpenPanelInfo* opInfo)
 {
 	opInfo->StructSize = sizeof(OpenPanelInfo);
 	
-	const StorageObject* info = (StorageObject *) opInfo->hPanel;
-	if (!info) return;
+	if (!opInfo->hPanel) return;
+	
+	const ObserverPanel* panel = static_cast<ObserverPanel*>(opInfo->hPanel);
+	const StorageObject* info = panel->Storage();
 	
 	static wchar_t wszCurrentDir[PATH_BUFFER_SIZE];
 	static wchar_t wszTitle[512];
@@ -1178,7 +1465,8 @@ void WINAPI GetOpenPanelInfoW(OpenPanelInfo* opInfo)
 	memset(wszCurrentDir, 0, sizeof(wszCurrentDir));
 	memset(wszTitle, 0, sizeof(wszTitle));
 
-	wszCurrentDir[0] = '\\';
+	wcscpy_s(wszCurrentDir, PATH_BUFFER_SIZE, panel->DirPrefix().c_str());
+	wcscat_s(wszCurrentDir, PATH_BUFFER_SIZE, L"\\");
 
 	size_t nDirPrefixSize = wcslen(wszCurrentDir);
 	info->CurrentDir()->GetPath(wszCurrentDir + nDirPrefixSize, PATH_BUFFER_SIZE - nDirPrefixSize);
@@ -1187,7 +1475,11 @@ void WINAPI GetOpenPanelInfoW(OpenPanelInfo* opInfo)
 	swprintf_s(wszTitle, ARRAY_SIZE(wszTitle), L"%s%s:%s", optPanelHeaderPrefix, info->GetModuleName(), wszCurrentDir);
 
 	// FAR does not exit plug-in if root directory is "\"
-	if (wcslen(wszCurrentDir) == 1) wszCurrentDir[0] = 0;
+	size_t nCurDirLen = wcslen(wszCurrentDir);
+	if (nCurDirLen == 1)
+		wszCurrentDir[0] = 0;
+	else if (wszCurrentDir[nCurDirLen - 1] == '\\')
+		wszCurrentDir[nCurDirLen - 1] = 0;  // Root of nested storage
 
 	I64TOW_C(info->TotalSize(), wszSizeInfo);
 	I64TOW_C(info->TotalPackedSize(), wszPackedSizeInfo);
@@ -1241,7 +1533,7 @@ void WINAPI GetOpenPanelInfoW(OpenPanelInfo* opInfo)
 	opInfo->Flags = OPIF_ADDDOTS | OPIF_SHORTCUT;
 	opInfo->CurDir = wszCurrentDir;
 	opInfo->PanelTitle = wszTitle;
-	opInfo->HostFile = info->StoragePath();
+	opInfo->HostFile = info->DataFilePath();
 	opInfo->InfoLinesNumber = ARRAY_SIZE(pInfoLinesData);
 	opInfo->InfoLines = pInfoLinesData;
 	opInfo->KeyBar = &kbTitles;
@@ -1256,7 +1548,7 @@ intptr_t WINAPI GetFilesW(GetFilesInfo *gfInfo)
 	if ((gfInfo->ItemsNumber == 1) && (wcscmp(gfInfo->PanelItem[0].FileName, L"..") == 0))
 		return 0;
 
-	StorageObject* info = reinterpret_cast<StorageObject*>(gfInfo->hPanel);
+	StorageObject* info = GetPanelStorage(gfInfo->hPanel);
 
 	ContentNodeList vcExtractItems;
 	__int64 nTotalExtractSize = 0;
@@ -1315,7 +1607,8 @@ intptr_t WINAPI ProcessPanelInputW(const struct ProcessPanelInputInfo* piInfo)
 	if (!piInfo->hPanel || (piInfo->Rec.EventType != KEY_EVENT)) return FALSE;
 	
 	const KEY_EVENT_RECORD &evtRec = piInfo->Rec.Event.KeyEvent;
-	StorageObject* storage = static_cast<StorageObject*>(piInfo->hPanel);
+	ObserverPanel* panel = static_cast<ObserverPanel*>(piInfo->hPanel);
+	StorageObject* storage = panel->Storage();
 
 	if (evtRec.bKeyDown && evtRec.wVirtualKeyCode == VK_F6 && CheckControlKeys(evtRec, false, true, false))
 	{
@@ -1346,7 +1639,7 @@ intptr_t WINAPI ProcessPanelInputW(const struct ProcessPanelInputInfo* piInfo)
 		// Check if we have something to extract
 		if (vcExtractItems.size() == 0) return TRUE;
 
-		wchar_t *wszTargetDir = _wcsdup(storage->StoragePath());
+		wchar_t *wszTargetDir = _wcsdup(storage->DataFilePath());
 		CutFileNameFromPath(wszTargetDir, true);
 		
 		ExtractSelectedParams extParams;
@@ -1370,6 +1663,13 @@ intptr_t WINAPI ProcessPanelInputW(const struct ProcessPanelInputInfo* piInfo)
 		
 		return TRUE;
 	}
+	else if (evtRec.bKeyDown && ((evtRec.wVirtualKeyCode == VK_RETURN && optOpenOnEnter && CheckControlKeys(evtRec, false, false, false))
+		|| (evtRec.wVirtualKeyCode == VK_NEXT && optOpenOnCtrlPgDn && CheckControlKeys(evtRec, true, false, false))))
+	{
+		std::wstring itemName;
+		if (GetCurrentPanelItemName(PANEL_ACTIVE, itemName, false))
+			return OpenNestedStorage(panel, itemName) ? TRUE : FALSE;
+	}
 
 	return FALSE;
 }